@@ -1307,16 +1307,10 @@ void CPlugin::RenderFrame(int bRedraw)
 				if(SUCCEEDED(hr)) {
 					// Can find the backbuffer format here, but a variable format isn't
 					// implemented so the user has to set up for X8R8G8B8.
-					// Clear alpha to white so that rgba can be used in Processing
-					unsigned char *src = (unsigned char *)d3dlr.pBits;
-					for(unsigned int i=0; i<g_Height; i++) {
-						for(unsigned int j=0; j<g_Width*4; j+=4) {
-							src+=3;
-							*src++ = 255;
-						}
-					}
-					// Pass the pixels to spout
-					spoutsender.SendImage((const unsigned char *)d3dlr.pBits, g_Width, g_Height, GL_BGRA_EXT); // 2.005
+					// Alpha is set to white as the pixels are copied so that rgba
+					// can be used in Processing (SPOUT_ALPHA_OPAQUE in OpenSender)
+					// Pass the pixels to spout with the surface pitch, the lines can be padded
+					spoutsender.SendImage((const unsigned char *)d3dlr.pBits, g_Width, g_Height, GL_BGRA_EXT, false, 0, (unsigned int)d3dlr.Pitch);
 				}
 			}
 		}
@@ -528,6 +528,7 @@ SPOUT NOTES :
 	22.01.17 - Create sender with default ARGB format
 			 - Clear alpha to white in milkdropfs.cpp
 			 - Rebuild for Spout 2.006
+	16.10.26 - Alpha set to 255 by the Spout copy instead of a separate loop
 
 
 */
@@ -9908,8 +9909,9 @@ bool CPlugin::OpenSender(unsigned int width, unsigned int height)
 	// This is a sender so create one
 	// This can be DirectX 11 which is the default
 	// Create with default format because X8R8G8B8 
-	// alpha is cleared before pixels are sent to Spout
+	// alpha is set to 255 as the pixels are copied to Spout
 	if(spoutsender.CreateSender(WinampSenderName, width, height)) {
+		spoutsender.spout.interop.spoutcopy.SetAlphaMode(SPOUT_ALPHA_OPAQUE);
 		g_Width  = width;
 		g_Height = height;
 		bSpoutOut = true;
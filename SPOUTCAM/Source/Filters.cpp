@@ -164,6 +164,8 @@
 			   Default resolution and frame rate so that the behaviour is the same as previous versions
 	10.01.17   Start change to Spout 2.006
 	23.01.17   Rebuild for Spout 2.006
+	16.10.26   Use spoutCopy Resample for format conversion and rescaling in one pass
+			   Removed rgb2bgr, rgb2bgrResample and bgr2bgrResample
 
 
 */
@@ -800,20 +802,16 @@ HRESULT CVCamStream::FillBuffer(IMediaSample *pms)
 					return NOERROR;					
 				}
 				
-				// For different sender and filter sizes, resample into the filter buffer.
-				if(g_SenderWidth != g_Width || g_SenderHeight != g_Height) {
-					if(glBGRmode == GL_RGB) {
-						rgb2bgrResample(g_senderBuffer, (unsigned char *)pData, g_SenderWidth, g_SenderHeight, g_Width, g_Height);
-					}
-					else {
-						bgr2bgrResample(g_senderBuffer, (unsigned char *)pData, g_SenderWidth, g_SenderHeight, g_Width, g_Height);
-					}
-				}
-				else {
-					// conversion is only needed if GL_BGR_EXT is not supported and the received buffer is RGB
-					if(glBGRmode == GL_RGB)  {
-						rgb2bgr(g_senderBuffer, (unsigned char *)pData, g_SenderWidth, g_SenderHeight);
-					}
+				// For different sender and filter sizes, or if GL_BGR_EXT is not supported
+				// and the received buffer is RGB, convert and resample into the filter buffer
+				// in one pass. Same size with bilinear is an exact copy.
+				if(g_SenderWidth != g_Width || g_SenderHeight != g_Height || glBGRmode == GL_RGB) {
+					int mode = SPOUT_RESAMPLE_BILINEAR;
+					if(g_SenderWidth >= g_Width*2 || g_SenderHeight >= g_Height*2)
+						mode = SPOUT_RESAMPLE_BOX; // average when reducing size
+					receiver.spout.interop.spoutcopy.Resample(g_senderBuffer, (unsigned char *)pData,
+															  g_SenderWidth, g_SenderHeight, 0, glBGRmode,
+															  g_Width, g_Height, 0, GL_BGR_EXT, mode);
 				}
 
 				NumFrames++;
@@ -1480,138 +1478,6 @@ void CVCamStream::GLerror() {
 
 
 
-// Adapted from : http://nehe.gamedev.net/tutorial/playing_avi_files_in_opengl/23001/
-// Inline asm only supported for 32bit by Visual Studio.
-void CVCamStream::rgb2bgr(void* source, void *dest, unsigned int width, unsigned int height, bool bInvert)
-{
-    void* a = source;         // Source rgb buffer
-	void* b = dest;           // Destination bgr buffer
-	unsigned int h = height;  // Line counter
-	unsigned int w = width;   // Line size in pixels
-	unsigned int s = 0;	      // Source buffer size for invert
-	unsigned int t = 0;       // Source line size for invert
-
-	if(bInvert) {
-		s = width*height*3;    // Source buffer size
-		t = width*3;           // Source line size
-	}
-
-    __asm                      // Assembler Code To Follow
-    {
-        mov ebx, a             // Points ebx to source data (a)
-		mov edx, b             // Points ebx To rgb data (b)
-
-		// Invert
-		add ebx, s             // end of source buffer
-		sub ebx, t             // beginning of the last line
-
-        mov ecx, h             // Line counter
-
-		lines:
-
-		push ecx
-		mov ecx, w             // Bytes per line source
-
-        label:                 // Label Used For Looping
-
-		    // loop though 3 bytes rgb and bgr
-
-			// b
-            mov al,[ebx+2]     // Loads Value At ebx Into al - rgb source
-			mov [edx],al       // Stores Value In al At edx - bgr dest
-            inc ebx            // rgb source buffer increment
-			inc edx            // bgr dest buffer increment
-
-			// g
-            mov al,[ebx]       // Loads Value At ebx Into al      rgb source
-			mov [edx],al       // Stores Value In al At edx       bgr dest
-            inc ebx            // rgba buffer increment
-			inc edx            // rgb buffer increment
-
-			// r
-            mov al,[ebx-2]     // Loads Value At ebx Into al      rgb source
-			mov [edx],al       // Stores Value In al At edx       bgr dest
-            inc ebx            // rgba buffer increment
-			inc edx            // rgb buffer increment
-
-            dec ecx            // Decrease Loop Counter (3 bytes per loop)
-            jnz label          // If Not Zero Jump Back To Label
-
-			// drop through after doing one line
-
-			pop ecx            // restore line counter
-
-			// Invert
-			sub ebx, t
-			sub ebx, t         // Next rgb source line up
-
-			dec ecx            // next line
-			jnz lines          // do all lines
-
-    }
-}
-
-
-// Adapted from :
-// http://tech-algorithm.com/articles/nearest-neighbor-image-scaling/
-// http://www.cplusplus.com/forum/general/2615/#msg10482
-//
-void CVCamStream::rgb2bgrResample(unsigned char* source, unsigned char* dest, 
-								  unsigned int sourceWidth, unsigned int sourceHeight, 
-								  unsigned int destWidth, unsigned int destHeight, bool bInvert)
-{
-	unsigned char *srcBuffer = (unsigned char *)source; // void to unsigned char pointer
-	unsigned char *dstBuffer = (unsigned char *)dest;
-
-	float x_ratio = (float)sourceWidth/(float)destWidth ;
-	float y_ratio = (float)sourceHeight/(float)destHeight ;
-	float px, py ; 
-	unsigned int i, j;
-	unsigned int pixel, nearestMatch;
-	for(i = 0; i<destHeight; i++) {
-		for(j = 0; j<destWidth; j++) {
-			px = floor((float)j*x_ratio);
-			py = floor((float)i*y_ratio);
-			if(bInvert)
-				pixel = (destHeight-i-1)*destWidth*3 + j*3; // flip vertically
-			else
-				pixel = i*destWidth*3 + j*3;
-			nearestMatch = (int)(py*sourceWidth*3 + px*3);
-			dstBuffer[pixel + 0] = srcBuffer[nearestMatch + 2];
-			dstBuffer[pixel + 1] = srcBuffer[nearestMatch + 1];
-			dstBuffer[pixel + 2] = srcBuffer[nearestMatch + 0];
-		}
-	}
-}
-
-void CVCamStream::bgr2bgrResample(unsigned char* source, unsigned char* dest, 
-								  unsigned int sourceWidth, unsigned int sourceHeight, 
-								  unsigned int destWidth, unsigned int destHeight, bool bInvert)
-{
-	unsigned char *srcBuffer = (unsigned char *)source; // void to unsigned char pointer
-	unsigned char *dstBuffer = (unsigned char *)dest;
-
-	float x_ratio = (float)sourceWidth/(float)destWidth ;
-	float y_ratio = (float)sourceHeight/(float)destHeight ;
-	float px, py ; 
-	unsigned int i, j;
-	unsigned int pixel, nearestMatch;
-	for(i = 0; i<destHeight; i++) {
-		for(j = 0; j<destWidth; j++) {
-			px = floor((float)j*x_ratio);
-			py = floor((float)i*y_ratio);
-			if(bInvert)
-				pixel = (destHeight-i-1)*destWidth*3 + j*3; // flip vertically
-			else
-				pixel = i*destWidth*3 + j*3;
-			nearestMatch = (int)(py*sourceWidth*3 + px*3);
-			dstBuffer[pixel + 0] = srcBuffer[nearestMatch + 0];
-			dstBuffer[pixel + 1] = srcBuffer[nearestMatch + 1];
-			dstBuffer[pixel + 2] = srcBuffer[nearestMatch + 2];
-		}
-	}
-}
-
 /*
 bool CVCamStream::FlipRgbBuffer(const unsigned char *src, 
 								  unsigned char *dst, 
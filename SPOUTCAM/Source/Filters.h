@@ -202,15 +202,6 @@ public:
 	bool InitOpenGL();
 	void GLerror();
 	
-	void rgb2bgr(void* source, void *dest, unsigned int width, unsigned int height, bool bInvert = false); // 32bit asm
-    void rgb2bgrResample(unsigned char* source, unsigned char* dest, 
-						 unsigned int sourceWidth, unsigned int sourceHeight, 
-						 unsigned int destWidth, unsigned int destHeight, 
-						 bool bInvert = false);
-	void bgr2bgrResample(unsigned char* source, unsigned char* dest, 
-						 unsigned int sourceWidth, unsigned int sourceHeight, 
-						 unsigned int destWidth, unsigned int destHeight, 
-						 bool bInvert = false);
 	// bool FlipRgbBuffer(const unsigned char *src, unsigned char *dst, unsigned int width, unsigned int height, GLenum glFormat) ;
 
 private:
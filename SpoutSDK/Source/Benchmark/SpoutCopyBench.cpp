@@ -0,0 +1,456 @@
+/*
+
+						SpoutCopyBench.cpp
+
+		Benchmark and validation of the spoutCopy conversion functions
+
+		Usage : SpoutCopyBench [options]
+
+			--validate        compare every SIMD path with the scalar functions
+			--size WxH        benchmark one resolution (default 720p, 1080p and 4K)
+			--kernel name     only kernels with names containing "name"
+			--threads n       worker threads including the caller (default 1)
+			--time ms         minimum time for each measurement (default 250)
+
+		For each kernel, resolution and instruction set, the benchmark reports
+		the time for one frame and the throughput of source and destination
+		bytes together. Validation returns 1 if any result differs from the
+		scalar reference or writes past the end of the destination.
+
+		- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+		Copyright (c) 2016-2017, Lynn Jarvis. All rights reserved.
+
+		Redistribution and use in source and binary forms, with or without modification,
+		are permitted provided that the following conditions are met:
+
+		1. Redistributions of source code must retain the above copyright notice,
+		   this list of conditions and the following disclaimer.
+
+		2. Redistributions in binary form must reproduce the above copyright notice,
+		   this list of conditions and the following disclaimer in the documentation
+		   and/or other materials provided with the distribution.
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY
+		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED.
+		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+		========================
+
+		16.10.26 - first version
+
+*/
+#include "../SpoutCopy.h"
+#include <chrono>
+#include <vector>
+
+typedef bool (*benchFunc)(spoutCopy &copy, const unsigned char *src, unsigned char *dst,
+						  unsigned int width, unsigned int height, bool bInvert);
+
+struct benchKernel {
+	const char *name;
+	double srcBytes; // bytes per source pixel
+	double dstBytes; // bytes per destination pixel (of the source size)
+	bool bEven; // yuv width and height must be even
+	int alphaMode; // SpoutAlphaMode
+	benchFunc func;
+};
+
+static const char *isaNames[] = { "SCALAR", "SSE2", "SSSE3", "AVX2", "AVX512" };
+
+// Guard bytes after each destination to detect overruns
+static const unsigned int guardBytes = 64;
+static const unsigned char guardValue = 0xCD;
+
+//
+// Kernels
+//
+
+static bool bench_copy(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	copy.CopyPixels(src, dst, w, h, GL_RGBA, bInvert);
+	return true;
+}
+
+static bool bench_rgba2bgra(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	copy.rgba2bgra((void *)src, dst, w, h, bInvert);
+	return true;
+}
+
+static bool bench_rgb2rgba(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	copy.rgb2rgba((void *)src, dst, w, h, bInvert);
+	return true;
+}
+
+static bool bench_bgr2rgba(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	copy.bgr2rgba((void *)src, dst, w, h, bInvert);
+	return true;
+}
+
+static bool bench_rgba2rgb(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	copy.rgba2rgb((void *)src, dst, w, h, bInvert);
+	return true;
+}
+
+static bool bench_rgba2bgr(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	copy.rgba2bgr((void *)src, dst, w, h, bInvert);
+	return true;
+}
+
+static bool bench_8to16(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA, 0, GL_RGBA16, bInvert);
+}
+
+static bool bench_16to8(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA16, 0, GL_RGBA, bInvert);
+}
+
+static bool bench_8to16f(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA, 0, GL_RGBA16F, bInvert);
+}
+
+static bool bench_16fto8(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA16F, 0, GL_RGBA, bInvert);
+}
+
+static bool bench_8to10(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA, 0, GL_RGB10_A2, bInvert);
+}
+
+static bool bench_10to8(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGB10_A2, 0, GL_RGBA, bInvert);
+}
+
+static bool bench_16to16f(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA16, 0, GL_RGBA16F, bInvert);
+}
+
+static bool bench_16fto16(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA16F, 0, GL_RGBA16, bInvert);
+}
+
+static bool bench_16to10(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGBA16, 0, GL_RGB10_A2, bInvert);
+}
+
+static bool bench_10to16(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.ConvertPixels(src, dst, w, h, 0, GL_RGB10_A2, 0, GL_RGBA16, bInvert);
+}
+
+static bool bench_rgba2nv12(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.rgba2yuv(src, dst, w, h, 0, GL_RGBA, SPOUT_YUV_NV12, bInvert);
+}
+
+static bool bench_nv122rgba(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.yuv2rgba(src, dst, w, h, SPOUT_YUV_NV12, 0, GL_RGBA, bInvert);
+}
+
+static bool bench_rgba2yuy2(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.rgba2yuv(src, dst, w, h, 0, GL_RGBA, SPOUT_YUV_YUY2, bInvert);
+}
+
+static bool bench_yuy22rgba(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.yuv2rgba(src, dst, w, h, SPOUT_YUV_YUY2, 0, GL_RGBA, bInvert);
+}
+
+// Half size in each direction
+static bool bench_resample(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.Resample(src, dst, w, h, 0, GL_RGBA, (w+1)/2, (h+1)/2, 0, GL_BGRA_EXT, SPOUT_RESAMPLE_BILINEAR, bInvert);
+}
+
+static bool bench_resample_box(spoutCopy &copy, const unsigned char *src, unsigned char *dst, unsigned int w, unsigned int h, bool bInvert)
+{
+	return copy.Resample(src, dst, w, h, 0, GL_RGBA, (w+1)/2, (h+1)/2, 0, GL_RGBA, SPOUT_RESAMPLE_BOX, bInvert);
+}
+
+static const benchKernel kernels[] = {
+	{ "copy",               4.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_copy },
+	{ "rgba > bgra",        4.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_rgba2bgra },
+	{ "rgb > rgba",         3.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_rgb2rgba },
+	{ "bgr > rgba",         3.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_bgr2rgba },
+	{ "rgba > rgb",         4.0, 3.0,  false, SPOUT_ALPHA_KEEP,          bench_rgba2rgb },
+	{ "rgba > bgr",         4.0, 3.0,  false, SPOUT_ALPHA_KEEP,          bench_rgba2bgr },
+	{ "rgba > rgba16",      4.0, 8.0,  false, SPOUT_ALPHA_KEEP,          bench_8to16 },
+	{ "rgba16 > rgba",      8.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_16to8 },
+	{ "rgba > rgba16f",     4.0, 8.0,  false, SPOUT_ALPHA_KEEP,          bench_8to16f },
+	{ "rgba16f > rgba",     8.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_16fto8 },
+	{ "rgba > rgb10a2",     4.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_8to10 },
+	{ "rgb10a2 > rgba",     4.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_10to8 },
+	{ "rgba16 > rgba16f",   8.0, 8.0,  false, SPOUT_ALPHA_KEEP,          bench_16to16f },
+	{ "rgba16f > rgba16",   8.0, 8.0,  false, SPOUT_ALPHA_KEEP,          bench_16fto16 },
+	{ "rgba16 > rgb10a2",   8.0, 4.0,  false, SPOUT_ALPHA_KEEP,          bench_16to10 },
+	{ "rgb10a2 > rgba16",   4.0, 8.0,  false, SPOUT_ALPHA_KEEP,          bench_10to16 },
+	{ "opaque",             4.0, 4.0,  false, SPOUT_ALPHA_OPAQUE,        bench_copy },
+	{ "premultiply",        4.0, 4.0,  false, SPOUT_ALPHA_PREMULTIPLY,   bench_copy },
+	{ "unpremultiply",      4.0, 4.0,  false, SPOUT_ALPHA_UNPREMULTIPLY, bench_copy },
+	{ "rgba > nv12",        4.0, 1.5,  true,  SPOUT_ALPHA_KEEP,          bench_rgba2nv12 },
+	{ "nv12 > rgba",        1.5, 4.0,  true,  SPOUT_ALPHA_KEEP,          bench_nv122rgba },
+	{ "rgba > yuy2",        4.0, 2.0,  true,  SPOUT_ALPHA_KEEP,          bench_rgba2yuy2 },
+	{ "yuy2 > rgba",        2.0, 4.0,  true,  SPOUT_ALPHA_KEEP,          bench_yuy22rgba },
+	{ "resample 1/2 bgra",  4.0, 1.0,  false, SPOUT_ALPHA_KEEP,          bench_resample },
+	{ "resample 1/2 box",   4.0, 1.0,  false, SPOUT_ALPHA_KEEP,          bench_resample_box },
+};
+
+static const unsigned int nKernels = sizeof(kernels)/sizeof(kernels[0]);
+
+//
+// Utility
+//
+
+// Repeatable pseudo-random source data
+static void fill_random(unsigned char *buf, size_t size, unsigned int seed)
+{
+	uint32_t x = seed*2654435761u + 1;
+	for (size_t i = 0; i < size; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		buf[i] = (unsigned char)(x >> 24);
+	}
+}
+
+// Destination size, rounding up for the chroma of 4:2:0 formats
+static size_t dest_size(const benchKernel &k, unsigned int w, unsigned int h)
+{
+	if (k.func == bench_resample || k.func == bench_resample_box)
+		return (size_t)((w+1)/2)*((h+1)/2)*4;
+	return (size_t)((double)w*(double)h*k.dstBytes + 0.5);
+}
+
+static size_t source_size(const benchKernel &k, unsigned int w, unsigned int h)
+{
+	return (size_t)((double)w*(double)h*k.srcBytes + 0.5);
+}
+
+static bool name_match(const benchKernel &k, const char *filter)
+{
+	return (filter == NULL || strstr(k.name, filter) != NULL);
+}
+
+
+//
+// Validation
+//
+// Each kernel is run at the scalar instruction set for the reference,
+// then at each SIMD level, for widths that leave a remainder after
+// every block size, upright and inverted, with and without threads.
+// 6x2 has yuv chroma pairs in both the SIMD block and the tail of a line.
+//
+static int validate(const char *filter)
+{
+	static const unsigned int sizes[][2] = {
+		{ 1, 1 }, { 2, 2 }, { 6, 2 }, { 7, 3 }, { 15, 2 }, { 33, 5 }, { 64, 4 },
+		{ 127, 7 }, { 258, 9 }, { 1283, 17 }, { 1920, 64 }
+	};
+	const unsigned int nSizes = sizeof(sizes)/sizeof(sizes[0]);
+
+	spoutCopy copy;
+	int maxISA = copy.GetISA();
+	unsigned int nFailed = 0;
+	unsigned int nChecked = 0;
+
+	printf("Validation - %s and below against %s\n", isaNames[maxISA], isaNames[SPOUT_ISA_SCALAR]);
+
+	for (unsigned int k = 0; k < nKernels; k++) {
+		const benchKernel &kernel = kernels[k];
+		if (!name_match(kernel, filter))
+			continue;
+
+		bool bKernelOK = true;
+		copy.SetAlphaMode(kernel.alphaMode);
+
+		for (unsigned int s = 0; s < nSizes; s++) {
+			unsigned int w = sizes[s][0];
+			unsigned int h = sizes[s][1];
+			if (kernel.bEven) {
+				w = (w + 1) & ~1u;
+				h = (h + 1) & ~1u;
+			}
+
+			size_t srcSize = source_size(kernel, w, h);
+			size_t dstSize = dest_size(kernel, w, h);
+			std::vector<unsigned char> src(srcSize);
+			std::vector<unsigned char> ref(dstSize + guardBytes);
+			std::vector<unsigned char> dst(dstSize + guardBytes);
+			fill_random(&src[0], srcSize, k*131 + s);
+
+			for (int inv = 0; inv < 2; inv++) {
+				bool bInvert = (inv != 0);
+
+				copy.SetThreadCount(1);
+				copy.SetISA(SPOUT_ISA_SCALAR);
+				memset(&ref[0], guardValue, ref.size());
+				if (!kernel.func(copy, &src[0], &ref[0], w, h, bInvert)) {
+					printf("  %-18s %ux%u : failed to convert\n", kernel.name, w, h);
+					bKernelOK = false;
+					continue;
+				}
+
+				for (int isa = SPOUT_ISA_SSE2; isa <= maxISA; isa++) {
+					for (int t = 0; t < 2; t++) {
+						copy.SetISA(isa);
+						copy.SetThreadCount(t == 0 ? 1 : 4);
+						copy.SetThreadThreshold(0);
+						memset(&dst[0], guardValue, dst.size());
+						kernel.func(copy, &src[0], &dst[0], w, h, bInvert);
+						nChecked++;
+
+						size_t i = 0;
+						while (i < dst.size() && dst[i] == ref[i]) i++;
+						if (i < dst.size()) {
+							printf("  %-18s %ux%u%s %s %s : byte %u is %u, scalar %u%s\n",
+								kernel.name, w, h, bInvert ? " inverted" : "",
+								isaNames[isa], t == 0 ? "1 thread" : "4 threads",
+								(unsigned int)i, dst[i], ref[i],
+								i >= dstSize ? " (past the end)" : "");
+							bKernelOK = false;
+						}
+					}
+				}
+			}
+		}
+
+		copy.SetThreadCount(1);
+		copy.SetThreadThreshold(2*1024*1024);
+		copy.SetISA(maxISA);
+
+		printf("%-20s %s\n", kernel.name, bKernelOK ? "ok" : "FAILED");
+		if (!bKernelOK)
+			nFailed++;
+	}
+	copy.SetAlphaMode(SPOUT_ALPHA_KEEP);
+
+	printf("%u comparisons, %u kernels failed\n", nChecked, nFailed);
+
+	return (nFailed > 0) ? 1 : 0;
+}
+
+
+//
+// Benchmark
+//
+// Each measurement repeats the kernel for at least the minimum time
+// after one frame to warm the caches and start the threads.
+//
+static void benchmark(const char *filter, unsigned int width, unsigned int height,
+					  unsigned int nThreads, unsigned int minTime)
+{
+	static const unsigned int sizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	unsigned int nSizes = sizeof(sizes)/sizeof(sizes[0]);
+
+	spoutCopy copy;
+	int maxISA = copy.GetISA();
+	copy.SetThreadCount(nThreads);
+
+	printf("%-20s %-10s %-7s %12s %9s\n", "kernel", "size", "isa", "ns/frame", "GB/s");
+
+	for (unsigned int k = 0; k < nKernels; k++) {
+		const benchKernel &kernel = kernels[k];
+		if (!name_match(kernel, filter))
+			continue;
+
+		copy.SetAlphaMode(kernel.alphaMode);
+
+		for (unsigned int s = 0; s < (width > 0 ? 1 : nSizes); s++) {
+			unsigned int w = (width > 0) ? width : sizes[s][0];
+			unsigned int h = (width > 0) ? height : sizes[s][1];
+			if (kernel.bEven) {
+				w &= ~1u;
+				h &= ~1u;
+			}
+
+			size_t srcSize = source_size(kernel, w, h);
+			size_t dstSize = dest_size(kernel, w, h);
+			std::vector<unsigned char> src(srcSize);
+			std::vector<unsigned char> dst(dstSize);
+			fill_random(&src[0], srcSize, k);
+
+			for (int isa = SPOUT_ISA_SCALAR; isa <= maxISA; isa++) {
+				copy.SetISA(isa);
+				kernel.func(copy, &src[0], &dst[0], w, h, false);
+
+				unsigned int nFrames = 0;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				double ns = 0.0;
+				do {
+					kernel.func(copy, &src[0], &dst[0], w, h, false);
+					nFrames++;
+					ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				} while (ns < (double)minTime*1000000.0);
+
+				double nsFrame = ns/(double)nFrames;
+				double gbs = (double)(srcSize + dstSize)/nsFrame; // bytes per ns is GB/s
+				printf("%-20s %4ux%-5u %-7s %12.0f %9.2f\n", kernel.name, w, h, isaNames[isa], nsFrame, gbs);
+			}
+		}
+	}
+	copy.SetAlphaMode(SPOUT_ALPHA_KEEP);
+}
+
+
+int main(int argc, char *argv[])
+{
+	bool bValidate = false;
+	const char *filter = NULL;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int nThreads = 1;
+	unsigned int minTime = 250;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--validate") == 0) {
+			bValidate = true;
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i+1 < argc) {
+			if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+				printf("Size must be WxH\n");
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--kernel") == 0 && i+1 < argc) {
+			filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+			nThreads = (unsigned int)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--time") == 0 && i+1 < argc) {
+			minTime = (unsigned int)atoi(argv[++i]);
+		}
+		else {
+			printf("Usage : SpoutCopyBench [--validate] [--size WxH] [--kernel name] [--threads n] [--time ms]\n");
+			return 2;
+		}
+	}
+
+	if (bValidate)
+		return validate(filter);
+
+	benchmark(filter, width, height, nThreads, minTime);
+
+	return 0;
+}
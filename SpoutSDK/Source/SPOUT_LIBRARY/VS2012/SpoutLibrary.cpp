@@ -17,6 +17,7 @@
 //		17.01.17 - Add GetShareMode, SetShareMode
 //		23.01.17 - Rebuild for Spout 2.006 - VS2012 /MT
 //		08.01.17 - Rebuild - VS2012 /MT
+//		16.10.26 - Add CheckSenderListChanged, WaitSenderListChanged, SetSenderListCallback
 //
 //
 /*
@@ -121,6 +122,11 @@ class SPOUTImpl : public SPOUTLIBRARY
 		//
 		void Release();
 
+		// Sender list changes
+		bool CheckSenderListChanged();
+		bool WaitSenderListChanged(DWORD dwTimeout);
+		void SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData = NULL);
+
 };
 
 //
@@ -355,6 +361,24 @@ void SPOUTImpl::Release()
     delete this;
 }
 
+//
+// Sender list changes
+//
+bool SPOUTImpl::CheckSenderListChanged()
+{
+	return spoutSDK->CheckSenderListChanged();
+}
+
+bool SPOUTImpl::WaitSenderListChanged(DWORD dwTimeout)
+{
+	return spoutSDK->WaitSenderListChanged(dwTimeout);
+}
+
+void SPOUTImpl::SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData)
+{
+	spoutSDK->SetSenderListCallback(pCallback, pUserData);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Factory function that creates instances if the SPOUT object.
 //
@@ -108,6 +108,12 @@ struct SPOUTLIBRARY
 	// Library release function
     virtual void Release() = 0;
 
+	// Sender list changes
+	// After Release so that applications built with an earlier header keep the same order
+	virtual bool CheckSenderListChanged() = 0; // senders registered or released or a new active sender since the last check
+	virtual bool WaitSenderListChanged(DWORD dwTimeout) = 0; // wait for a change, or check with zero timeout
+	virtual void SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData = NULL) = 0; // called on a background thread, NULL to stop
+
 };
 
 
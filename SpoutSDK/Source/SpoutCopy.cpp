@@ -35,19 +35,2075 @@
 				   Revise rgb2rgba etc.
 		11.10.16 - Added SSSE detection and rgba-bgra function
 		04.01.17 - Added rgb2bgra, bgr2bgra, bgra2rgb, bgra2bgr
+		16.10.26 - Added AVX2 and AVX-512 detection
+				   Table of line conversion functions selected for the cpu
+				   SSSE3, AVX2 and AVX-512BW functions for all conversions
+				   Worker threads for copy and conversion of large images
+				   memcpy_sse2 - any size and alignment, sfence after streaming stores
+				   Overloads with source and destination line pitch
+				   Resample - format conversion, flip and resize in one pass
+				   Rgba to yuv and yuv to rgba for NV12, I420, YUY2 and UYVY
+				   ConvertPixels - 16 bit, half float and 10 bit formats, F16C detection
+				   SetAlphaMode - opaque, premultiply or unpremultiply with the conversion
+				   Builds with gcc and clang - cpuid, xgetbv and function targets for the SIMD code
+				   Line buffers kept by each thread instead of allocated for every stripe
+				   Yuv and resample line functions are scalar for SPOUT_ISA_SCALAR
 
 */
-#include "spoutCopy.h"
+#include "SpoutCopy.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+//
+// Instruction set of the SIMD functions
+//
+// Visual Studio compiles any intrinsic without a compiler option.
+// gcc and clang need the target of each function using intrinsics
+// beyond SSE2, so that the library builds without -mavx2 etc.
+// and the cpu check still decides which functions are used.
+//
+#if defined(__GNUC__) || defined(__clang__)
+#define SPOUT_TARGET_SSSE3  __attribute__((target("ssse3")))
+#define SPOUT_TARGET_AVX2   __attribute__((target("avx2")))
+#define SPOUT_TARGET_F16C   __attribute__((target("avx2,f16c")))
+#define SPOUT_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define SPOUT_TARGET_SSSE3
+#define SPOUT_TARGET_AVX2
+#define SPOUT_TARGET_F16C
+#define SPOUT_TARGET_AVX512
+#endif
+
+//
+// Line conversion functions
+//
+// Each converts one line of "width" pixels from source to destination.
+// Source and destination need not be aligned. Pixels remaining after
+// the last full SIMD block are done by the scalar function.
+//
+// Byte order only matters for whether red and blue are swapped, so
+// rgb > rgba is the same function as bgr > bgra etc.
+//
+
+// ---------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------
+
+static void row_swap4(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const uint32_t *source = (const uint32_t *)src;
+	uint32_t *dest = (uint32_t *)dst;
+	uint32_t rgbapix; // 32bit rgba pixel
+
+	for (unsigned int x = 0; x < width; x++) {
+		rgbapix = source[x];
+		// rgbapix << 16		: a r g b > g b a r
+		//        & 0x00ff00ff  : r g b . > . b . r
+		// rgbapix & 0xff00ff00 : a r g b > a . g .
+		// result of or			:           a b g r
+		dest[x] = (((rgbapix << 16) | (rgbapix >> 16)) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
+	}
+}
+
+static void row_3to4(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		*(dst + 0) = *(src + 0);
+		*(dst + 1) = *(src + 1);
+		*(dst + 2) = *(src + 2);
+		*(dst + 3) = (unsigned char)255; // alpha
+		src += 3;
+		dst += 4;
+	}
+}
+
+static void row_3to4_swap(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		*(dst + 0) = *(src + 2);
+		*(dst + 1) = *(src + 1);
+		*(dst + 2) = *(src + 0);
+		*(dst + 3) = (unsigned char)255; // alpha
+		src += 3;
+		dst += 4;
+	}
+}
+
+static void row_4to3(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		*(dst + 0) = *(src + 0);
+		*(dst + 1) = *(src + 1);
+		*(dst + 2) = *(src + 2);
+		src += 4;
+		dst += 3;
+	}
+}
+
+static void row_4to3_swap(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		*(dst + 0) = *(src + 2);
+		*(dst + 1) = *(src + 1);
+		*(dst + 2) = *(src + 0);
+		src += 4;
+		dst += 3;
+	}
+}
+
+
+// ---------------------------------------------------------
+// SSE2
+//
+// Adapted from : https://searchcode.com/codesearch/view/5070982/
+// 
+// Copyright (c) 2002-2010 The ANGLE Project Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// https://chromium.googlesource.com/angle/angle/+/master/LICENSE
+//
+// ---------------------------------------------------------
+
+static void row_swap4_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	__m128i brMask = _mm_set1_epi32(0x00ff00ff); // argb
+	unsigned int x = 0;
+
+	for (; x + 3 < width; x += 4) {
+		__m128i sourceData = _mm_loadu_si128((const __m128i *)(src + x*4));
+		// Mask out g and a, which don't change
+		__m128i gaComponents = _mm_andnot_si128(brMask, sourceData);
+		// Mask out b and r
+		__m128i brComponents = _mm_and_si128(sourceData, brMask);
+		// Swap b and r
+		__m128i brSwapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(brComponents, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		__m128i result = _mm_or_si128(gaComponents, brSwapped);
+		_mm_storeu_si128((__m128i *)(dst + x*4), result);
+	}
+
+	// Perform leftover writes
+	if (x < width)
+		row_swap4(src + x*4, dst + x*4, width - x);
+}
+
+
+// ---------------------------------------------------------
+// SSSE3
+//
+// rgba <> bgra adapted from a Gist snippet by Aurelien Vallee (NewbiZ)
+// https://gist.github.com/NewbiZ/5541524
+//
+// Shuffle masks are in reverse byte order. -128 (0x80) clears the byte.
+// ---------------------------------------------------------
+
+static SPOUT_TARGET_SSSE3 void row_swap4_ssse3(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	// Shuffling mask (RGBA -> BGRA) x 4
+	const __m128i m = _mm_set_epi8(15,12,13,14,11,8,9,10,7,4,5,6,3,0,1,2);
+	unsigned int x = 0;
+
+	// Tile to match 64B cache line size
+	for (; x + 16 <= width; x += 16) {
+		const __m128i *s = (const __m128i *)(src + x*4);
+		__m128i *d = (__m128i *)(dst + x*4);
+		__m128i p1 = _mm_loadu_si128(s);
+		__m128i p2 = _mm_loadu_si128(s+1);
+		__m128i p3 = _mm_loadu_si128(s+2);
+		__m128i p4 = _mm_loadu_si128(s+3);
+		_mm_storeu_si128(d,   _mm_shuffle_epi8(p1, m));
+		_mm_storeu_si128(d+1, _mm_shuffle_epi8(p2, m));
+		_mm_storeu_si128(d+2, _mm_shuffle_epi8(p3, m));
+		_mm_storeu_si128(d+3, _mm_shuffle_epi8(p4, m));
+	}
+
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + x*4));
+		_mm_storeu_si128((__m128i *)(dst + x*4), _mm_shuffle_epi8(p, m));
+	}
+
+	if (x < width)
+		row_swap4(src + x*4, dst + x*4, width - x);
+}
+
+// 16 pixels (48 bytes) per loop are split into four registers of 4 pixels
+// and each is expanded to 16 bytes with alpha set to 255.
+static inline SPOUT_TARGET_SSSE3 void ssse3_3to4(const unsigned char *src, unsigned char *dst, unsigned int width, bool bSwap)
+{
+	const __m128i m = bSwap ?
+		_mm_set_epi8(-128,9,10,11, -128,6,7,8, -128,3,4,5, -128,0,1,2) :
+		_mm_set_epi8(-128,11,10,9, -128,8,7,6, -128,5,4,3, -128,2,1,0);
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	unsigned int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		const __m128i *s = (const __m128i *)(src + x*3);
+		__m128i *d = (__m128i *)(dst + x*4);
+		__m128i a = _mm_loadu_si128(s);
+		__m128i b = _mm_loadu_si128(s+1);
+		__m128i c = _mm_loadu_si128(s+2);
+		__m128i p1 = a;                        // bytes 0-11
+		__m128i p2 = _mm_alignr_epi8(b, a, 12); // bytes 12-23
+		__m128i p3 = _mm_alignr_epi8(c, b, 8);  // bytes 24-35
+		__m128i p4 = _mm_srli_si128(c, 4);      // bytes 36-47
+		_mm_storeu_si128(d,   _mm_or_si128(_mm_shuffle_epi8(p1, m), alpha));
+		_mm_storeu_si128(d+1, _mm_or_si128(_mm_shuffle_epi8(p2, m), alpha));
+		_mm_storeu_si128(d+2, _mm_or_si128(_mm_shuffle_epi8(p3, m), alpha));
+		_mm_storeu_si128(d+3, _mm_or_si128(_mm_shuffle_epi8(p4, m), alpha));
+	}
+
+	if (x < width) {
+		if (bSwap)
+			row_3to4_swap(src + x*3, dst + x*4, width - x);
+		else
+			row_3to4(src + x*3, dst + x*4, width - x);
+	}
+}
+
+// 16 pixels (64 bytes) per loop are packed to 12 bytes per register
+// and the four registers combined into 48 bytes.
+static inline SPOUT_TARGET_SSSE3 void ssse3_4to3(const unsigned char *src, unsigned char *dst, unsigned int width, bool bSwap)
+{
+	const __m128i m = bSwap ?
+		_mm_set_epi8(-128,-128,-128,-128, 12,13,14, 8,9,10, 4,5,6, 0,1,2) :
+		_mm_set_epi8(-128,-128,-128,-128, 14,13,12, 10,9,8, 6,5,4, 2,1,0);
+	unsigned int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		const __m128i *s = (const __m128i *)(src + x*4);
+		__m128i *d = (__m128i *)(dst + x*3);
+		__m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128(s),   m);
+		__m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128(s+1), m);
+		__m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128(s+2), m);
+		__m128i p4 = _mm_shuffle_epi8(_mm_loadu_si128(s+3), m);
+		_mm_storeu_si128(d,   _mm_or_si128(p1, _mm_slli_si128(p2, 12)));
+		_mm_storeu_si128(d+1, _mm_or_si128(_mm_srli_si128(p2, 4), _mm_slli_si128(p3, 8)));
+		_mm_storeu_si128(d+2, _mm_or_si128(_mm_srli_si128(p3, 8), _mm_slli_si128(p4, 4)));
+	}
+
+	if (x < width) {
+		if (bSwap)
+			row_4to3_swap(src + x*4, dst + x*3, width - x);
+		else
+			row_4to3(src + x*4, dst + x*3, width - x);
+	}
+}
+
+static SPOUT_TARGET_SSSE3 void row_3to4_ssse3(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	ssse3_3to4(src, dst, width, false);
+}
+
+static SPOUT_TARGET_SSSE3 void row_3to4_swap_ssse3(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	ssse3_3to4(src, dst, width, true);
+}
+
+static SPOUT_TARGET_SSSE3 void row_4to3_ssse3(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	ssse3_4to3(src, dst, width, false);
+}
+
+static SPOUT_TARGET_SSSE3 void row_4to3_swap_ssse3(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	ssse3_4to3(src, dst, width, true);
+}
+
+
+// ---------------------------------------------------------
+// AVX2
+//
+// _mm256_shuffle_epi8 works within each 128 bit lane,
+// so the SSSE3 masks are used for both lanes.
+// _mm256_zeroupper avoids a penalty when returning to SSE code.
+// ---------------------------------------------------------
+
+static inline SPOUT_TARGET_AVX2 __m256i avx2_mask(__m128i m)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(m), m, 1);
+}
+
+static SPOUT_TARGET_AVX2 void row_swap4_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m256i m = avx2_mask(_mm_set_epi8(15,12,13,14,11,8,9,10,7,4,5,6,3,0,1,2));
+	unsigned int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		const __m256i *s = (const __m256i *)(src + x*4);
+		__m256i *d = (__m256i *)(dst + x*4);
+		__m256i p1 = _mm256_loadu_si256(s);
+		__m256i p2 = _mm256_loadu_si256(s+1);
+		_mm256_storeu_si256(d,   _mm256_shuffle_epi8(p1, m));
+		_mm256_storeu_si256(d+1, _mm256_shuffle_epi8(p2, m));
+	}
+
+	for (; x + 8 <= width; x += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i *)(src + x*4));
+		_mm256_storeu_si256((__m256i *)(dst + x*4), _mm256_shuffle_epi8(p, m));
+	}
+
+	_mm256_zeroupper();
+
+	if (x < width)
+		row_swap4(src + x*4, dst + x*4, width - x);
+}
+
+// 8 pixels per loop. The second 4 pixels start at byte 12 and are
+// loaded directly into the upper lane. The last load reads 28 bytes.
+static inline SPOUT_TARGET_AVX2 void avx2_3to4(const unsigned char *src, unsigned char *dst, unsigned int width, bool bSwap)
+{
+	const __m256i m = bSwap ?
+		avx2_mask(_mm_set_epi8(-128,9,10,11, -128,6,7,8, -128,3,4,5, -128,0,1,2)) :
+		avx2_mask(_mm_set_epi8(-128,11,10,9, -128,8,7,6, -128,5,4,3, -128,2,1,0));
+	const __m256i alpha = _mm256_set1_epi32(0xff000000);
+	unsigned int x = 0;
+
+	for (; x + 10 <= width; x += 8) {
+		const unsigned char *s = src + x*3;
+		__m256i p = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)s)),
+			_mm_loadu_si128((const __m128i *)(s + 12)), 1);
+		p = _mm256_or_si256(_mm256_shuffle_epi8(p, m), alpha);
+		_mm256_storeu_si256((__m256i *)(dst + x*4), p);
+	}
+
+	_mm256_zeroupper();
+
+	if (x < width) {
+		if (bSwap)
+			row_3to4_swap(src + x*3, dst + x*4, width - x);
+		else
+			row_3to4(src + x*3, dst + x*4, width - x);
+	}
+}
+
+// 8 pixels per loop. Each lane is packed to 12 bytes, then the
+// 32 bit words are moved together to give 24 contiguous bytes.
+static inline SPOUT_TARGET_AVX2 void avx2_4to3(const unsigned char *src, unsigned char *dst, unsigned int width, bool bSwap)
+{
+	const __m256i m = bSwap ?
+		avx2_mask(_mm_set_epi8(-128,-128,-128,-128, 12,13,14, 8,9,10, 4,5,6, 0,1,2)) :
+		avx2_mask(_mm_set_epi8(-128,-128,-128,-128, 14,13,12, 10,9,8, 6,5,4, 2,1,0));
+	const __m256i idx = _mm256_set_epi32(7,3, 6,5,4, 2,1,0);
+	unsigned int x = 0;
+
+	for (; x + 8 <= width; x += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i *)(src + x*4));
+		p = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p, m), idx);
+		unsigned char *d = dst + x*3;
+		_mm_storeu_si128((__m128i *)d, _mm256_castsi256_si128(p));
+		_mm_storel_epi64((__m128i *)(d + 16), _mm256_extracti128_si256(p, 1));
+	}
+
+	_mm256_zeroupper();
+
+	if (x < width) {
+		if (bSwap)
+			row_4to3_swap(src + x*4, dst + x*3, width - x);
+		else
+			row_4to3(src + x*4, dst + x*3, width - x);
+	}
+}
+
+static SPOUT_TARGET_AVX2 void row_3to4_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx2_3to4(src, dst, width, false);
+}
+
+static SPOUT_TARGET_AVX2 void row_3to4_swap_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx2_3to4(src, dst, width, true);
+}
+
+static SPOUT_TARGET_AVX2 void row_4to3_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx2_4to3(src, dst, width, false);
+}
+
+static SPOUT_TARGET_AVX2 void row_4to3_swap_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx2_4to3(src, dst, width, true);
+}
+
+
+#ifdef SPOUT_AVX512
+// ---------------------------------------------------------
+// AVX-512BW
+//
+// 16 pixels per loop. The remaining pixels use masked loads and
+// stores so there is no scalar loop.
+// ---------------------------------------------------------
+
+static SPOUT_TARGET_AVX512 void row_swap4_avx512(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m512i m = _mm512_broadcast_i32x4(_mm_set_epi8(15,12,13,14,11,8,9,10,7,4,5,6,3,0,1,2));
+	unsigned int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m512i p = _mm512_loadu_si512((const void *)(src + x*4));
+		_mm512_storeu_si512((void *)(dst + x*4), _mm512_shuffle_epi8(p, m));
+	}
+
+	if (x < width) {
+		__mmask16 k = (__mmask16)((1u << (width - x)) - 1);
+		__m512i p = _mm512_maskz_loadu_epi32(k, (const void *)(src + x*4));
+		_mm512_mask_storeu_epi32((void *)(dst + x*4), k, _mm512_shuffle_epi8(p, m));
+	}
+
+	_mm256_zeroupper();
+}
+
+// 48 source bytes are loaded and each group of 4 pixels
+// moved to its own lane before the shuffle.
+static inline SPOUT_TARGET_AVX512 void avx512_3to4(const unsigned char *src, unsigned char *dst, unsigned int width, bool bSwap)
+{
+	const __m512i m = bSwap ?
+		_mm512_broadcast_i32x4(_mm_set_epi8(-128,9,10,11, -128,6,7,8, -128,3,4,5, -128,0,1,2)) :
+		_mm512_broadcast_i32x4(_mm_set_epi8(-128,11,10,9, -128,8,7,6, -128,5,4,3, -128,2,1,0));
+	const __m512i idx = _mm512_set_epi32(12,11,10,9, 9,8,7,6, 6,5,4,3, 3,2,1,0);
+	const __m512i alpha = _mm512_set1_epi32(0xff000000);
+	unsigned int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m512i p = _mm512_maskz_loadu_epi8((__mmask64)0xFFFFFFFFFFFFULL, (const void *)(src + x*3));
+		p = _mm512_permutexvar_epi32(idx, p);
+		p = _mm512_or_si512(_mm512_shuffle_epi8(p, m), alpha);
+		_mm512_storeu_si512((void *)(dst + x*4), p);
+	}
+
+	if (x < width) {
+		unsigned int n = width - x;
+		__m512i p = _mm512_maskz_loadu_epi8((__mmask64)((1ULL << (n*3)) - 1), (const void *)(src + x*3));
+		p = _mm512_permutexvar_epi32(idx, p);
+		p = _mm512_or_si512(_mm512_shuffle_epi8(p, m), alpha);
+		_mm512_mask_storeu_epi32((void *)(dst + x*4), (__mmask16)((1u << n) - 1), p);
+	}
+
+	_mm256_zeroupper();
+}
+
+// Each lane is packed to 12 bytes and the lanes moved together
+// to give 48 contiguous bytes.
+static inline SPOUT_TARGET_AVX512 void avx512_4to3(const unsigned char *src, unsigned char *dst, unsigned int width, bool bSwap)
+{
+	const __m512i m = bSwap ?
+		_mm512_broadcast_i32x4(_mm_set_epi8(-128,-128,-128,-128, 12,13,14, 8,9,10, 4,5,6, 0,1,2)) :
+		_mm512_broadcast_i32x4(_mm_set_epi8(-128,-128,-128,-128, 14,13,12, 10,9,8, 6,5,4, 2,1,0));
+	const __m512i idx = _mm512_set_epi32(0,0,0,0, 14,13,12, 10,9,8, 6,5,4, 2,1,0);
+	unsigned int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m512i p = _mm512_loadu_si512((const void *)(src + x*4));
+		p = _mm512_permutexvar_epi32(idx, _mm512_shuffle_epi8(p, m));
+		_mm512_mask_storeu_epi8((void *)(dst + x*3), (__mmask64)0xFFFFFFFFFFFFULL, p);
+	}
+
+	if (x < width) {
+		unsigned int n = width - x;
+		__m512i p = _mm512_maskz_loadu_epi32((__mmask16)((1u << n) - 1), (const void *)(src + x*4));
+		p = _mm512_permutexvar_epi32(idx, _mm512_shuffle_epi8(p, m));
+		_mm512_mask_storeu_epi8((void *)(dst + x*3), (__mmask64)((1ULL << (n*3)) - 1), p);
+	}
+
+	_mm256_zeroupper();
+}
+
+static SPOUT_TARGET_AVX512 void row_3to4_avx512(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx512_3to4(src, dst, width, false);
+}
+
+static SPOUT_TARGET_AVX512 void row_3to4_swap_avx512(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx512_3to4(src, dst, width, true);
+}
+
+static SPOUT_TARGET_AVX512 void row_4to3_avx512(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx512_4to3(src, dst, width, false);
+}
+
+static SPOUT_TARGET_AVX512 void row_4to3_swap_avx512(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	avx512_4to3(src, dst, width, true);
+}
+#endif
+
+
+// ---------------------------------------------------------
+// High bit depth
+//
+// Line functions between 8 bit rgba and the 16 bit unorm (GL_RGBA16),
+// half float (GL_RGBA16F) and 10 bit packed (GL_RGB10_A2) formats,
+// and between 16 bit unorm and the other two.
+// All are in rgba order. GL_RGB10_A2 is red in the low 10 bits
+// and alpha in the top 2 bits, the same as DXGI_FORMAT_R10G10B10A2_UNORM.
+//
+// Values are rounded to the nearest. Half floats outside 0-1 are clamped.
+// The SIMD functions give the same result as the scalar functions.
+// ---------------------------------------------------------
+
+// Float to half with round to nearest even, as _mm_cvtps_ph
+static unsigned short half_from_float(float f)
+{
+	uint32_t x = 0;
+	memcpy(&x, &f, 4);
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t absx = x & 0x7FFFFFFF;
+	uint32_t e = absx >> 23;
+
+	if (absx >= 0x7F800000) // infinity or nan
+		return (unsigned short)(sign | 0x7C00 | (absx > 0x7F800000 ? 0x200 : 0));
+	if (absx >= 0x477FF000) // 65520 and over rounds to infinity
+		return (unsigned short)(sign | 0x7C00);
+	if (absx < 0x33000000) // 2^-25 and less rounds to zero
+		return (unsigned short)sign;
+
+	if (absx < 0x38800000) { // half subnormal
+		uint32_t m = (absx & 0x7FFFFF) | 0x800000;
+		uint32_t shift = 126 - e;
+		uint32_t h = m >> shift;
+		uint32_t rem = m & ((1U << shift) - 1);
+		uint32_t half = 1U << (shift - 1);
+		if (rem > half || (rem == half && (h & 1))) h++;
+		return (unsigned short)(sign | h);
+	}
+
+	uint32_t h = ((e - 112) << 10) | ((absx >> 13) & 0x3FF);
+	uint32_t rem = absx & 0x1FFF;
+	if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+	return (unsigned short)(sign | h);
+}
+
+static float half_to_float(unsigned short h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t e = (h >> 10) & 0x1F;
+	uint32_t m = h & 0x3FF;
+	uint32_t x = 0;
+	float f = 0.0f;
+
+	if (e == 0) { // zero or subnormal
+		f = (float)m*(1.0f/16777216.0f);
+		return sign ? -f : f;
+	}
+	if (e == 31)
+		x = sign | 0x7F800000 | (m << 13);
+	else
+		x = sign | ((e + 112) << 23) | (m << 13);
+	memcpy(&f, &x, 4);
+	return f;
+}
+
+// Clamp to 0-1 and scale to an integer. Nan is 0.
+static inline unsigned int unorm_from_float(float f, float scale)
+{
+	if (!(f > 0.0f)) f = 0.0f;
+	if (f > 1.0f) f = 1.0f;
+	return (unsigned int)(f*scale + 0.5f);
+}
+
+static void row_8to16(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned short *d = (unsigned short *)dst;
+	for (unsigned int i = 0; i < width*4; i++)
+		d[i] = (unsigned short)(src[i]*257);
+}
+
+static void row_16to8(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const unsigned short *s = (const unsigned short *)src;
+	for (unsigned int i = 0; i < width*4; i++)
+		dst[i] = (unsigned char)((s[i]*255U + 32767U)/65535U);
+}
+
+static void row_8to16f(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned short *d = (unsigned short *)dst;
+	for (unsigned int i = 0; i < width*4; i++)
+		d[i] = half_from_float((float)src[i]*(1.0f/255.0f));
+}
+
+static void row_16fto8(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const unsigned short *s = (const unsigned short *)src;
+	for (unsigned int i = 0; i < width*4; i++)
+		dst[i] = (unsigned char)unorm_from_float(half_to_float(s[i]), 255.0f);
+}
+
+static void row_16to16f(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const unsigned short *s = (const unsigned short *)src;
+	unsigned short *d = (unsigned short *)dst;
+	for (unsigned int i = 0; i < width*4; i++)
+		d[i] = half_from_float((float)s[i]*(1.0f/65535.0f));
+}
+
+static void row_16fto16(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const unsigned short *s = (const unsigned short *)src;
+	unsigned short *d = (unsigned short *)dst;
+	for (unsigned int i = 0; i < width*4; i++)
+		d[i] = (unsigned short)unorm_from_float(half_to_float(s[i]), 65535.0f);
+}
+
+static void row_8to10(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	uint32_t *d = (uint32_t *)dst;
+	for (unsigned int x = 0; x < width; x++) {
+		uint32_t r = src[x*4 + 0];
+		uint32_t g = src[x*4 + 1];
+		uint32_t b = src[x*4 + 2];
+		uint32_t a = src[x*4 + 3];
+		// Bit replication of 8 to 10 bits
+		r = (r << 2) | (r >> 6);
+		g = (g << 2) | (g >> 6);
+		b = (b << 2) | (b >> 6);
+		a = (a*3 + 127)/255;
+		d[x] = r | (g << 10) | (b << 20) | (a << 30);
+	}
+}
+
+static void row_10to8(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const uint32_t *s = (const uint32_t *)src;
+	for (unsigned int x = 0; x < width; x++) {
+		uint32_t p = s[x];
+		dst[x*4 + 0] = (unsigned char)(((p & 0x3FF)*255 + 511)/1023);
+		dst[x*4 + 1] = (unsigned char)((((p >> 10) & 0x3FF)*255 + 511)/1023);
+		dst[x*4 + 2] = (unsigned char)((((p >> 20) & 0x3FF)*255 + 511)/1023);
+		dst[x*4 + 3] = (unsigned char)((p >> 30)*85);
+	}
+}
+
+static void row_16to10(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const unsigned short *s = (const unsigned short *)src;
+	uint32_t *d = (uint32_t *)dst;
+	for (unsigned int x = 0; x < width; x++) {
+		uint32_t r = (s[x*4 + 0]*1023U + 32767U)/65535U;
+		uint32_t g = (s[x*4 + 1]*1023U + 32767U)/65535U;
+		uint32_t b = (s[x*4 + 2]*1023U + 32767U)/65535U;
+		uint32_t a = (s[x*4 + 3]*3U + 32767U)/65535U;
+		d[x] = r | (g << 10) | (b << 20) | (a << 30);
+	}
+}
+
+static void row_10to16(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const uint32_t *s = (const uint32_t *)src;
+	unsigned short *d = (unsigned short *)dst;
+	for (unsigned int x = 0; x < width; x++) {
+		uint32_t p = s[x];
+		d[x*4 + 0] = (unsigned short)(((p & 0x3FF)*65535U + 511)/1023);
+		d[x*4 + 1] = (unsigned short)((((p >> 10) & 0x3FF)*65535U + 511)/1023);
+		d[x*4 + 2] = (unsigned short)((((p >> 20) & 0x3FF)*65535U + 511)/1023);
+		d[x*4 + 3] = (unsigned short)((p >> 30)*21845);
+	}
+}
+
+//
+// SSE2
+//
+
+// v*257 by unpacking each byte with itself
+static void row_8to16_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + x*4));
+		_mm_storeu_si128((__m128i *)(dst + x*8),      _mm_unpacklo_epi8(v, v));
+		_mm_storeu_si128((__m128i *)(dst + x*8 + 16), _mm_unpackhi_epi8(v, v));
+	}
+	if (x < width)
+		row_8to16(src + x*4, dst + x*8, width - x);
+}
+
+// v/257 rounded is (t - (t >> 8)) >> 8 with t = v + 128
+static inline __m128i sse2_div257(__m128i v)
+{
+	__m128i t = _mm_adds_epu16(v, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_sub_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void row_16to8_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i a = sse2_div257(_mm_loadu_si128((const __m128i *)(src + x*8)));
+		__m128i b = sse2_div257(_mm_loadu_si128((const __m128i *)(src + x*8 + 16)));
+		_mm_storeu_si128((__m128i *)(dst + x*4), _mm_packus_epi16(a, b));
+	}
+	if (x < width)
+		row_16to8(src + x*8, dst + x*4, width - x);
+}
+
+// Channels of 4 packed 10 bit pixels
+static inline void sse2_unpack10(__m128i p, __m128i &r, __m128i &g, __m128i &b, __m128i &a)
+{
+	const __m128i mask = _mm_set1_epi32(0x3FF);
+	r = _mm_and_si128(p, mask);
+	g = _mm_and_si128(_mm_srli_epi32(p, 10), mask);
+	b = _mm_and_si128(_mm_srli_epi32(p, 20), mask);
+	a = _mm_srli_epi32(p, 30);
+}
+
+// v*(2^dstBits - 1)/(2^srcBits - 1) rounded, for 32 bit lanes.
+// A float estimate of the quotient is corrected by the remainder.
+static inline __m128i sse2_rescale(__m128i v, int srcBits, int dstBits)
+{
+	const __m128i sbits = _mm_cvtsi32_si128(srcBits);
+	const __m128i d = _mm_set1_epi32((1 << srcBits) - 1);
+	__m128i x = _mm_sub_epi32(_mm_sll_epi32(v, _mm_cvtsi32_si128(dstBits)), v);
+	x = _mm_add_epi32(x, _mm_srli_epi32(d, 1));
+	__m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f/(float)((1 << srcBits) - 1))));
+	__m128i r = _mm_sub_epi32(x, _mm_sub_epi32(_mm_sll_epi32(q, sbits), q));
+	q = _mm_sub_epi32(q, _mm_cmpgt_epi32(r, _mm_sub_epi32(d, _mm_set1_epi32(1)))); // r >= d
+	q = _mm_add_epi32(q, _mm_cmplt_epi32(r, _mm_setzero_si128())); // r < 0
+	return q;
+}
+
+static void row_8to10_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + x*4));
+		__m128i r = _mm_and_si128(p, mask);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+		__m128i a = sse2_rescale(_mm_srli_epi32(p, 24), 8, 2);
+		r = _mm_or_si128(_mm_slli_epi32(r, 2), _mm_srli_epi32(r, 6));
+		g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 6));
+		b = _mm_or_si128(_mm_slli_epi32(b, 2), _mm_srli_epi32(b, 6));
+		p = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 10)),
+						 _mm_or_si128(_mm_slli_epi32(b, 20), _mm_slli_epi32(a, 30)));
+		_mm_storeu_si128((__m128i *)(dst + x*4), p);
+	}
+	if (x < width)
+		row_8to10(src + x*4, dst + x*4, width - x);
+}
+
+static void row_10to8_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i r, g, b, a;
+		sse2_unpack10(_mm_loadu_si128((const __m128i *)(src + x*4)), r, g, b, a);
+		r = sse2_rescale(r, 10, 8);
+		g = sse2_rescale(g, 10, 8);
+		b = sse2_rescale(b, 10, 8);
+		a = _mm_mullo_epi16(a, _mm_set1_epi32(85)); // a < 4
+		__m128i p = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+								 _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+		_mm_storeu_si128((__m128i *)(dst + x*4), p);
+	}
+	if (x < width)
+		row_10to8(src + x*4, dst + x*4, width - x);
+}
+
+static void row_16to10_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m128i mask = _mm_set1_epi32(0xFFFF);
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		// Red-green and blue-alpha pairs of 4 pixels
+		__m128 p0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + x*8)));
+		__m128 p1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + x*8 + 16)));
+		__m128i rg = _mm_castps_si128(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i ba = _mm_castps_si128(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1)));
+		__m128i r = sse2_rescale(_mm_and_si128(rg, mask), 16, 10);
+		__m128i g = sse2_rescale(_mm_srli_epi32(rg, 16), 16, 10);
+		__m128i b = sse2_rescale(_mm_and_si128(ba, mask), 16, 10);
+		__m128i a = sse2_rescale(_mm_srli_epi32(ba, 16), 16, 2);
+		__m128i p = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 10)),
+								 _mm_or_si128(_mm_slli_epi32(b, 20), _mm_slli_epi32(a, 30)));
+		_mm_storeu_si128((__m128i *)(dst + x*4), p);
+	}
+	if (x < width)
+		row_16to10(src + x*8, dst + x*4, width - x);
+}
+
+static void row_10to16_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i r, g, b, a;
+		sse2_unpack10(_mm_loadu_si128((const __m128i *)(src + x*4)), r, g, b, a);
+		r = sse2_rescale(r, 10, 16);
+		g = sse2_rescale(g, 10, 16);
+		b = sse2_rescale(b, 10, 16);
+		a = _mm_mullo_epi16(a, _mm_set1_epi32(21845)); // a < 4
+		__m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+		__m128i ba = _mm_or_si128(b, _mm_slli_epi32(a, 16));
+		_mm_storeu_si128((__m128i *)(dst + x*8),      _mm_unpacklo_epi32(rg, ba));
+		_mm_storeu_si128((__m128i *)(dst + x*8 + 16), _mm_unpackhi_epi32(rg, ba));
+	}
+	if (x < width)
+		row_10to16(src + x*4, dst + x*8, width - x);
+}
+
+//
+// AVX2 and F16C for half floats, two pixels per conversion
+//
+static inline SPOUT_TARGET_F16C __m256 avx2_unorm(__m256 f, float scale)
+{
+	f = _mm256_max_ps(f, _mm256_setzero_ps()); // nan is 0
+	f = _mm256_min_ps(f, _mm256_set1_ps(1.0f));
+	return _mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(scale)), _mm256_set1_ps(0.5f));
+}
+
+static SPOUT_TARGET_F16C void row_8to16f_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f/255.0f);
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + x*4)));
+		__m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
+		_mm_storeu_si128((__m128i *)(dst + x*8), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+	}
+	_mm256_zeroupper();
+	if (x < width)
+		row_8to16f(src + x*4, dst + x*8, width - x);
+}
+
+static SPOUT_TARGET_F16C void row_16fto8_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		__m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + x*8)));
+		__m256i v = _mm256_cvttps_epi32(avx2_unorm(f, 255.0f));
+		__m128i w = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storel_epi64((__m128i *)(dst + x*4), _mm_packus_epi16(w, w));
+	}
+	_mm256_zeroupper();
+	if (x < width)
+		row_16fto8(src + x*8, dst + x*4, width - x);
+}
+
+static SPOUT_TARGET_F16C void row_16to16f_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f/65535.0f);
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		__m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + x*8)));
+		__m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
+		_mm_storeu_si128((__m128i *)(dst + x*8), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+	}
+	_mm256_zeroupper();
+	if (x < width)
+		row_16to16f(src + x*8, dst + x*8, width - x);
+}
+
+static SPOUT_TARGET_F16C void row_16fto16_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		__m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + x*8)));
+		__m256i v = _mm256_cvttps_epi32(avx2_unorm(f, 65535.0f));
+		__m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storeu_si128((__m128i *)(dst + x*8), w);
+	}
+	_mm256_zeroupper();
+	if (x < width)
+		row_16fto16(src + x*8, dst + x*8, width - x);
+}
+
+
+// ---------------------------------------------------------
+// Alpha
+//
+// Functions for rgba or bgra lines with alpha in the fourth byte.
+// Source and destination can be the same.
+//
+// Opaque        - alpha 255
+// Premultiply   - colour * alpha/255
+// Unpremultiply - colour * 255/alpha, limited to 255, and 0 if alpha is 0
+// ---------------------------------------------------------
+
+static void row_opaque(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const uint32_t *s = (const uint32_t *)src;
+	uint32_t *d = (uint32_t *)dst;
+	for (unsigned int x = 0; x < width; x++)
+		d[x] = s[x] | 0xFF000000;
+}
+
+static void row_premultiply(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		unsigned int a = src[x*4 + 3];
+		for (unsigned int c = 0; c < 3; c++) {
+			unsigned int t = src[x*4 + c]*a + 128;
+			dst[x*4 + c] = (unsigned char)((t + (t >> 8)) >> 8);
+		}
+		dst[x*4 + 3] = (unsigned char)a;
+	}
+}
+
+static void row_unpremultiply(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	for (unsigned int x = 0; x < width; x++) {
+		unsigned int a = src[x*4 + 3];
+		for (unsigned int c = 0; c < 3; c++) {
+			unsigned int v = 0;
+			if (a > 0) {
+				v = (src[x*4 + c]*255 + a/2)/a;
+				if (v > 255) v = 255;
+			}
+			dst[x*4 + c] = (unsigned char)v;
+		}
+		dst[x*4 + 3] = (unsigned char)a;
+	}
+}
+
+static void row_opaque_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + x*4));
+		_mm_storeu_si128((__m128i *)(dst + x*4), _mm_or_si128(p, alpha));
+	}
+	if (x < width)
+		row_opaque(src + x*4, dst + x*4, width - x);
+}
+
+// Two pixels of 16 bit channels times their alpha
+static inline __m128i sse2_premultiply(__m128i c)
+{
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, 0xFF), 0xFF);
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void row_premultiply_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + x*4));
+		__m128i lo = sse2_premultiply(_mm_unpacklo_epi8(p, zero));
+		__m128i hi = sse2_premultiply(_mm_unpackhi_epi8(p, zero));
+		__m128i r = _mm_packus_epi16(lo, hi);
+		r = _mm_or_si128(_mm_andnot_si128(alpha, r), _mm_and_si128(alpha, p));
+		_mm_storeu_si128((__m128i *)(dst + x*4), r);
+	}
+	if (x < width)
+		row_premultiply(src + x*4, dst + x*4, width - x);
+}
+
+// (c*255 + a/2)/a for one pixel. The float division is exact enough
+// to give the same result as integer division.
+static inline __m128i sse2_unpremultiply(__m128i c, __m128 a)
+{
+	__m128 f = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(255.0f)), _mm_mul_ps(a, _mm_set1_ps(0.5f)));
+	return _mm_cvttps_epi32(_mm_div_ps(f, a)); // infinity and nan for alpha 0 give 0x80000000
+}
+
+static void row_unpremultiply_sse2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	unsigned int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + x*4));
+		// Alpha of 4 pixels
+		__m128 fa = _mm_cvtepi32_ps(_mm_srli_epi32(p, 24));
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+		__m128i c0 = sse2_unpremultiply(_mm_unpacklo_epi16(lo, zero), _mm_shuffle_ps(fa, fa, 0x00));
+		__m128i c1 = sse2_unpremultiply(_mm_unpackhi_epi16(lo, zero), _mm_shuffle_ps(fa, fa, 0x55));
+		__m128i c2 = sse2_unpremultiply(_mm_unpacklo_epi16(hi, zero), _mm_shuffle_ps(fa, fa, 0xAA));
+		__m128i c3 = sse2_unpremultiply(_mm_unpackhi_epi16(hi, zero), _mm_shuffle_ps(fa, fa, 0xFF));
+		// Saturation limits to 0-255
+		__m128i r = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+		r = _mm_or_si128(_mm_andnot_si128(alpha, r), _mm_and_si128(alpha, p));
+		_mm_storeu_si128((__m128i *)(dst + x*4), r);
+	}
+	if (x < width)
+		row_unpremultiply(src + x*4, dst + x*4, width - x);
+}
+
+static SPOUT_TARGET_AVX2 void row_opaque_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i *)(src + x*4));
+		_mm256_storeu_si256((__m256i *)(dst + x*4), _mm256_or_si256(p, alpha));
+	}
+	_mm256_zeroupper();
+	if (x < width)
+		row_opaque_sse2(src + x*4, dst + x*4, width - x);
+}
+
+static inline SPOUT_TARGET_AVX2 __m256i avx2_premultiply(__m256i c)
+{
+	__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, 0xFF), 0xFF);
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c, a), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static SPOUT_TARGET_AVX2 void row_premultiply_avx2(const unsigned char *src, unsigned char *dst, unsigned int width)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i *)(src + x*4));
+		// Unpack and pack work within each lane so the order is kept
+		__m256i lo = avx2_premultiply(_mm256_unpacklo_epi8(p, zero));
+		__m256i hi = avx2_premultiply(_mm256_unpackhi_epi8(p, zero));
+		__m256i r = _mm256_packus_epi16(lo, hi);
+		r = _mm256_or_si256(_mm256_andnot_si256(alpha, r), _mm256_and_si256(alpha, p));
+		_mm256_storeu_si256((__m256i *)(dst + x*4), r);
+	}
+	_mm256_zeroupper();
+	if (x < width)
+		row_premultiply_sse2(src + x*4, dst + x*4, width - x);
+}
+
+
+
+//
+// Worker threads for copy and conversion of large images.
+//
+// The image is divided into horizontal stripes which are taken in turn
+// by the workers and the calling thread. The threads are created once
+// by SetThreadCount and wait on a condition variable between frames.
+//
+// Each thread has a line buffer for the stripe functions which is
+// kept between frames and only grows when a job needs more.
+//
+
+// Enlarge a line buffer if it is smaller than nBytes
+static bool reserve_scratch(unsigned char *&buffer, size_t &size, size_t nBytes)
+{
+	if (nBytes <= size)
+		return true;
+	unsigned char *p = (unsigned char *)realloc((void *)buffer, nBytes);
+	if (!p)
+		return false;
+	buffer = p;
+	size = nBytes;
+	return true;
+}
+
+
+class spoutCopyPool {
+
+	public:
+
+		spoutCopyPool(unsigned int nWorkers);
+		~spoutCopyPool();
+
+		unsigned int GetWorkerCount();
+
+		// Call func(arg, stripe, scratch) for all stripes and return when all are done.
+		// scratch is a line buffer of at least scratchBytes for the thread taking the stripe.
+		// Returns false without starting if the line buffers cannot be allocated.
+		bool Run(void (*func)(void *arg, unsigned int stripe, unsigned char *scratch),
+				 void *arg, unsigned int nStripes, size_t scratchBytes);
+
+	private :
+
+		void Worker(unsigned int index);
+
+		std::vector<std::thread> m_threads;
+		std::mutex m_runMutex; // one job at a time
+		std::mutex m_mutex; // job state
+		std::condition_variable m_start;
+		std::condition_variable m_done;
+		std::vector<unsigned char *> m_scratch; // line buffer for each thread, the caller is first
+		std::vector<size_t> m_scratchSize;
+		void (*m_func)(void *arg, unsigned int stripe, unsigned char *scratch);
+		void *m_arg;
+		unsigned int m_nStripes;  // stripes in this job
+		unsigned int m_next;      // next stripe to be taken
+		unsigned int m_remaining; // stripes not finished
+		unsigned int m_job;       // incremented for each job
+		bool m_bQuit;
+
+};
+
+
+spoutCopyPool::spoutCopyPool(unsigned int nWorkers)
+{
+	m_func = NULL;
+	m_arg = NULL;
+	m_nStripes = 0;
+	m_next = 0;
+	m_remaining = 0;
+	m_job = 0;
+	m_bQuit = false;
+	m_scratch.assign(nWorkers + 1, (unsigned char *)NULL);
+	m_scratchSize.assign(nWorkers + 1, 0);
+	for (unsigned int i = 0; i < nWorkers; i++)
+		m_threads.push_back(std::thread(&spoutCopyPool::Worker, this, i + 1));
+}
+
+
+spoutCopyPool::~spoutCopyPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bQuit = true;
+	}
+	m_start.notify_all();
+	for (size_t i = 0; i < m_threads.size(); i++)
+		m_threads[i].join();
+	for (size_t i = 0; i < m_scratch.size(); i++) {
+		if (m_scratch[i])
+			free((void *)m_scratch[i]);
+	}
+}
+
+
+unsigned int spoutCopyPool::GetWorkerCount()
+{
+	return (unsigned int)m_threads.size();
+}
+
+
+bool spoutCopyPool::Run(void (*func)(void *arg, unsigned int stripe, unsigned char *scratch),
+						void *arg, unsigned int nStripes, size_t scratchBytes)
+{
+	std::lock_guard<std::mutex> runlock(m_runMutex);
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// The workers are waiting, so their buffers can be changed
+	for (size_t i = 0; i < m_scratch.size(); i++) {
+		if (!reserve_scratch(m_scratch[i], m_scratchSize[i], scratchBytes)) {
+			printf("spoutCopyPool::Run - could not allocate %u byte line buffer\n", (unsigned int)scratchBytes);
+			return false;
+		}
+	}
+
+	m_func = func;
+	m_arg = arg;
+	m_nStripes = nStripes;
+	m_next = 0;
+	m_remaining = nStripes;
+	m_job++;
+	m_start.notify_all();
+
+	// The calling thread works on stripes too
+	while (m_next < m_nStripes) {
+		unsigned int stripe = m_next++;
+		lock.unlock();
+		func(arg, stripe, m_scratch[0]);
+		lock.lock();
+		m_remaining--;
+	}
+
+	while (m_remaining > 0)
+		m_done.wait(lock);
+
+	return true;
+}
+
+
+void spoutCopyPool::Worker(unsigned int index)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	unsigned int job = m_job;
+
+	for (;;) {
+		while (!m_bQuit && m_job == job)
+			m_start.wait(lock);
+		if (m_bQuit)
+			return;
+		job = m_job;
+
+		// Stripes are taken under the lock so that
+		// the job details always match the stripe
+		while (m_next < m_nStripes) {
+			unsigned int stripe = m_next++;
+			void (*func)(void *, unsigned int, unsigned char *) = m_func;
+			void *arg = m_arg;
+			unsigned char *scratch = m_scratch[index];
+			lock.unlock();
+			func(arg, stripe, scratch);
+			lock.lock();
+			if (--m_remaining == 0)
+				m_done.notify_all();
+		}
+	}
+}
+
+
+//
+// Copy or conversion of a range of lines
+//
+struct spoutRowJob {
+	spoutCopy *pCopy;
+	const unsigned char *src;
+	unsigned char *dst;
+	unsigned int width;
+	unsigned int height;
+	size_t srcPitch;
+	size_t dstPitch;
+	size_t rowBytes; // bytes copied per line
+	spoutRowFunc rowfunc; // NULL for copy
+	spoutRowFunc rowfunc2; // second conversion if not NULL
+	unsigned int midBytes; // bytes per pixel between the two conversions
+	spoutRowFunc alphafunc; // alpha mode for the destination line, NULL to keep
+	bool bInvert;
+	bool bSSE2; // large enough for memcpy_sse2
+	unsigned int rowsPerStripe;
+};
+
+
+static inline void copy_block(const spoutRowJob *job, unsigned char *dst, const unsigned char *src, size_t size)
+{
+	if (job->bSSE2)
+		job->pCopy->memcpy_sse2((void *)dst, (void *)src, size);
+	else
+		memcpy((void *)dst, (const void *)src, size);
+}
+
+
+// Line buffer for two conversions
+static size_t convert_scratch_size(const spoutRowJob *job)
+{
+	return job->rowfunc2 ? (size_t)job->width*job->midBytes : 0;
+}
+
+
+static void convert_stripe(const spoutRowJob *job, unsigned int y0, unsigned int y1, unsigned char *scratch)
+{
+	unsigned char *dst = job->dst + y0*job->dstPitch;
+	const unsigned char *src = NULL;
+
+	// Contiguous lines are copied as one block
+	if (!job->rowfunc && !job->alphafunc && !job->bInvert
+		&& job->srcPitch == job->rowBytes && job->dstPitch == job->rowBytes) {
+		copy_block(job, dst, job->src + y0*job->srcPitch, (y1 - y0)*job->srcPitch);
+		return;
+	}
+
+	if (job->bInvert)
+		src = job->src + (job->height - 1 - y0)*job->srcPitch; // source from the bottom line up
+	else
+		src = job->src + y0*job->srcPitch;
+
+	unsigned char *line = job->rowfunc2 ? scratch : NULL;
+
+	for (unsigned int y = y0; y < y1; y++) {
+		if (line) {
+			job->rowfunc(src, line, job->width);
+			job->rowfunc2(line, dst, job->width);
+		}
+		else if (job->rowfunc)
+			job->rowfunc(src, dst, job->width);
+		else if (!job->alphafunc)
+			copy_block(job, dst, src, job->rowBytes);
+
+		// Alpha while the line is in the cache, or instead of a copy
+		if (job->alphafunc)
+			job->alphafunc(job->rowfunc ? dst : src, dst, job->width);
+		if (job->bInvert)
+			src -= job->srcPitch;
+		else
+			src += job->srcPitch;
+		dst += job->dstPitch;
+	}
+}
+
+
+static void convert_stripe_thread(void *arg, unsigned int stripe, unsigned char *scratch)
+{
+	const spoutRowJob *job = (const spoutRowJob *)arg;
+	unsigned int y0 = stripe*job->rowsPerStripe;
+	unsigned int y1 = y0 + job->rowsPerStripe;
+	if (y1 > job->height) y1 = job->height;
+	if (y0 < y1)
+		convert_stripe(job, y0, y1, scratch);
+}
+
+
+//
+// Resampling
+//
+// Each destination line is made from one source line (nearest),
+// two lines blended vertically (bilinear) or the sum of all lines
+// covered (box). Sources of 3 bytes per pixel are first expanded to 4.
+// The horizontal pass then writes a 4 byte line which is converted
+// to the destination format by the line functions.
+//
+// Weights are 8 bit fixed point (0-256) and box averages use a
+// fixed point reciprocal of the pixel count.
+//
+struct spoutResampleJob {
+	const unsigned char *src;
+	unsigned char *dst;
+	unsigned int srcWidth;
+	unsigned int srcHeight;
+	unsigned int dstWidth;
+	unsigned int dstHeight;
+	size_t srcPitch;
+	size_t dstPitch;
+	spoutRowFunc expand; // 3 to 4 bytes for rgb and bgr sources, NULL for 4 bytes
+	spoutRowFunc pack; // 4 byte line to the destination format, NULL to copy
+	spoutRowFunc alpha; // alpha mode for a 4 byte destination, NULL to keep
+	int mode;
+	bool bInvert;
+	bool bSIMD; // SSE2 line functions, false for SPOUT_ISA_SCALAR
+	const unsigned int *xofs; // source pixel for each destination pixel (first pixel for box)
+	const unsigned short *xfrac; // bilinear weight of the next pixel or box pixel count
+	unsigned int rowsPerStripe;
+};
+
+
+// Source line as 4 bytes per pixel
+static inline const unsigned char *resample_line(const spoutResampleJob *job, unsigned int sy, unsigned char *buffer)
+{
+	const unsigned char *line = job->src + sy*job->srcPitch;
+	if (!job->expand)
+		return line;
+	job->expand(line, buffer, job->srcWidth);
+	return buffer;
+}
+
+
+// Vertical blend of two lines, f is the weight of line b (0-256)
+static void resample_blend(const unsigned char *a, const unsigned char *b, unsigned char *dst, unsigned int nBytes, unsigned int f, bool bSIMD)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wa = _mm_set1_epi16((short)(256 - f));
+	const __m128i wb = _mm_set1_epi16((short)f);
+	const __m128i half = _mm_set1_epi16(128);
+	unsigned int i = 0;
+
+	for (; bSIMD && i + 16 <= nBytes; i += 16) {
+		__m128i pa = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i pb = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), wa), _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), wb));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), wa), _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), wb));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	for (; i < nBytes; i++)
+		dst[i] = (unsigned char)((a[i]*(256 - f) + b[i]*f + 128) >> 8);
+}
+
+
+// Horizontal bilinear, two destination pixels per loop.
+// The line has one extra pixel at the end so that x+1 can always be read.
+static void resample_bilinear_line(const unsigned char *line, unsigned char *dst, const spoutResampleJob *job)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi16(128);
+	const unsigned int *xofs = job->xofs;
+	const unsigned short *xfrac = job->xfrac;
+	unsigned int width = job->dstWidth;
+	unsigned int x = 0;
+
+	for (; job->bSIMD && x + 2 <= width; x += 2) {
+		// Pixels x0 and x0+1 as 16 bit
+		__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(line + xofs[x]*4)), zero);
+		__m128i q = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(line + xofs[x+1]*4)), zero);
+		short fp = (short)xfrac[x];
+		short fq = (short)xfrac[x+1];
+		p = _mm_mullo_epi16(p, _mm_set_epi16(fp, fp, fp, fp, 256-fp, 256-fp, 256-fp, 256-fp));
+		q = _mm_mullo_epi16(q, _mm_set_epi16(fq, fq, fq, fq, 256-fq, 256-fq, 256-fq, 256-fq));
+		__m128i s = _mm_add_epi16(_mm_unpacklo_epi64(p, q), _mm_unpackhi_epi64(p, q));
+		s = _mm_srli_epi16(_mm_add_epi16(s, half), 8);
+		_mm_storel_epi64((__m128i *)(dst + x*4), _mm_packus_epi16(s, s));
+	}
+
+	for (; x < width; x++) {
+		const unsigned char *a = line + xofs[x]*4;
+		unsigned int f = xfrac[x];
+		for (unsigned int c = 0; c < 4; c++)
+			dst[x*4 + c] = (unsigned char)((a[c]*(256 - f) + a[c+4]*f + 128) >> 8);
+	}
+}
+
+
+// Add a line to the 32 bit box sums
+static void resample_accumulate(const unsigned char *line, uint32_t *sum, unsigned int nBytes, bool bSIMD)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int i = 0;
+
+	for (; bSIMD && i + 16 <= nBytes; i += 16) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(line + i));
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+		__m128i *s = (__m128i *)(sum + i);
+		_mm_storeu_si128(s,   _mm_add_epi32(_mm_loadu_si128(s),   _mm_unpacklo_epi16(lo, zero)));
+		_mm_storeu_si128(s+1, _mm_add_epi32(_mm_loadu_si128(s+1), _mm_unpackhi_epi16(lo, zero)));
+		_mm_storeu_si128(s+2, _mm_add_epi32(_mm_loadu_si128(s+2), _mm_unpacklo_epi16(hi, zero)));
+		_mm_storeu_si128(s+3, _mm_add_epi32(_mm_loadu_si128(s+3), _mm_unpackhi_epi16(hi, zero)));
+	}
+
+	for (; i < nBytes; i++)
+		sum[i] += line[i];
+}
+
+
+// Horizontal box average of the summed lines
+static void resample_box_line(const uint32_t *sum, unsigned char *dst, unsigned int nLines, const spoutResampleJob *job)
+{
+	const __m128i half = _mm_set_epi32(0, 0x40000000, 0, 0x40000000);
+	const unsigned int *xofs = job->xofs;
+	const unsigned short *xfrac = job->xfrac;
+
+	if (!job->bSIMD) {
+		for (unsigned int x = 0; x < job->dstWidth; x++) {
+			const uint32_t *s = sum + xofs[x]*4;
+			unsigned int count = xfrac[x];
+			unsigned int n = count*nLines;
+			uint64_t r = (0x80000000u + n/2)/n;
+			for (unsigned int c = 0; c < 4; c++) {
+				uint32_t total = 0;
+				for (unsigned int i = 0; i < count; i++)
+					total += s[i*4 + c];
+				uint64_t v = ((uint64_t)total*r + 0x40000000) >> 31;
+				dst[x*4 + c] = (unsigned char)(v > 255 ? 255 : v);
+			}
+		}
+		return;
+	}
+
+	for (unsigned int x = 0; x < job->dstWidth; x++) {
+		const __m128i *s = (const __m128i *)(sum + xofs[x]*4);
+		unsigned int count = xfrac[x];
+		__m128i total = _mm_setzero_si128();
+		for (unsigned int i = 0; i < count; i++)
+			total = _mm_add_epi32(total, _mm_loadu_si128(s + i));
+		// Multiply by the reciprocal of the pixel count (1.31 fixed point)
+		// with 64 bit products
+		unsigned int n = count*nLines;
+		__m128i r = _mm_set1_epi32((int)((0x80000000u + n/2)/n));
+		__m128i even = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(total, r), half), 31);
+		__m128i odd  = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(total, 32), r), half), 31);
+		__m128i v = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+		v = _mm_packs_epi32(v, v);
+		*(uint32_t *)(dst + x*4) = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+	}
+}
+
+
+// Two expanded source lines, a blended line with one extra pixel,
+// box sums and the output line
+static size_t resample_scratch_size(const spoutResampleJob *job)
+{
+	size_t srcBytes = (size_t)job->srcWidth*4;
+	return srcBytes*2 + (srcBytes + 4) + srcBytes*4 + (size_t)job->dstWidth*4;
+}
+
+
+static void resample_stripe(const spoutResampleJob *job, unsigned int y0, unsigned int y1, unsigned char *scratch)
+{
+	unsigned int srcBytes = job->srcWidth*4;
+
+	unsigned char *lineA = scratch;
+	unsigned char *lineB = lineA + srcBytes;
+	unsigned char *blend = lineB + srcBytes;
+	uint32_t *sum = (uint32_t *)(blend + srcBytes + 4);
+	unsigned char *out = (unsigned char *)(sum + srcBytes);
+
+	for (unsigned int y = y0; y < y1; y++) {
+
+		// Flip by taking source lines from the bottom up
+		uint64_t yy = job->bInvert ? (job->dstHeight - 1 - y) : y;
+		unsigned char *dst = job->dst + y*job->dstPitch;
+		unsigned char *line = job->pack ? out : dst;
+
+		if (job->mode == SPOUT_RESAMPLE_BILINEAR) {
+			// Source position of the destination pixel centre
+			int64_t pos = (int64_t)(((2*yy + 1)*job->srcHeight) << 15)/job->dstHeight - 32768;
+			if (pos < 0) pos = 0;
+			unsigned int sy = (unsigned int)(pos >> 16);
+			unsigned int f = (unsigned int)(((pos & 0xFFFF) + 128) >> 8);
+			if (sy >= job->srcHeight - 1) {
+				sy = job->srcHeight - 1;
+				f = 0;
+			}
+			const unsigned char *a = resample_line(job, sy, lineA);
+			if (f > 0)
+				resample_blend(a, resample_line(job, sy + 1, lineB), blend, srcBytes, f, job->bSIMD);
+			else
+				memcpy(blend, a, srcBytes);
+			// Repeat the last pixel
+			memcpy(blend + srcBytes, blend + srcBytes - 4, 4);
+			resample_bilinear_line(blend, line, job);
+		}
+		else if (job->mode == SPOUT_RESAMPLE_BOX) {
+			// Source lines covered by the destination line
+			unsigned int sy0 = (unsigned int)((yy*job->srcHeight)/job->dstHeight);
+			unsigned int sy1 = (unsigned int)(((yy + 1)*job->srcHeight)/job->dstHeight);
+			if (sy1 <= sy0) sy1 = sy0 + 1;
+			memset(sum, 0, srcBytes*sizeof(uint32_t));
+			for (unsigned int sy = sy0; sy < sy1; sy++)
+				resample_accumulate(resample_line(job, sy, lineA), sum, srcBytes, job->bSIMD);
+			resample_box_line(sum, line, sy1 - sy0, job);
+		}
+		else {
+			// Nearest
+			unsigned int sy = (unsigned int)(((2*yy + 1)*job->srcHeight)/(2*job->dstHeight));
+			const uint32_t *s = (const uint32_t *)resample_line(job, sy, lineA);
+			uint32_t *d = (uint32_t *)line;
+			for (unsigned int x = 0; x < job->dstWidth; x++)
+				d[x] = s[job->xofs[x]];
+		}
+
+		if (job->alpha)
+			job->alpha(line, line, job->dstWidth);
+
+		if (job->pack)
+			job->pack(out, dst, job->dstWidth);
+	}
+}
+
+
+static void resample_stripe_thread(void *arg, unsigned int stripe, unsigned char *scratch)
+{
+	const spoutResampleJob *job = (const spoutResampleJob *)arg;
+	unsigned int y0 = stripe*job->rowsPerStripe;
+	unsigned int y1 = y0 + job->rowsPerStripe;
+	if (y1 > job->dstHeight) y1 = job->dstHeight;
+	if (y0 < y1)
+		resample_stripe(job, y0, y1, scratch);
+}
+
+
+// Bytes per pixel and red/blue order of the 8 bit formats
+static bool format_info(GLenum glFormat, unsigned int &nBytes, bool &bBGR)
+{
+	switch (glFormat) {
+		case GL_RGBA:     nBytes = 4; bBGR = false; return true;
+		case GL_BGRA_EXT: nBytes = 4; bBGR = true;  return true;
+		case GL_RGB:      nBytes = 3; bBGR = false; return true;
+		case GL_BGR_EXT:  nBytes = 3; bBGR = true;  return true;
+		default: return false;
+	}
+}
+
+
+//
+// YUV conversion
+//
+// Fixed point matrices for BT.601 and BT.709 with full (0-255) or
+// limited (16-235, 16-240) range. Rgba to yuv coefficients are scaled
+// by 2^15 and applied with _mm_madd_epi16 to pairs of 16 bit channels.
+// Yuv to rgba coefficients are scaled by 2^13.
+//
+// Chroma is the average of 2 pixels (4:2:2) or 2x2 pixels (4:2:0)
+// and is repeated for each pixel when converting back to rgba.
+//
+// Lines are converted through temporary Y, U and V lines
+// which are then packed or unpacked for each format.
+//
+struct spoutYUVCoef {
+	short y[4]; // r, g, b, 0
+	short u[4];
+	short v[4];
+	int yOffset; // 16 or 0
+	short yk;  // y scale
+	short vr;  // v to red
+	short ug;  // u to green
+	short vg;  // v to green
+	short ub;  // u to blue
+};
+
+
+static void yuv_coefficients(spoutYUVCoef *coef, int matrix, bool bFullRange)
+{
+	double Kr = 0.299;
+	double Kb = 0.114;
+	if (matrix == SPOUT_YUV_BT709) {
+		Kr = 0.2126;
+		Kb = 0.0722;
+	}
+	double Kg = 1.0 - Kr - Kb;
+	double sY = bFullRange ? 1.0 : 219.0/255.0;
+	double sC = bFullRange ? 1.0 : 224.0/255.0;
+
+	coef->y[0] = (short)(Kr*sY*32768.0 + 0.5);
+	coef->y[1] = (short)(Kg*sY*32768.0 + 0.5);
+	coef->y[2] = (short)(Kb*sY*32768.0 + 0.5);
+	coef->y[3] = 0;
+	coef->u[0] = (short)(-Kr/(2.0*(1.0 - Kb))*sC*32768.0 - 0.5);
+	coef->u[1] = (short)(-Kg/(2.0*(1.0 - Kb))*sC*32768.0 - 0.5);
+	coef->u[2] = (short)(0.5*sC*32768.0 + 0.5);
+	coef->u[3] = 0;
+	coef->v[0] = (short)(0.5*sC*32768.0 + 0.5);
+	coef->v[1] = (short)(-Kg/(2.0*(1.0 - Kr))*sC*32768.0 - 0.5);
+	coef->v[2] = (short)(-Kb/(2.0*(1.0 - Kr))*sC*32768.0 - 0.5);
+	coef->v[3] = 0;
+	coef->yOffset = bFullRange ? 0 : 16;
+
+	coef->yk = (short)(8192.0/sY + 0.5);
+	coef->vr = (short)(2.0*(1.0 - Kr)/sC*8192.0 + 0.5);
+	coef->ub = (short)(2.0*(1.0 - Kb)/sC*8192.0 + 0.5);
+	coef->ug = (short)(-2.0*Kb*(1.0 - Kb)/(Kg*sC)*8192.0 - 0.5);
+	coef->vg = (short)(-2.0*Kr*(1.0 - Kr)/(Kg*sC)*8192.0 - 0.5);
+}
+
+
+// Matrix row applied to 4 rgba pixels, result as 4 x 32 bit
+static inline __m128i yuv_madd4(__m128i p, __m128i k)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), k); // r*kr+g*kg, b*kb for 2 pixels
+	__m128i b = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), k);
+	__m128 fa = _mm_castsi128_ps(a);
+	__m128 fb = _mm_castsi128_ps(b);
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd  = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm_add_epi32(even, odd);
+}
+
+
+// One matrix row for a line of rgba pixels to 8 bit
+static void yuv_matrix_line(const unsigned char *rgba, unsigned char *dst, unsigned int width, const short *k, int offset, bool bSIMD)
+{
+	const __m128i kv = _mm_set_epi16(k[3], k[2], k[1], k[0], k[3], k[2], k[1], k[0]);
+	const __m128i ov = _mm_set1_epi32((offset << 15) + (1 << 14));
+	unsigned int x = 0;
+
+	for (; bSIMD && x + 8 <= width; x += 8) {
+		__m128i a = yuv_madd4(_mm_loadu_si128((const __m128i *)(rgba + x*4)), kv);
+		__m128i b = yuv_madd4(_mm_loadu_si128((const __m128i *)(rgba + x*4 + 16)), kv);
+		a = _mm_srai_epi32(_mm_add_epi32(a, ov), 15);
+		b = _mm_srai_epi32(_mm_add_epi32(b, ov), 15);
+		__m128i w = _mm_packs_epi32(a, b);
+		_mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(w, w));
+	}
+
+	for (; x < width; x++) {
+		const unsigned char *p = rgba + x*4;
+		int v = (p[0]*k[0] + p[1]*k[1] + p[2]*k[2] + (offset << 15) + (1 << 14)) >> 15;
+		dst[x] = (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+	}
+}
+
+
+// Average of pixel pairs of a line, and of two lines if b is not NULL.
+// The samples are summed in 16 bits and rounded once, the same as the tail.
+static void yuv_chroma_average(const unsigned char *a, const unsigned char *b, unsigned char *dst, unsigned int width, bool bSIMD)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(b ? 2 : 1);
+	const __m128i shift = _mm_cvtsi32_si128(b ? 2 : 1);
+	unsigned int x = 0;
+
+	for (; bSIMD && x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(a + x*4));
+		__m128i lo = _mm_unpacklo_epi8(p, zero); // pixels 0 and 1
+		__m128i hi = _mm_unpackhi_epi8(p, zero); // pixels 2 and 3
+		if (b) {
+			__m128i q = _mm_loadu_si128((const __m128i *)(b + x*4));
+			lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(q, zero));
+			hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(q, zero));
+		}
+		// Sum of each pixel pair in the low 4 words
+		lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+		hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+		__m128i s = _mm_srl_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), shift);
+		_mm_storel_epi64((__m128i *)(dst + x*2), _mm_packus_epi16(s, s));
+	}
+
+	for (; x + 2 <= width; x += 2) {
+		for (unsigned int c = 0; c < 4; c++) {
+			unsigned int s = a[x*4 + c] + a[x*4 + 4 + c];
+			unsigned int n = 2;
+			if (b) {
+				s += b[x*4 + c] + b[x*4 + 4 + c];
+				n = 4;
+			}
+			dst[x*2 + c] = (unsigned char)((s + n/2)/n);
+		}
+	}
+}
+
+
+// Y, U and V lines to rgba
+static void yuv_rgba_line(const unsigned char *ybuf, const unsigned char *ubuf, const unsigned char *vbuf,
+						  unsigned char *dst, unsigned int width, const spoutYUVCoef *coef, bool bSIMD)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i yoff = _mm_set1_epi16((short)coef->yOffset);
+	const __m128i coff = _mm_set1_epi16(128);
+	const __m128i kr = _mm_set_epi16(coef->vr, coef->yk, coef->vr, coef->yk, coef->vr, coef->yk, coef->vr, coef->yk);
+	const __m128i kb = _mm_set_epi16(coef->ub, coef->yk, coef->ub, coef->yk, coef->ub, coef->yk, coef->ub, coef->yk);
+	const __m128i kg = _mm_set_epi16(coef->ug, coef->yk, coef->ug, coef->yk, coef->ug, coef->yk, coef->ug, coef->yk);
+	const __m128i kv = _mm_set1_epi32((unsigned short)coef->vg);
+	const __m128i round = _mm_set1_epi32(4096);
+	const __m128i alpha = _mm_set1_epi8(-1);
+	unsigned int x = 0;
+
+	for (; bSIMD && x + 8 <= width; x += 8) {
+		__m128i y = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(ybuf + x)), zero), yoff);
+		__m128i u = _mm_cvtsi32_si128(*(const int *)(ubuf + x/2));
+		__m128i v = _mm_cvtsi32_si128(*(const int *)(vbuf + x/2));
+		u = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(u, u), zero), coff);
+		v = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(v, v), zero), coff);
+
+		__m128i yvlo = _mm_unpacklo_epi16(y, v), yvhi = _mm_unpackhi_epi16(y, v);
+		__m128i yulo = _mm_unpacklo_epi16(y, u), yuhi = _mm_unpackhi_epi16(y, u);
+		__m128i vzlo = _mm_unpacklo_epi16(v, zero), vzhi = _mm_unpackhi_epi16(v, zero);
+
+		__m128i r = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvlo, kr), round), 13),
+									_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvhi, kr), round), 13));
+		__m128i b = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yulo, kb), round), 13),
+									_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuhi, kb), round), 13));
+		__m128i glo = _mm_add_epi32(_mm_madd_epi16(yulo, kg), _mm_madd_epi16(vzlo, kv));
+		__m128i ghi = _mm_add_epi32(_mm_madd_epi16(yuhi, kg), _mm_madd_epi16(vzhi, kv));
+		__m128i g = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(glo, round), 13),
+									_mm_srai_epi32(_mm_add_epi32(ghi, round), 13));
+
+		r = _mm_packus_epi16(r, r);
+		g = _mm_packus_epi16(g, g);
+		b = _mm_packus_epi16(b, b);
+		__m128i rg = _mm_unpacklo_epi8(r, g);
+		__m128i ba = _mm_unpacklo_epi8(b, alpha);
+		_mm_storeu_si128((__m128i *)(dst + x*4),      _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128((__m128i *)(dst + x*4 + 16), _mm_unpackhi_epi16(rg, ba));
+	}
+
+	for (; x < width; x++) {
+		int y = ybuf[x] - coef->yOffset;
+		int u = ubuf[x/2] - 128;
+		int v = vbuf[x/2] - 128;
+		int r = (y*coef->yk + v*coef->vr + 4096) >> 13;
+		int g = (y*coef->yk + u*coef->ug + v*coef->vg + 4096) >> 13;
+		int b = (y*coef->yk + u*coef->ub + 4096) >> 13;
+		dst[x*4 + 0] = (unsigned char)(r < 0 ? 0 : (r > 255 ? 255 : r));
+		dst[x*4 + 1] = (unsigned char)(g < 0 ? 0 : (g > 255 ? 255 : g));
+		dst[x*4 + 2] = (unsigned char)(b < 0 ? 0 : (b > 255 ? 255 : b));
+		dst[x*4 + 3] = 255;
+	}
+}
+
+
+// Interleave U and V (NV12) or Y, U and V (YUY2 and UYVY)
+static void yuv_pack_line(const unsigned char *ybuf, const unsigned char *ubuf, const unsigned char *vbuf,
+						  unsigned char *dst, unsigned int width, unsigned int format, bool bSIMD)
+{
+	unsigned int half = width/2;
+	unsigned int x = 0;
+
+	if (format == SPOUT_YUV_NV12) {
+		for (; bSIMD && x + 16 <= half; x += 16) {
+			__m128i u = _mm_loadu_si128((const __m128i *)(ubuf + x));
+			__m128i v = _mm_loadu_si128((const __m128i *)(vbuf + x));
+			_mm_storeu_si128((__m128i *)(dst + x*2),      _mm_unpacklo_epi8(u, v));
+			_mm_storeu_si128((__m128i *)(dst + x*2 + 16), _mm_unpackhi_epi8(u, v));
+		}
+		for (; x < half; x++) {
+			dst[x*2 + 0] = ubuf[x];
+			dst[x*2 + 1] = vbuf[x];
+		}
+		return;
+	}
+
+	// 8 chroma pairs and 16 pixels per loop
+	for (; bSIMD && x + 8 <= half; x += 8) {
+		__m128i y = _mm_loadu_si128((const __m128i *)(ybuf + x*2));
+		__m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(ubuf + x)), _mm_loadl_epi64((const __m128i *)(vbuf + x)));
+		if (format == SPOUT_YUV_YUY2) {
+			_mm_storeu_si128((__m128i *)(dst + x*4),      _mm_unpacklo_epi8(y, uv));
+			_mm_storeu_si128((__m128i *)(dst + x*4 + 16), _mm_unpackhi_epi8(y, uv));
+		}
+		else {
+			_mm_storeu_si128((__m128i *)(dst + x*4),      _mm_unpacklo_epi8(uv, y));
+			_mm_storeu_si128((__m128i *)(dst + x*4 + 16), _mm_unpackhi_epi8(uv, y));
+		}
+	}
+
+	for (; x < half; x++) {
+		unsigned char *d = dst + x*4;
+		if (format == SPOUT_YUV_YUY2) {
+			d[0] = ybuf[x*2]; d[1] = ubuf[x]; d[2] = ybuf[x*2 + 1]; d[3] = vbuf[x];
+		}
+		else {
+			d[0] = ubuf[x]; d[1] = ybuf[x*2]; d[2] = vbuf[x]; d[3] = ybuf[x*2 + 1];
+		}
+	}
+}
+
+
+// Separate interleaved U and V (NV12) or Y, U and V (YUY2 and UYVY)
+static void yuv_unpack_line(const unsigned char *src, unsigned char *ybuf, unsigned char *ubuf, unsigned char *vbuf,
+							unsigned int width, unsigned int format, bool bSIMD)
+{
+	const __m128i lowbytes = _mm_set1_epi16(0x00FF);
+	unsigned int half = width/2;
+	unsigned int x = 0;
+
+	if (format == SPOUT_YUV_NV12) {
+		for (; bSIMD && x + 8 <= half; x += 8) {
+			__m128i uv = _mm_loadu_si128((const __m128i *)(src + x*2));
+			__m128i u = _mm_and_si128(uv, lowbytes);
+			__m128i v = _mm_srli_epi16(uv, 8);
+			_mm_storel_epi64((__m128i *)(ubuf + x), _mm_packus_epi16(u, u));
+			_mm_storel_epi64((__m128i *)(vbuf + x), _mm_packus_epi16(v, v));
+		}
+		for (; x < half; x++) {
+			ubuf[x] = src[x*2 + 0];
+			vbuf[x] = src[x*2 + 1];
+		}
+		return;
+	}
+
+	// 16 pixels per loop
+	for (; bSIMD && x + 8 <= half; x += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + x*4));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + x*4 + 16));
+		__m128i y, uv;
+		if (format == SPOUT_YUV_YUY2) {
+			y  = _mm_packus_epi16(_mm_and_si128(a, lowbytes), _mm_and_si128(b, lowbytes));
+			uv = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+		}
+		else {
+			uv = _mm_packus_epi16(_mm_and_si128(a, lowbytes), _mm_and_si128(b, lowbytes));
+			y  = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+		}
+		_mm_storeu_si128((__m128i *)(ybuf + x*2), y);
+		__m128i u = _mm_and_si128(uv, lowbytes);
+		__m128i v = _mm_srli_epi16(uv, 8);
+		_mm_storel_epi64((__m128i *)(ubuf + x), _mm_packus_epi16(u, u));
+		_mm_storel_epi64((__m128i *)(vbuf + x), _mm_packus_epi16(v, v));
+	}
+
+	for (; x < half; x++) {
+		const unsigned char *s = src + x*4;
+		if (format == SPOUT_YUV_YUY2) {
+			ybuf[x*2] = s[0]; ubuf[x] = s[1]; ybuf[x*2 + 1] = s[2]; vbuf[x] = s[3];
+		}
+		else {
+			ubuf[x] = s[0]; ybuf[x*2] = s[1]; vbuf[x] = s[2]; ybuf[x*2 + 1] = s[3];
+		}
+	}
+}
+
+
+struct spoutYUVJob {
+	const unsigned char *src;
+	unsigned char *dst;
+	unsigned int width;
+	unsigned int height;
+	size_t pitch; // rgba line pitch
+	spoutRowFunc convert; // to or from rgba order, NULL if rgba
+	unsigned int rgbaBytes; // 3 or 4
+	unsigned int format; // SPOUT_YUV_NV12 etc.
+	bool bInvert; // rgba lines from the bottom up
+	bool bSIMD; // SSE2 line functions, false for SPOUT_ISA_SCALAR
+	spoutYUVCoef coef;
+	unsigned int rowsPerStripe; // even for 4:2:0
+};
+
+
+// Two rgba lines, averaged chroma, and Y, U and V lines
+static size_t yuv_encode_scratch_size(const spoutYUVJob *job)
+{
+	size_t width = job->width;
+	size_t half = width/2;
+	return width*4*2 + half*4 + width + half*2;
+}
+
+
+// Rgba to yuv for lines y0 to y1
+static void yuv_encode_stripe(const spoutYUVJob *job, unsigned int y0, unsigned int y1, unsigned char *scratch)
+{
+	unsigned int width = job->width;
+	unsigned int half = width/2;
+	bool b420 = (job->format == SPOUT_YUV_NV12 || job->format == SPOUT_YUV_I420);
+
+	unsigned char *rgba0 = scratch;
+	unsigned char *rgba1 = rgba0 + width*4;
+	unsigned char *chroma = rgba1 + width*4;
+	unsigned char *ybuf = chroma + half*4;
+	unsigned char *ubuf = ybuf + width;
+	unsigned char *vbuf = ubuf + half;
+
+	unsigned char *yplane = job->dst;
+	unsigned char *uplane = job->dst + (size_t)width*job->height;
+	unsigned char *vplane = uplane + (size_t)half*(job->height/2);
+
+	unsigned int step = b420 ? 2 : 1;
+	for (unsigned int y = y0; y < y1; y += step) {
+
+		const unsigned char *line[2] = { NULL, NULL };
+		unsigned char *buffer[2] = { rgba0, rgba1 };
+		for (unsigned int i = 0; i < step; i++) {
+			unsigned int sy = job->bInvert ? (job->height - 1 - (y + i)) : (y + i);
+			const unsigned char *s = job->src + sy*job->pitch;
+			if (job->convert) {
+				job->convert(s, buffer[i], width);
+				s = buffer[i];
+			}
+			line[i] = s;
+		}
+
+		yuv_chroma_average(line[0], line[1], chroma, width, job->bSIMD);
+		yuv_matrix_line(chroma, ubuf, half, job->coef.u, 128, job->bSIMD);
+		yuv_matrix_line(chroma, vbuf, half, job->coef.v, 128, job->bSIMD);
+
+		for (unsigned int i = 0; i < step; i++) {
+			unsigned int yy = y + i;
+			if (job->format == SPOUT_YUV_YUY2 || job->format == SPOUT_YUV_UYVY) {
+				yuv_matrix_line(line[i], ybuf, width, job->coef.y, job->coef.yOffset, job->bSIMD);
+				yuv_pack_line(ybuf, ubuf, vbuf, job->dst + (size_t)yy*width*2, width, job->format, job->bSIMD);
+			}
+			else {
+				yuv_matrix_line(line[i], yplane + (size_t)yy*width, width, job->coef.y, job->coef.yOffset, job->bSIMD);
+			}
+		}
+
+		if (job->format == SPOUT_YUV_NV12) {
+			yuv_pack_line(ybuf, ubuf, vbuf, uplane + (size_t)(y/2)*width, width, SPOUT_YUV_NV12, job->bSIMD);
+		}
+		else if (job->format == SPOUT_YUV_I420) {
+			memcpy(uplane + (size_t)(y/2)*half, ubuf, half);
+			memcpy(vplane + (size_t)(y/2)*half, vbuf, half);
+		}
+	}
+}
+
+
+// Rgba line and Y, U and V lines
+static size_t yuv_decode_scratch_size(const spoutYUVJob *job)
+{
+	size_t width = job->width;
+	return width*4 + width + (width/2)*2;
+}
+
+
+// Yuv to rgba for lines y0 to y1
+static void yuv_decode_stripe(const spoutYUVJob *job, unsigned int y0, unsigned int y1, unsigned char *scratch)
+{
+	unsigned int width = job->width;
+	unsigned int half = width/2;
+
+	unsigned char *rgba = scratch;
+	unsigned char *ybuf = rgba + width*4;
+	unsigned char *ubuf = ybuf + width;
+	unsigned char *vbuf = ubuf + half;
+
+	const unsigned char *yplane = job->src;
+	const unsigned char *uplane = job->src + (size_t)width*job->height;
+	const unsigned char *vplane = uplane + (size_t)half*(job->height/2);
+
+	for (unsigned int y = y0; y < y1; y++) {
+
+		const unsigned char *yline = ybuf;
+		const unsigned char *uline = ubuf;
+		const unsigned char *vline = vbuf;
+
+		switch (job->format) {
+			case SPOUT_YUV_NV12:
+				yline = yplane + (size_t)y*width;
+				yuv_unpack_line(uplane + (size_t)(y/2)*width, NULL, ubuf, vbuf, width, SPOUT_YUV_NV12, job->bSIMD);
+				break;
+			case SPOUT_YUV_I420:
+				yline = yplane + (size_t)y*width;
+				uline = uplane + (size_t)(y/2)*half;
+				vline = vplane + (size_t)(y/2)*half;
+				break;
+			default: // YUY2, UYVY
+				yuv_unpack_line(job->src + (size_t)y*width*2, ybuf, ubuf, vbuf, width, job->format, job->bSIMD);
+				break;
+		}
+
+		unsigned int dy = job->bInvert ? (job->height - 1 - y) : y;
+		unsigned char *d = job->dst + dy*job->pitch;
+		if (job->convert) {
+			yuv_rgba_line(yline, uline, vline, rgba, width, &job->coef, job->bSIMD);
+			job->convert(rgba, d, width);
+		}
+		else {
+			yuv_rgba_line(yline, uline, vline, d, width, &job->coef, job->bSIMD);
+		}
+	}
+}
+
+
+static void yuv_encode_thread(void *arg, unsigned int stripe, unsigned char *scratch)
+{
+	const spoutYUVJob *job = (const spoutYUVJob *)arg;
+	unsigned int y0 = stripe*job->rowsPerStripe;
+	unsigned int y1 = y0 + job->rowsPerStripe;
+	if (y1 > job->height) y1 = job->height;
+	if (y0 < y1)
+		yuv_encode_stripe(job, y0, y1, scratch);
+}
+
+
+static void yuv_decode_thread(void *arg, unsigned int stripe, unsigned char *scratch)
+{
+	const spoutYUVJob *job = (const spoutYUVJob *)arg;
+	unsigned int y0 = stripe*job->rowsPerStripe;
+	unsigned int y1 = y0 + job->rowsPerStripe;
+	if (y1 > job->height) y1 = job->height;
+	if (y0 < y1)
+		yuv_decode_stripe(job, y0, y1, scratch);
+}
+
 
 spoutCopy::spoutCopy() {
 	m_bSSE2 = false;
 	m_bSSE3 = false;
 	m_bSSSE3 = false;
+	m_bAVX2 = false;
+	m_bAVX512BW = false;
+	m_bF16C = false;
 	CheckSSE(); // SSE available - sets m_bSSE2, m_bSSE3, m_bSSSE3
+	CheckAVX(); // AVX available - sets m_bAVX2, m_bAVX512BW, m_bF16C
+
+	// Highest instruction set supported
+	m_maxISA = SPOUT_ISA_SCALAR;
+	if (m_bSSE2) m_maxISA = SPOUT_ISA_SSE2;
+	if (m_bSSE2 && m_bSSSE3) m_maxISA = SPOUT_ISA_SSSE3;
+	if (m_maxISA == SPOUT_ISA_SSSE3 && m_bAVX2) m_maxISA = SPOUT_ISA_AVX2;
+#ifdef SPOUT_AVX512
+	if (m_maxISA == SPOUT_ISA_AVX2 && m_bAVX512BW) m_maxISA = SPOUT_ISA_AVX512;
+#endif
+
+	// Line conversion functions for all formats
+	InitRowFunctions(m_maxISA);
+
+	// Single thread until SetThreadCount
+	m_pPool = NULL;
+	m_ThreadThreshold = 2*1024*1024;
+	m_pScratch = NULL;
+	m_ScratchSize = 0;
+
+	// Resample positions are created when needed
+	m_pResampleX = NULL;
+	m_pResampleF = NULL;
+	m_ResampleSrcWidth = 0;
+	m_ResampleDstWidth = 0;
+	m_ResampleMode = -1;
+
+	// Yuv conversion matrix
+	m_YUVmatrix = SPOUT_YUV_BT601;
+	m_bYUVfullRange = false;
+
+	// Alpha is copied unchanged
+	m_AlphaMode = SPOUT_ALPHA_KEEP;
 }
 
 spoutCopy::~spoutCopy() {
-
+	if (m_pPool) delete m_pPool;
+	if (m_pScratch) free((void *)m_pScratch);
+	if (m_pResampleX) free((void *)m_pResampleX);
+	if (m_pResampleF) free((void *)m_pResampleF);
 }
 
 
@@ -59,29 +2115,32 @@ void spoutCopy::CopyPixels(const unsigned char *source,
 							GLenum glFormat,
 							bool bInvert) 
 {
-	unsigned int Size = width*height*4; // RGBA default
+	CopyPixels(source, dest, width, height, 0, 0, glFormat, bInvert);
+}
+
+
+//
+// Source and destination line pitch in bytes.
+// A pitch of 0 is width*4 or width*3 for rgb and bgr.
+//
+void spoutCopy::CopyPixels(const unsigned char *source, 
+							unsigned char *dest, 
+							unsigned int width, 
+							unsigned int height, 
+							unsigned int srcPitch,
+							unsigned int dstPitch,
+							GLenum glFormat,
+							bool bInvert) 
+{
+	unsigned int nBytes = 4; // RGBA default
 
 	if (glFormat == GL_RGB || glFormat == GL_BGR_EXT) {
-		Size = width*height*3;
+		nBytes = 3;
 	}
 
-	if(bInvert) {
-		FlipBuffer(source, dest, width, height, glFormat);
-	}
-	else {
-		if (width < 320 || height < 240) { // Too small for assembler
-			memcpy((void *)dest, (void *)source, Size);
-		}
-		else if ((Size % 16) == 0 && m_bSSE2) { // 16 byte aligned SSE assembler
-			memcpy_sse2((void *)dest, (void *)source, Size);
-		}
-		else if ((Size % 4) == 0) { // 4 byte aligned assembler
-			__movsd((unsigned long *)dest, (unsigned long const *)source, Size/4);
-		}
-		else { // Default is standard memcpy
-			memcpy((void *)dest, (void *)source, Size);
-		}
-	}
+	// Without a line function, ConvertRows copies
+	// as one block, or line by line if inverted or pitched
+	ConvertRows(source, dest, width, height, nBytes, nBytes, srcPitch, dstPitch, NULL, bInvert);
 }
 
 
@@ -92,30 +2151,20 @@ bool spoutCopy::FlipBuffer(const unsigned char *src,
 						   unsigned int height,
 						   GLenum glFormat)
 {
-	const unsigned char * From = src;
-	unsigned char * To = dst;
-	unsigned int pitch = width * 4; // RGBA default
-
-	if (glFormat == GL_RGB || glFormat == GL_BGR_EXT) {
-		pitch = width * 3; // RGB format specified
-	}
-
-	unsigned int line_s = 0;
-	unsigned int line_t = (height - 1)*pitch;
+	CopyPixels(src, dst, width, height, 0, 0, glFormat, true);
+	return true;
+}
 
-	for (unsigned int y = 0; y<height; y++) {
-		if (width < 320 || height < 240) // too small for assembler
-			memcpy((void *)(To + line_t), (void *)(From + line_s), pitch);
-		else if ((pitch % 16) == 0 && m_bSSE2) // use sse assembler function
-			memcpy_sse2((void *)(To + line_t), (void *)(From + line_s), pitch);
-		else if ((pitch % 4) == 0) // use 4 byte move assembler function
-			__movsd((unsigned long *)(To + line_t), (unsigned long *)(From + line_s), pitch / 4);
-		else
-			memcpy((void *)(To + line_t), (void *)(From + line_s), pitch);
-		line_s += pitch;
-		line_t -= pitch;
-	}
 
+bool spoutCopy::FlipBuffer(const unsigned char *src, 
+						   unsigned char *dst,
+						   unsigned int width,
+						   unsigned int height,
+						   unsigned int srcPitch,
+						   unsigned int dstPitch,
+						   GLenum glFormat)
+{
+	CopyPixels(src, dst, width, height, srcPitch, dstPitch, glFormat, true);
 	return true;
 }
 
@@ -133,14 +2182,28 @@ bool spoutCopy::FlipBuffer(const unsigned char *src,
 //
 // Approx 1.7 times speed of memcpy (0.84 msec per frame 1920x1080)
 //
+// Any size and alignment. Bytes up to a 16 byte aligned destination
+// and the remainder after the last 128 byte block use memcpy.
+//
 void spoutCopy::memcpy_sse2(void* dst, void* src, size_t Size)
 {
 	char * pSrc = (char *)src;				  // Source buffer
 	char * pDst = (char *)dst;				  // Destination buffer
-	unsigned int n = (unsigned int)Size >> 7; // Counter = size divided by 128 (8 * 128bit registers)
+
+	// Streaming stores must be aligned
+	size_t head = (16 - ((size_t)pDst & 15)) & 15;
+	if (head > Size) head = Size;
+	if (head > 0) {
+		memcpy(pDst, pSrc, head);
+		pSrc += head;
+		pDst += head;
+		Size -= head;
+	}
+
+	size_t n = Size >> 7; // Counter = size divided by 128 (8 * 128bit registers)
 
 	__m128i Reg0, Reg1, Reg2, Reg3, Reg4, Reg5, Reg6, Reg7;
-	for (unsigned int Index = n; Index > 0; --Index) {
+	for (size_t Index = n; Index > 0; --Index) {
 
 		// SSE2 prefetch
 		_mm_prefetch(pSrc + 256, _MM_HINT_NTA);
@@ -150,14 +2213,15 @@ void spoutCopy::memcpy_sse2(void* dst, void* src, size_t Size)
 		// 8 x 128 bit (16 bytes each)
 		// Increment source pointer by 16 bytes each
 		// for a total of 128 bytes per cycle
-		Reg0 = _mm_load_si128((__m128i *)(pSrc));
-		Reg1 = _mm_load_si128((__m128i *)(pSrc + 16));
-		Reg2 = _mm_load_si128((__m128i *)(pSrc + 32));
-		Reg3 = _mm_load_si128((__m128i *)(pSrc + 48));
-		Reg4 = _mm_load_si128((__m128i *)(pSrc + 64));
-		Reg5 = _mm_load_si128((__m128i *)(pSrc + 80));
-		Reg6 = _mm_load_si128((__m128i *)(pSrc + 96));
-		Reg7 = _mm_load_si128((__m128i *)(pSrc + 112));
+		// The source need not be aligned
+		Reg0 = _mm_loadu_si128((__m128i *)(pSrc));
+		Reg1 = _mm_loadu_si128((__m128i *)(pSrc + 16));
+		Reg2 = _mm_loadu_si128((__m128i *)(pSrc + 32));
+		Reg3 = _mm_loadu_si128((__m128i *)(pSrc + 48));
+		Reg4 = _mm_loadu_si128((__m128i *)(pSrc + 64));
+		Reg5 = _mm_loadu_si128((__m128i *)(pSrc + 80));
+		Reg6 = _mm_loadu_si128((__m128i *)(pSrc + 96));
+		Reg7 = _mm_loadu_si128((__m128i *)(pSrc + 112));
 
 		// move data from registers to dest
 		_mm_stream_si128((__m128i *)(pDst), Reg0);
@@ -173,74 +2237,354 @@ void spoutCopy::memcpy_sse2(void* dst, void* src, size_t Size)
 		pDst += 128;
 	}
 
+	// Streaming stores are weakly ordered
+	_mm_sfence();
+
+	// Remainder
+	Size &= 127;
+	if (Size > 0)
+		memcpy(pDst, pSrc, Size);
+
+}
+
+
+//
+// cpuid and xgetbv for Visual Studio, gcc and clang
+//
+static void cpu_id(int CPUInfo[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(CPUInfo, leaf, subleaf);
+#else
+	unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+	__cpuid_count(leaf, subleaf, eax, ebx, ecx, edx);
+	CPUInfo[0] = (int)eax;
+	CPUInfo[1] = (int)ebx;
+	CPUInfo[2] = (int)ecx;
+	CPUInfo[3] = (int)edx;
+#endif
+}
+
+static uint64_t cpu_xgetbv()
+{
+#if defined(_MSC_VER)
+	return (uint64_t)_xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+
+//
+//					CheckSSE()
+//
+// https://msdn.microsoft.com/en-us/library/hskdteyh.aspx
+//
+// static bool SSE2 (void) { return CPU_Rep.f_1_EDX_[26]; }
+// SSE2 | [bit 26] EDX
+// SSE2 = (cpuid03 & (0x1 << 26))
+//
+// static bool SSE3 (void) { return CPU_Rep.f_1_ECX_[0]; }
+// SSE3 | [bit 0] ECX
+// SSE3 = (cpuid02 & (0x1)
+//
+// static bool SSSE3(void) { return CPU_Rep.f_1_ECX_[9]; }
+// SSSE3 | [bit 9] ECX
+// SSSE3 = (cpuid02 & (0x1 << 9)
+//
+// SSE4 not currently used :
+//
+// SSE4.1 and SSE4.2 are extensions of SSE, SSE2, SSE3, and SSSE3. 
+// To check if the processor supports SSE4.1, execute CPUID with EAX = 1 as input.
+// If bit 19 of ECX is set, then the processor supports SSE4.1.
+// To check if the processor supports SSE4.2 instructions for string / text processing,
+// PCMPGTQ, and CRC32, execute CPUID with EAX = 1 as input.
+// If bit 20 of ECX is set, then the processor supports these SSE4.2 in structions.
+//
+// static bool SSE41(void) { return CPU_Rep.f_1_ECX_[19]; }
+// SSE41 | [bit 19] ECX
+// SSE41 = (cpuid02 & (0x1 << 19))
+//
+// static bool SSE42(void) { return CPU_Rep.f_1_ECX_[20]; }
+// SSE42 | [bit 20] ECX
+// SSE42 = (cpuid02 & (0x1 << 20))
+//
+// EAX - CPUInfo[0]
+// EBX - CPUInfo[1]
+// ECX - CPUInfo[2]
+// EDX - CPUInfo[3]
+//
+// For intrinsics and SSE : https://software.intel.com/sites/landingpage/IntrinsicsGuide/
+//
+void spoutCopy::CheckSSE()
+{
+	// An array of four integers that contains the information returned
+	// in EAX (0), EBX (1), ECX (2), and EDX (3) about supported features of the CPU.
+	int CPUInfo[4] = { -1 };
+
+	//-- Get number of valid info ids
+	cpu_id(CPUInfo, 0, 0);
+	int nIds = CPUInfo[0];
+
+	//-- Get info for id "1"
+	if (nIds >= 1) {
+		// SSE2 | [bit 26] EDX
+		// SSE2 = (cpuid03 & (0x1 << 26))
+		cpu_id(CPUInfo, 1, 0); // EAX = 1 for cpuid
+		m_bSSE2 = ((CPUInfo[3] & (0x1 << 26)) || false);
+		// SSE3 | [bit 0] ECX
+		// SSE3 = (cpuid02 & (0x1)
+		m_bSSE3 = ((CPUInfo[2] & (0x1)) || false);
+		// SSSE3 | [bit 9] ECX
+		// SSSE3 = (cpuid02 & (0x1 << 9)
+		m_bSSSE3 = ((CPUInfo[2] & (0x1 << 9)) || false);
+	}
+
+}
+
+
+//
+//					CheckAVX()
+//
+// AVX2     | leaf 7 [bit 5] EBX
+// AVX512F  | leaf 7 [bit 16] EBX
+// AVX512BW | leaf 7 [bit 30] EBX
+// F16C     | leaf 1 [bit 29] ECX
+//
+// The operating system must also save the wider registers on a context switch.
+// This is tested by OSXSAVE (leaf 1 [bit 27] ECX) and then the XCR0 register :
+// XMM and YMM state [bits 1,2] for AVX2 and
+// opmask, ZMM0-15 upper and ZMM16-31 [bits 5,6,7] for AVX-512
+//
+void spoutCopy::CheckAVX()
+{
+	int CPUInfo[4] = { -1 };
+
+	cpu_id(CPUInfo, 0, 0);
+	int nIds = CPUInfo[0];
+	if (nIds < 7)
+		return;
+
+	cpu_id(CPUInfo, 1, 0);
+	bool bOSXSAVE = ((CPUInfo[2] & (0x1 << 27)) || false);
+	bool bAVX = ((CPUInfo[2] & (0x1 << 28)) || false);
+	if (!bOSXSAVE || !bAVX)
+		return;
+
+	uint64_t xcr0 = cpu_xgetbv();
+	if ((xcr0 & 0x6) != 0x6)
+		return; // No OS support for AVX registers
+
+	// Half float conversion uses the AVX registers
+	m_bF16C = ((CPUInfo[2] & (0x1 << 29)) || false);
+
+	cpu_id(CPUInfo, 7, 0);
+	m_bAVX2 = ((CPUInfo[1] & (0x1 << 5)) || false);
+
+	if ((xcr0 & 0xE6) == 0xE6) {
+		m_bAVX512BW = ((CPUInfo[1] & (0x1 << 16)) && (CPUInfo[1] & (0x1 << 30)));
+	}
+
+}
+
+
+//
+// Fill the table of line conversion functions
+// for the requested instruction set, limited to what the cpu supports
+//
+void spoutCopy::InitRowFunctions(int isa)
+{
+	if (isa > m_maxISA) isa = m_maxISA;
+	if (isa < SPOUT_ISA_SCALAR) isa = SPOUT_ISA_SCALAR;
+	m_ISA = isa;
+
+	m_RowFunc[SPOUT_ROW_SWAP4]      = row_swap4;
+	m_RowFunc[SPOUT_ROW_3TO4]       = row_3to4;
+	m_RowFunc[SPOUT_ROW_3TO4_SWAP]  = row_3to4_swap;
+	m_RowFunc[SPOUT_ROW_4TO3]       = row_4to3;
+	m_RowFunc[SPOUT_ROW_4TO3_SWAP]  = row_4to3_swap;
+	m_RowFunc[SPOUT_ROW_8TO16]      = row_8to16;
+	m_RowFunc[SPOUT_ROW_16TO8]      = row_16to8;
+	m_RowFunc[SPOUT_ROW_8TO16F]     = row_8to16f;
+	m_RowFunc[SPOUT_ROW_16FTO8]     = row_16fto8;
+	m_RowFunc[SPOUT_ROW_8TO10]      = row_8to10;
+	m_RowFunc[SPOUT_ROW_10TO8]      = row_10to8;
+	m_RowFunc[SPOUT_ROW_16TO16F]    = row_16to16f;
+	m_RowFunc[SPOUT_ROW_16FTO16]    = row_16fto16;
+	m_RowFunc[SPOUT_ROW_16TO10]     = row_16to10;
+	m_RowFunc[SPOUT_ROW_10TO16]     = row_10to16;
+	m_RowFunc[SPOUT_ROW_OPAQUE]        = row_opaque;
+	m_RowFunc[SPOUT_ROW_PREMULTIPLY]   = row_premultiply;
+	m_RowFunc[SPOUT_ROW_UNPREMULTIPLY] = row_unpremultiply;
+
+	// No SSE2 shuffle for 3 byte pixels, only rgba <> bgra
+	if (isa >= SPOUT_ISA_SSE2) {
+		m_RowFunc[SPOUT_ROW_SWAP4]  = row_swap4_sse2;
+		m_RowFunc[SPOUT_ROW_8TO16]  = row_8to16_sse2;
+		m_RowFunc[SPOUT_ROW_16TO8]  = row_16to8_sse2;
+		m_RowFunc[SPOUT_ROW_8TO10]  = row_8to10_sse2;
+		m_RowFunc[SPOUT_ROW_10TO8]  = row_10to8_sse2;
+		m_RowFunc[SPOUT_ROW_16TO10] = row_16to10_sse2;
+		m_RowFunc[SPOUT_ROW_10TO16] = row_10to16_sse2;
+		m_RowFunc[SPOUT_ROW_OPAQUE]        = row_opaque_sse2;
+		m_RowFunc[SPOUT_ROW_PREMULTIPLY]   = row_premultiply_sse2;
+		m_RowFunc[SPOUT_ROW_UNPREMULTIPLY] = row_unpremultiply_sse2;
+	}
+
+	if (isa >= SPOUT_ISA_SSSE3) {
+		m_RowFunc[SPOUT_ROW_SWAP4]      = row_swap4_ssse3;
+		m_RowFunc[SPOUT_ROW_3TO4]       = row_3to4_ssse3;
+		m_RowFunc[SPOUT_ROW_3TO4_SWAP]  = row_3to4_swap_ssse3;
+		m_RowFunc[SPOUT_ROW_4TO3]       = row_4to3_ssse3;
+		m_RowFunc[SPOUT_ROW_4TO3_SWAP]  = row_4to3_swap_ssse3;
+	}
+
+	if (isa >= SPOUT_ISA_AVX2) {
+		m_RowFunc[SPOUT_ROW_SWAP4]      = row_swap4_avx2;
+		m_RowFunc[SPOUT_ROW_3TO4]       = row_3to4_avx2;
+		m_RowFunc[SPOUT_ROW_3TO4_SWAP]  = row_3to4_swap_avx2;
+		m_RowFunc[SPOUT_ROW_4TO3]       = row_4to3_avx2;
+		m_RowFunc[SPOUT_ROW_4TO3_SWAP]  = row_4to3_swap_avx2;
+		m_RowFunc[SPOUT_ROW_OPAQUE]      = row_opaque_avx2;
+		m_RowFunc[SPOUT_ROW_PREMULTIPLY] = row_premultiply_avx2;
+		if (m_bF16C) {
+			m_RowFunc[SPOUT_ROW_8TO16F]  = row_8to16f_avx2;
+			m_RowFunc[SPOUT_ROW_16FTO8]  = row_16fto8_avx2;
+			m_RowFunc[SPOUT_ROW_16TO16F] = row_16to16f_avx2;
+			m_RowFunc[SPOUT_ROW_16FTO16] = row_16fto16_avx2;
+		}
+	}
+
+#ifdef SPOUT_AVX512
+	if (isa >= SPOUT_ISA_AVX512) {
+		m_RowFunc[SPOUT_ROW_SWAP4]      = row_swap4_avx512;
+		m_RowFunc[SPOUT_ROW_3TO4]       = row_3to4_avx512;
+		m_RowFunc[SPOUT_ROW_3TO4_SWAP]  = row_3to4_swap_avx512;
+		m_RowFunc[SPOUT_ROW_4TO3]       = row_4to3_avx512;
+		m_RowFunc[SPOUT_ROW_4TO3_SWAP]  = row_4to3_swap_avx512;
+	}
+#endif
+
+}
+
+
+int spoutCopy::GetISA()
+{
+	return m_ISA;
+}
+
+
+bool spoutCopy::SetISA(int isa)
+{
+	InitRowFunctions(isa);
+	return (m_ISA == isa);
+}
+
+
+//
+// Multi-threaded copy and conversion
+//
+// nThreads includes the calling thread.
+// 0 uses one thread for each processor, 1 (default) disables threads.
+//
+void spoutCopy::SetThreadCount(unsigned int nThreads)
+{
+	if (nThreads == 0) {
+		nThreads = std::thread::hardware_concurrency();
+		if (nThreads == 0) nThreads = 1;
+	}
+
+	if (m_pPool) {
+		if (m_pPool->GetWorkerCount() + 1 == nThreads)
+			return;
+		delete m_pPool;
+		m_pPool = NULL;
+	}
+
+	if (nThreads > 1)
+		m_pPool = new spoutCopyPool(nThreads - 1);
+}
+
+
+unsigned int spoutCopy::GetThreadCount()
+{
+	if (m_pPool)
+		return m_pPool->GetWorkerCount() + 1;
+	return 1;
+}
+
+
+// Minimum image size in bytes for multiple threads
+void spoutCopy::SetThreadThreshold(unsigned int nBytes)
+{
+	m_ThreadThreshold = nBytes;
+}
+
+
+unsigned int spoutCopy::GetThreadThreshold()
+{
+	return m_ThreadThreshold;
 }
 
 
 //
-//					CheckSSE()
-//
-// https://msdn.microsoft.com/en-us/library/hskdteyh.aspx
-//
-// static bool SSE2 (void) { return CPU_Rep.f_1_EDX_[26]; }
-// SSE2 | [bit 26] EDX
-// SSE2 = (cpuid03 & (0x1 << 26))
-//
-// static bool SSE3 (void) { return CPU_Rep.f_1_ECX_[0]; }
-// SSE3 | [bit 0] ECX
-// SSE3 = (cpuid02 & (0x1)
-//
-// static bool SSSE3(void) { return CPU_Rep.f_1_ECX_[9]; }
-// SSSE3 | [bit 9] ECX
-// SSSE3 = (cpuid02 & (0x1 << 9)
-//
-// SSE4 not currently used :
-//
-// SSE4.1 and SSE4.2 are extensions of SSE, SSE2, SSE3, and SSSE3. 
-// To check if the processor supports SSE4.1, execute CPUID with EAX = 1 as input.
-// If bit 19 of ECX is set, then the processor supports SSE4.1.
-// To check if the processor supports SSE4.2 instructions for string / text processing,
-// PCMPGTQ, and CRC32, execute CPUID with EAX = 1 as input.
-// If bit 20 of ECX is set, then the processor supports these SSE4.2 in structions.
-//
-// static bool SSE41(void) { return CPU_Rep.f_1_ECX_[19]; }
-// SSE41 | [bit 19] ECX
-// SSE41 = (cpuid02 & (0x1 << 19))
-//
-// static bool SSE42(void) { return CPU_Rep.f_1_ECX_[20]; }
-// SSE42 | [bit 20] ECX
-// SSE42 = (cpuid02 & (0x1 << 20))
-//
-// EAX - CPUInfo[0]
-// EBX - CPUInfo[1]
-// ECX - CPUInfo[2]
-// EDX - CPUInfo[3]
-//
-// For intrinsics and SSE : https://software.intel.com/sites/landingpage/IntrinsicsGuide/
+// Convert all lines of an image with a line function, or copy if NULL.
+// A second line function converts the result of the first, through
+// a line buffer of midBytes per pixel.
+// The alpha mode is applied to 8 bit rgba or bgra destinations
+// if the source has alpha and bAlpha is true.
+// If inverted, the source is read from the bottom line up.
+// A pitch of 0 is the width times the bytes per pixel.
+// Large images are divided into stripes for the worker threads.
+// Returns false if the line buffer for two conversions cannot be allocated.
 //
-void spoutCopy::CheckSSE()
+bool spoutCopy::ConvertRows(const void *source, void *dest,
+							unsigned int width, unsigned int height,
+							unsigned int srcBytes, unsigned int dstBytes,
+							unsigned int srcPitch, unsigned int dstPitch,
+							spoutRowFunc rowfunc, bool bInvert,
+							spoutRowFunc rowfunc2, unsigned int midBytes,
+							bool bAlpha)
 {
-	// An array of four integers that contains the information returned
-	// in EAX (0), EBX (1), ECX (2), and EDX (3) about supported features of the CPU.
-	int CPUInfo[4] = { -1 };
-
-	//-- Get number of valid info ids
-	__cpuid(CPUInfo, 0);
-	int nIds = CPUInfo[0];
+	if (width == 0 || height == 0)
+		return true;
+
+	spoutRowJob job;
+	job.pCopy = this;
+	job.src = (const unsigned char *)source;
+	job.dst = (unsigned char *)dest;
+	job.width = width;
+	job.height = height;
+	job.srcPitch = srcPitch > 0 ? srcPitch : (size_t)width*srcBytes;
+	job.dstPitch = dstPitch > 0 ? dstPitch : (size_t)width*dstBytes;
+	job.rowBytes = (size_t)width*dstBytes;
+	job.rowfunc = rowfunc;
+	job.rowfunc2 = rowfunc ? rowfunc2 : NULL;
+	job.midBytes = midBytes;
+	job.alphafunc = NULL;
+	if (bAlpha && dstBytes == 4 && srcBytes != 3)
+		job.alphafunc = GetAlphaFunction();
+	job.bInvert = bInvert;
+	job.bSSE2 = (m_bSSE2 && width >= 320 && height >= 240); // too small for assembler
+	job.rowsPerStripe = height;
+
+	size_t size = (size_t)height*(job.srcPitch > job.dstPitch ? job.srcPitch : job.dstPitch);
+	if (m_pPool && size >= m_ThreadThreshold) {
+		unsigned int nStripes = m_pPool->GetWorkerCount() + 1;
+		if (nStripes > height) nStripes = height;
+		job.rowsPerStripe = (height + nStripes - 1)/nStripes;
+		return m_pPool->Run(convert_stripe_thread, (void *)&job, nStripes, convert_scratch_size(&job));
+	}
 
-	//-- Get info for id "1"
-	if (nIds >= 1) {
-		// SSE2 | [bit 26] EDX
-		// SSE2 = (cpuid03 & (0x1 << 26))
-		__cpuid(CPUInfo, 1); // EAX = 1 for __cpuid
-		m_bSSE2 = ((CPUInfo[3] & (0x1 << 26)) || false);
-		// SSE3 | [bit 0] ECX
-		// SSE3 = (cpuid02 & (0x1)
-		m_bSSE3 = ((CPUInfo[2] & (0x1)) || false);
-		// SSSE3 | [bit 9] ECX
-		// SSSE3 = (cpuid02 & (0x1 << 9)
-		m_bSSSE3 = ((CPUInfo[2] & (0x1 << 9)) || false);
+	if (!reserve_scratch(m_pScratch, m_ScratchSize, convert_scratch_size(&job))) {
+		printf("spoutCopy::ConvertRows - could not allocate line buffer\n");
+		return false;
 	}
+	convert_stripe(&job, 0, height, m_pScratch);
 
+	return true;
 }
 
 
@@ -249,449 +2593,608 @@ void spoutCopy::CheckSSE()
 //
 void spoutCopy::rgba2bgra(void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
 {
-	if (m_bSSE2 && m_bSSSE3 && ((width % 16) == 0)) // SSE3 available and 16 byte aligned width
-		rgba_bgra_ssse3(rgba_source, bgra_dest, width, height, bInvert);
-	else if (m_bSSE2) // SSE2 available
-		rgba_bgra_sse2(rgba_source, bgra_dest, width, height, bInvert);
-	else
-		rgba_bgra(rgba_source, bgra_dest, width, height, bInvert);
+	ConvertRows(rgba_source, bgra_dest, width, height, 4, 4, 0, 0, m_RowFunc[SPOUT_ROW_SWAP4], bInvert);
+}
+
+
+void spoutCopy::rgba2bgra(void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(rgba_source, bgra_dest, width, height, 4, 4, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_SWAP4], bInvert);
 }
 
 
 // Both are swapping red and blue, so use the same function
 void spoutCopy::bgra2rgba(void *bgra_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
 {
-	rgba2bgra(bgra_source, rgba_dest, width, height, bInvert);
+	rgba2bgra(bgra_source, rgba_dest, width, height, 0, 0, bInvert);
+}
+
+
+void spoutCopy::bgra2rgba(void *bgra_source, void *rgba_dest, unsigned int width, unsigned int height,
+						  unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	rgba2bgra(bgra_source, rgba_dest, width, height, srcPitch, dstPitch, bInvert);
 }
 
 
 // Without SSE
 void spoutCopy::rgba_bgra(void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
 {
-    unsigned __int32 *source = NULL;
-    unsigned __int32 *dest = NULL;
-	unsigned __int32 rgbapix; // 32bit rgba pixel
-	unsigned int x = 0;
-	unsigned int y = 0;
-
-    for (y = 0; y < height; y++) {
+	ConvertRows(rgba_source, bgra_dest, width, height, 4, 4, 0, 0, row_swap4, bInvert);
+}
 
-  		// Start of buffer
-		source = (unsigned __int32*)rgba_source; // unsigned int = 4 bytes
-        dest   = (unsigned __int32*)bgra_dest;
 
-		// Increment to current line
-		if(bInvert) {
-			source += (unsigned __int32)(width*height); // end of rgba buffer
-			source -= (unsigned __int32)width; // beginning of the last rgba line
-			source -= (unsigned __int32)y*width; // current line
-			dest   += (unsigned __int32)y*width; // dest is not inverted
-		}
-		else {
-			source += (unsigned __int32)y*width;
-			dest   += (unsigned __int32)y*width;
-		}
+// SSE2
+void spoutCopy::rgba_bgra_sse2(void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(rgba_source, bgra_dest, width, height, 4, 4, 0, 0, row_swap4_sse2, bInvert);
+}
 
-        for (x = 0; x < width; x++) {
-            rgbapix = source[x];
-            dest[x] = (_rotl(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-        }
 
-	}
-} // end rgba_bgra
+// SSSE3
+void spoutCopy::rgba_bgra_ssse3(void* rgba_source,  void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(rgba_source, rgba_dest, width, height, 4, 4, 0, 0, row_swap4_ssse3, bInvert);
+}
 
 
 //
-// Adapted from : https://searchcode.com/codesearch/view/5070982/
-// 
-// Copyright (c) 2002-2010 The ANGLE Project Authors. All rights reserved.
-// Use of this source code is governed by a BSD-style license that can be
-// found in the LICENSE file.
-//
-// https://chromium.googlesource.com/angle/angle/+/master/LICENSE
+// rgb2rgba, bgr2rgba, rgb2bgra, bgr2bgra
 //
-// All instructions SSE2.
+// 3 bytes to 4 bytes with alpha 255
 //
-void spoutCopy::rgba_bgra_sse2(void *rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
+void spoutCopy::rgb2rgba(void *rgb_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
 {
-    unsigned __int32 *source = NULL;
-    unsigned __int32 *dest = NULL;
-	unsigned __int32 rgbapix; // 32bit rgba pixel
-	unsigned int x = 0;
-	unsigned int y = 0;
-    __m128i brMask = _mm_set1_epi32(0x00ff00ff); // argb
+	ConvertRows(rgb_source, rgba_dest, width, height, 3, 4, 0, 0, m_RowFunc[SPOUT_ROW_3TO4], bInvert);
+}
 
-    for (y = 0; y < height; y++) {
 
-  		// Start of buffer
-		source = (unsigned __int32*)rgba_source; // unsigned int = 4 bytes
-        dest   = (unsigned __int32*)bgra_dest;
+void spoutCopy::rgb2rgba(void *rgb_source, void *rgba_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(rgb_source, rgba_dest, width, height, 3, 4, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_3TO4], bInvert);
+}
 
-		// Increment to current line
-		if(bInvert) {
-			source += (unsigned __int32)(width*height); // end of rgba buffer
-			source -= (unsigned __int32)width;          // beginning of the last rgba line
-			source -= (unsigned __int32)y*width;        // current line
-		}
-		else {
-			source += (unsigned __int32)y*width;
-		}
-		dest   += (unsigned __int32)y*width; // dest is not inverted
 
-        // Make output writes aligned
-        for (x = 0; ((reinterpret_cast<intptr_t>(&dest[x]) & 15) != 0) && x < width; x++) {
-            rgbapix = source[x];
-			// rgbapix << 16		: a r g b > g b a r
-			//        & 0x00ff00ff  : r g b . > . b . r
-			// rgbapix & 0xff00ff00 : a r g b > a . g .
-			// result of or			:           a b g r
-            dest[x] = (_rotl(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-        }
+void spoutCopy::bgr2rgba(void *bgr_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(bgr_source, rgba_dest, width, height, 3, 4, 0, 0, m_RowFunc[SPOUT_ROW_3TO4_SWAP], bInvert);
+}
+
 
-        for (; x + 3 < width; x += 4) {
-            __m128i sourceData = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&source[x]));
-            // Mask out g and a, which don't change
-            __m128i gaComponents = _mm_andnot_si128(brMask, sourceData);
-            // Mask out b and r
-            __m128i brComponents = _mm_and_si128(sourceData, brMask);
-            // Swap b and r
-            __m128i brSwapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(brComponents, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
-            __m128i result = _mm_or_si128(gaComponents, brSwapped);
-            _mm_store_si128(reinterpret_cast<__m128i*>(&dest[x]), result);
-        }
+void spoutCopy::bgr2rgba(void *bgr_source, void *rgba_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(bgr_source, rgba_dest, width, height, 3, 4, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_3TO4_SWAP], bInvert);
+}
 
-        // Perform leftover writes
-        for (; x < width; x++) {
-            rgbapix = source[x];
-            dest[x] = (_rotl(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-        }
-    }
 
-} // end rgba_bgra_sse2
+void spoutCopy::rgb2bgra(void *rgb_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(rgb_source, bgra_dest, width, height, 3, 4, 0, 0, m_RowFunc[SPOUT_ROW_3TO4_SWAP], bInvert);
+}
+
+
+void spoutCopy::rgb2bgra(void *rgb_source, void *bgra_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(rgb_source, bgra_dest, width, height, 3, 4, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_3TO4_SWAP], bInvert);
+}
+
+
+void spoutCopy::bgr2bgra(void *bgr_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(bgr_source, bgra_dest, width, height, 3, 4, 0, 0, m_RowFunc[SPOUT_ROW_3TO4], bInvert);
+}
+
+
+void spoutCopy::bgr2bgra(void *bgr_source, void *bgra_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(bgr_source, bgra_dest, width, height, 3, 4, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_3TO4], bInvert);
+}
 
 
 //
-//	Adapted from a Gist snippet by Aurlien Valle (NewbiZ) http://newbiz.github.io/
-//
-//	https://gist.github.com/NewbiZ/5541524
+// rgba2rgb, rgba2bgr, bgra2rgb, bgra2bgr
 //
-//	Approximately 15% faster than SSE2 function
+// 4 bytes to 3 bytes, alpha is discarded
 //
-void spoutCopy::rgba_bgra_ssse3(void* rgba_source,  void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
+void spoutCopy::rgba2rgb(void *rgba_source, void *rgb_dest, unsigned int width, unsigned int height, bool bInvert)
 {
-	unsigned __int32* source = (unsigned int*)rgba_source;
-	unsigned __int32* dest = (unsigned int*)rgba_dest;
-	unsigned int PIXEL_COUNT = width;
-	// unsigned int x = 0;
-	unsigned int y = 0;
-	__m128i* src = NULL;
-	__m128i* dst = NULL;
+	ConvertRows(rgba_source, rgb_dest, width, height, 4, 3, 0, 0, m_RowFunc[SPOUT_ROW_4TO3], bInvert);
+}
+
 
-	// Shuffling mask (RGBA -> BGRA) x 4, in reverse byte order
-	static const __m128i m = _mm_set_epi8(15,12,13,14,11,8,9,10,7,4,5,6,3,0,1,2);
+void spoutCopy::rgba2rgb(void *rgba_source, void *rgb_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(rgba_source, rgb_dest, width, height, 4, 3, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_4TO3], bInvert);
+}
 
-    for (y = 0; y < height; y++) {
 
-		// Start of buffer
-		source = (unsigned __int32*)rgba_source; // unsigned int = 4 bytes
-        dest   = (unsigned __int32*)rgba_dest;
+void spoutCopy::rgba2bgr(void *rgba_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(rgba_source, bgr_dest, width, height, 4, 3, 0, 0, m_RowFunc[SPOUT_ROW_4TO3_SWAP], bInvert);
+}
 
-		// Increment to current line
-		if(bInvert) {
-			source += (unsigned __int32)(width*height); // end of rgba buffer
-			source -= (unsigned __int32)width;          // beginning of the last rgba line
-			source -= (unsigned __int32)y*width;        // current line
-		}
-		else {
-			source += (unsigned __int32)y*width;
-		}
-		dest   += (unsigned __int32)y*width; // dest is not inverted
 
-		// Assert pixels will NOT be aliased here : TODO
-		// __m128i* __restrict__ pix = (__m128i*)pixels;
-		src = (__m128i*)source;
-		dst = (__m128i*)dest;
+void spoutCopy::rgba2bgr(void *rgba_source, void *bgr_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(rgba_source, bgr_dest, width, height, 4, 3, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_4TO3_SWAP], bInvert);
+}
 
-		// Tile the LHS to match 64B cache line size
-		for (; (unsigned int*)src < source+PIXEL_COUNT; src+=4, dst+=4)  {
 
-			__m128i p1 = _mm_load_si128(src); // SSE2
-			__m128i p2 = _mm_load_si128(src+1);
-			__m128i p3 = _mm_load_si128(src+2);
-			__m128i p4 = _mm_load_si128(src+3);
+void spoutCopy::bgra2rgb(void *bgra_source, void *rgb_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(bgra_source, rgb_dest, width, height, 4, 3, 0, 0, m_RowFunc[SPOUT_ROW_4TO3_SWAP], bInvert);
+}
 
-			p1 = _mm_shuffle_epi8(p1, m); // SSSE3
-			p2 = _mm_shuffle_epi8(p2, m);
-			p3 = _mm_shuffle_epi8(p3, m);
-			p4 = _mm_shuffle_epi8(p4, m);
 
-			_mm_store_si128(dst,   p1); // SSE2
-			_mm_store_si128(dst+1, p2);
-			_mm_store_si128(dst+2, p3);
-			_mm_store_si128(dst+3, p4);
+void spoutCopy::bgra2rgb(void *bgra_source, void *rgb_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(bgra_source, rgb_dest, width, height, 4, 3, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_4TO3_SWAP], bInvert);
+}
+
+
+void spoutCopy::bgra2bgr(void *bgra_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ConvertRows(bgra_source, bgr_dest, width, height, 4, 3, 0, 0, m_RowFunc[SPOUT_ROW_4TO3], bInvert);
+}
 
-		}
-	}
-} // end rgba_bgra_ssse3
 
+void spoutCopy::bgra2bgr(void *bgra_source, void *bgr_dest, unsigned int width, unsigned int height,
+							unsigned int srcPitch, unsigned int dstPitch, bool bInvert)
+{
+	ConvertRows(bgra_source, bgr_dest, width, height, 4, 3, srcPitch, dstPitch, m_RowFunc[SPOUT_ROW_4TO3], bInvert);
+}
 
 
 //
-// rgb2rgba, bgr2rgba, rgba2rgb, rgba2bgr, rgb2bgra
+// Resample
 //
-
-void spoutCopy::rgb2rgba(void *rgb_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
+// Convert between rgba, bgra, rgb and bgr, resize and optionally flip in one pass.
+// Line pitch in bytes, or 0 for the width times bytes per pixel.
+//
+// SPOUT_RESAMPLE_NEAREST  - nearest pixel, same size is an exact copy
+// SPOUT_RESAMPLE_BILINEAR - linear interpolation between the nearest four pixels
+// SPOUT_RESAMPLE_BOX      - average of all source pixels covered, for reducing size
+//
+bool spoutCopy::Resample(const void *source, void *dest,
+						 unsigned int srcWidth, unsigned int srcHeight, unsigned int srcPitch, GLenum srcFormat,
+						 unsigned int dstWidth, unsigned int dstHeight, unsigned int dstPitch, GLenum dstFormat,
+						 int mode, bool bInvert)
 {
-	unsigned long rgbsize = width*height*3;
-	unsigned long rgbpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
+	unsigned int srcBytes = 0;
+	unsigned int dstBytes = 0;
+	bool bSrcBGR = false;
+	bool bDstBGR = false;
+
+	if (!source || !dest || srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0)
+		return false;
 
-	// Start of buffers
-	unsigned char *rgb  = (unsigned char *)rgb_source; // RGB
-	unsigned char *rgba = (unsigned char *)rgba_dest; // RGBA
-	if(bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+	if (!format_info(srcFormat, srcBytes, bSrcBGR) || !format_info(dstFormat, dstBytes, bDstBGR)) {
+		printf("spoutCopy::Resample - unsupported format\n");
+		return false;
 	}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// rgb source - rgba dest
-			*(rgba + 0) = *(rgb + 0); // red
-			*(rgba + 1) = *(rgb + 1); // grn
-			*(rgba + 2) = *(rgb + 2); // blu
-			*(rgba + 3) =  (unsigned char)255; // alpha
-			rgb += 3;
-			rgba += 4;
-        }
-		if(bInvert)
-			rgb -= rgbpitch*2; // move up a line for invert
+	if (mode < SPOUT_RESAMPLE_NEAREST || mode > SPOUT_RESAMPLE_BOX)
+		mode = SPOUT_RESAMPLE_NEAREST;
+
+	// Horizontal positions are the same for every line
+	// and are kept until the sizes or mode change
+	if (!m_pResampleX || m_ResampleSrcWidth != srcWidth || m_ResampleDstWidth != dstWidth || m_ResampleMode != mode) {
+		if (m_pResampleX) free((void *)m_pResampleX);
+		if (m_pResampleF) free((void *)m_pResampleF);
+		m_pResampleX = (unsigned int *)malloc(dstWidth*sizeof(unsigned int));
+		m_pResampleF = (unsigned short *)malloc(dstWidth*sizeof(unsigned short));
+		if (!m_pResampleX || !m_pResampleF) {
+			if (m_pResampleX) free((void *)m_pResampleX);
+			if (m_pResampleF) free((void *)m_pResampleF);
+			m_pResampleX = NULL;
+			m_pResampleF = NULL;
+			return false;
+		}
+		for (uint64_t x = 0; x < dstWidth; x++) {
+			if (mode == SPOUT_RESAMPLE_BILINEAR) {
+				int64_t pos = (int64_t)(((2*x + 1)*srcWidth) << 15)/dstWidth - 32768;
+				if (pos < 0) pos = 0;
+				unsigned int sx = (unsigned int)(pos >> 16);
+				unsigned int f = (unsigned int)(((pos & 0xFFFF) + 128) >> 8);
+				if (sx >= srcWidth - 1) {
+					sx = srcWidth - 1;
+					f = 0;
+				}
+				m_pResampleX[x] = sx;
+				m_pResampleF[x] = (unsigned short)f;
+			}
+			else if (mode == SPOUT_RESAMPLE_BOX) {
+				unsigned int sx0 = (unsigned int)((x*srcWidth)/dstWidth);
+				unsigned int sx1 = (unsigned int)(((x + 1)*srcWidth)/dstWidth);
+				if (sx1 <= sx0) sx1 = sx0 + 1;
+				if (sx1 - sx0 > 65535) sx1 = sx0 + 65535;
+				m_pResampleX[x] = sx0;
+				m_pResampleF[x] = (unsigned short)(sx1 - sx0);
+			}
+			else {
+				m_pResampleX[x] = (unsigned int)(((2*x + 1)*srcWidth)/(2*(uint64_t)dstWidth));
+				m_pResampleF[x] = 0;
+			}
+		}
+		m_ResampleSrcWidth = srcWidth;
+		m_ResampleDstWidth = dstWidth;
+		m_ResampleMode = mode;
 	}
 
-} // end rgb2rgba
+	spoutResampleJob job;
+	job.src = (const unsigned char *)source;
+	job.dst = (unsigned char *)dest;
+	job.srcWidth = srcWidth;
+	job.srcHeight = srcHeight;
+	job.dstWidth = dstWidth;
+	job.dstHeight = dstHeight;
+	job.srcPitch = srcPitch > 0 ? srcPitch : (size_t)srcWidth*srcBytes;
+	job.dstPitch = dstPitch > 0 ? dstPitch : (size_t)dstWidth*dstBytes;
+	job.mode = mode;
+	job.bInvert = bInvert;
+	job.bSIMD = (m_ISA > SPOUT_ISA_SCALAR);
+	job.xofs = m_pResampleX;
+	job.xfrac = m_pResampleF;
+	job.rowsPerStripe = dstHeight;
+
+	// The source order is kept when expanding to 4 bytes,
+	// red and blue are swapped if necessary for the destination
+	job.expand = (srcBytes == 3) ? m_RowFunc[SPOUT_ROW_3TO4] : NULL;
+	job.alpha = (srcBytes == 4 && dstBytes == 4) ? GetAlphaFunction() : NULL;
+	if (dstBytes == 4)
+		job.pack = (bSrcBGR != bDstBGR) ? m_RowFunc[SPOUT_ROW_SWAP4] : NULL;
+	else
+		job.pack = (bSrcBGR != bDstBGR) ? m_RowFunc[SPOUT_ROW_4TO3_SWAP] : m_RowFunc[SPOUT_ROW_4TO3];
+
+	size_t size = (size_t)dstHeight*job.dstPitch;
+	if (m_pPool && size >= m_ThreadThreshold) {
+		unsigned int nStripes = m_pPool->GetWorkerCount() + 1;
+		if (nStripes > dstHeight) nStripes = dstHeight;
+		job.rowsPerStripe = (dstHeight + nStripes - 1)/nStripes;
+		return m_pPool->Run(resample_stripe_thread, (void *)&job, nStripes, resample_scratch_size(&job));
+	}
 
+	if (!reserve_scratch(m_pScratch, m_ScratchSize, resample_scratch_size(&job))) {
+		printf("spoutCopy::Resample - could not allocate line buffer\n");
+		return false;
+	}
+	resample_stripe(&job, 0, dstHeight, m_pScratch);
 
+	return true;
+}
 
-void spoutCopy::bgr2rgba(void *bgr_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert)
-{
-	unsigned long rgbsize = width*height*3;
-	unsigned long rgbpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
 
-	// Start of buffers
-	unsigned char *rgb  = (unsigned char *)bgr_source; // RGB
-	unsigned char *rgba = (unsigned char *)rgba_dest; // RGBA
-	if(bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
-	}
+//
+// YUV formats
+//
+// SPOUT_YUV_NV12 - Y plane, then interleaved U and V at half width and height
+// SPOUT_YUV_I420 - Y plane, then U and V planes at half width and height
+// SPOUT_YUV_YUY2 - Y0 U Y1 V for each pair of pixels
+// SPOUT_YUV_UYVY - U Y0 V Y1 for each pair of pixels
+//
+// The yuv buffer is tightly packed. The width must be even,
+// and the height must also be even for NV12 and I420.
+//
+void spoutCopy::SetYUVmatrix(int matrix, bool bFullRange)
+{
+	m_YUVmatrix = (matrix == SPOUT_YUV_BT709) ? SPOUT_YUV_BT709 : SPOUT_YUV_BT601;
+	m_bYUVfullRange = bFullRange;
+}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// bgr source - rgba dest
-			*(rgba + 0) = *(rgb + 2); // blu 
-			*(rgba + 1) = *(rgb + 1); // grn
-			*(rgba + 2) = *(rgb + 0); // red
-			*(rgba + 3) =  (unsigned char)255; // alpha
-			rgb += 3;
-			rgba += 4;
-        }
-		if(bInvert)
-			rgb -= rgbpitch*2; // move up a line for invert
-	}
 
-} // end bgr2rgba
+bool spoutCopy::IsYUVformat(unsigned int format)
+{
+	return (format == SPOUT_YUV_NV12 || format == SPOUT_YUV_I420
+		 || format == SPOUT_YUV_YUY2 || format == SPOUT_YUV_UYVY);
+}
 
 
-void spoutCopy::rgb2bgra(void *rgb_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
+unsigned int spoutCopy::GetYUVsize(unsigned int format, unsigned int width, unsigned int height)
 {
-	unsigned long rgbsize = width*height*3;
-	unsigned long rgbpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
-
-	// Start of buffers
-	unsigned char *rgb  = (unsigned char *)rgb_source; // RGB
-	unsigned char *bgra = (unsigned char *)bgra_dest; // BGRA
-	if(bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+	switch (format) {
+		case SPOUT_YUV_NV12:
+		case SPOUT_YUV_I420:
+			return width*height + (width/2)*(height/2)*2;
+		case SPOUT_YUV_YUY2:
+		case SPOUT_YUV_UYVY:
+			return width*height*2;
+		default:
+			return 0;
 	}
+}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// rgb source - bgra dest
-			*(bgra + 0) = *(rgb + 2); // red
-			*(bgra + 1) = *(rgb + 1); // grn
-			*(bgra + 2) = *(rgb + 0); // blu
-			*(bgra + 3) =  (unsigned char)255; // alpha
-			rgb += 3;
-			bgra += 4;
-        }
-		if(bInvert)
-			rgb -= rgbpitch*2; // move up a line for invert
-	}
 
-} // end rgb2bgra
+//
+// Rgba, bgra, rgb or bgr to yuv.
+// Source line pitch in bytes, or 0 for the width times bytes per pixel.
+//
+bool spoutCopy::rgba2yuv(const void *source, void *yuv_dest,
+						 unsigned int width, unsigned int height,
+						 unsigned int srcPitch, GLenum srcFormat,
+						 unsigned int yuvFormat, bool bInvert)
+{
+	spoutYUVJob job;
+	unsigned int nBytes = 0;
+	bool bBGR = false;
+
+	if (!source || !yuv_dest || width == 0 || height == 0)
+		return false;
 
+	if (!format_info(srcFormat, nBytes, bBGR) || !IsYUVformat(yuvFormat)) {
+		printf("spoutCopy::rgba2yuv - unsupported format\n");
+		return false;
+	}
 
-void spoutCopy::bgr2bgra(void *bgr_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert)
-{
-	unsigned long bgrsize = width*height*3;
-	unsigned long bgrpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
+	bool b420 = (yuvFormat == SPOUT_YUV_NV12 || yuvFormat == SPOUT_YUV_I420);
+	if ((width & 1) || (b420 && (height & 1))) {
+		printf("spoutCopy::rgba2yuv - odd size %dx%d\n", width, height);
+		return false;
+	}
 
-	// Start of buffers
-	unsigned char *bgr  = (unsigned char *)bgr_source; // BGR
-	unsigned char *bgra = (unsigned char *)bgra_dest;  // BGRA
-	if(bInvert) {
-		bgr += bgrsize; // end of rgb buffer
-		bgr -= bgrpitch; // beginning of the last rgb line
+	job.src = (const unsigned char *)source;
+	job.dst = (unsigned char *)yuv_dest;
+	job.width = width;
+	job.height = height;
+	job.pitch = srcPitch > 0 ? srcPitch : (size_t)width*nBytes;
+	job.convert = (nBytes == 3) ? m_RowFunc[SPOUT_ROW_3TO4] : NULL;
+	job.rgbaBytes = nBytes;
+	job.format = yuvFormat;
+	job.bInvert = bInvert;
+	job.bSIMD = (m_ISA > SPOUT_ISA_SCALAR);
+	job.rowsPerStripe = height;
+	yuv_coefficients(&job.coef, m_YUVmatrix, m_bYUVfullRange);
+
+	// Blue is first for bgra and bgr
+	if (bBGR) {
+		short k = 0;
+		k = job.coef.y[0]; job.coef.y[0] = job.coef.y[2]; job.coef.y[2] = k;
+		k = job.coef.u[0]; job.coef.u[0] = job.coef.u[2]; job.coef.u[2] = k;
+		k = job.coef.v[0]; job.coef.v[0] = job.coef.v[2]; job.coef.v[2] = k;
 	}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// bgr source - bgra dest
-			*(bgra + 0) = *(bgr + 0); // blu
-			*(bgra + 1) = *(bgr + 1); // grn
-			*(bgra + 2) = *(bgr + 2); // red
-			*(bgra + 3) =  (unsigned char)255; // alpha
-			bgr += 3;
-			bgra += 4;
-        }
-		if(bInvert)
-			bgr -= bgrpitch*2; // move up a line for invert
+	size_t size = (size_t)height*width*nBytes;
+	if (m_pPool && size >= m_ThreadThreshold) {
+		unsigned int nStripes = m_pPool->GetWorkerCount() + 1;
+		if (nStripes > height) nStripes = height;
+		job.rowsPerStripe = (height + nStripes - 1)/nStripes;
+		if (b420) job.rowsPerStripe = (job.rowsPerStripe + 1) & ~1U; // line pairs
+		nStripes = (height + job.rowsPerStripe - 1)/job.rowsPerStripe;
+		return m_pPool->Run(yuv_encode_thread, (void *)&job, nStripes, yuv_encode_scratch_size(&job));
 	}
 
-} // end bgr2bgra
+	if (!reserve_scratch(m_pScratch, m_ScratchSize, yuv_encode_scratch_size(&job))) {
+		printf("spoutCopy::rgba2yuv - could not allocate line buffer\n");
+		return false;
+	}
+	yuv_encode_stripe(&job, 0, height, m_pScratch);
 
+	return true;
+}
 
 
-void spoutCopy::rgba2rgb(void *rgba_source, void *rgb_dest, unsigned int width, unsigned int height, bool bInvert)
+//
+// Yuv to rgba, bgra, rgb or bgr.
+// Destination line pitch in bytes, or 0 for the width times bytes per pixel.
+//
+bool spoutCopy::yuv2rgba(const void *yuv_source, void *dest,
+						 unsigned int width, unsigned int height,
+						 unsigned int yuvFormat,
+						 unsigned int dstPitch, GLenum dstFormat, bool bInvert)
 {
-	unsigned long rgbsize = width*height*3;
-	unsigned long rgbpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
+	spoutYUVJob job;
+	unsigned int nBytes = 0;
+	bool bBGR = false;
+
+	if (!yuv_source || !dest || width == 0 || height == 0)
+		return false;
 
-	// Start of buffers
-	unsigned char *rgba = (unsigned char *)rgba_source; // RGBA
-	unsigned char *rgb  = (unsigned char *)rgb_dest; // RGB
-	if(bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+	if (!format_info(dstFormat, nBytes, bBGR) || !IsYUVformat(yuvFormat)) {
+		printf("spoutCopy::yuv2rgba - unsupported format\n");
+		return false;
 	}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// rgba source - rgb dest
-			*(rgb + 0) = *(rgba + 0); // red
-			*(rgb + 1) = *(rgba + 1); // grn
-			*(rgb + 2) = *(rgba + 2); // blu
-			rgb += 3;
-			rgba += 4;
-        }
-		if(bInvert)
-			rgb -= rgbpitch*2; // move up a line for invert
+	bool b420 = (yuvFormat == SPOUT_YUV_NV12 || yuvFormat == SPOUT_YUV_I420);
+	if ((width & 1) || (b420 && (height & 1))) {
+		printf("spoutCopy::yuv2rgba - odd size %dx%d\n", width, height);
+		return false;
 	}
 
-} // end rgba2rgb
+	job.src = (const unsigned char *)yuv_source;
+	job.dst = (unsigned char *)dest;
+	job.width = width;
+	job.height = height;
+	job.pitch = dstPitch > 0 ? dstPitch : (size_t)width*nBytes;
+	if (nBytes == 4)
+		job.convert = bBGR ? m_RowFunc[SPOUT_ROW_SWAP4] : NULL;
+	else
+		job.convert = bBGR ? m_RowFunc[SPOUT_ROW_4TO3_SWAP] : m_RowFunc[SPOUT_ROW_4TO3];
+	job.rgbaBytes = nBytes;
+	job.format = yuvFormat;
+	job.bInvert = bInvert;
+	job.bSIMD = (m_ISA > SPOUT_ISA_SCALAR);
+	job.rowsPerStripe = height;
+	yuv_coefficients(&job.coef, m_YUVmatrix, m_bYUVfullRange);
+
+	size_t size = (size_t)height*width*nBytes;
+	if (m_pPool && size >= m_ThreadThreshold) {
+		unsigned int nStripes = m_pPool->GetWorkerCount() + 1;
+		if (nStripes > height) nStripes = height;
+		job.rowsPerStripe = (height + nStripes - 1)/nStripes;
+		return m_pPool->Run(yuv_decode_thread, (void *)&job, nStripes, yuv_decode_scratch_size(&job));
+	}
 
+	if (!reserve_scratch(m_pScratch, m_ScratchSize, yuv_decode_scratch_size(&job))) {
+		printf("spoutCopy::yuv2rgba - could not allocate line buffer\n");
+		return false;
+	}
+	yuv_decode_stripe(&job, 0, height, m_pScratch);
 
-void spoutCopy::rgba2bgr(void *rgba_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert)
-{
-	unsigned long rgbsize = width*height*3;
-	unsigned long rgbpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
+	return true;
+}
 
-	// Start of buffers
-	unsigned char *rgba = (unsigned char *)rgba_source; // RGBA
-	unsigned char *rgb  = (unsigned char *)bgr_dest; // RGB
-	if(bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
-	}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// rgba source - bgr dest
-			*(rgb + 0) = *(rgba + 2); // blu
-			*(rgb + 1) = *(rgba + 1); // grn
-			*(rgb + 2) = *(rgba + 0); // red
-			rgb += 3;
-			rgba += 4;
-        }
-		if(bInvert)
-			rgb -= rgbpitch*2; // move up a line for invert
-	}
+//
+// High bit depth formats
+//
+// GL_RGBA16   - 16 bit unsigned normalized, 8 bytes per pixel
+// GL_RGBA16F  - 16 bit half float, 8 bytes per pixel
+// GL_RGB10_A2 - 10 bit red, green and blue and 2 bit alpha packed in 4 bytes
+//
+bool spoutCopy::IsHighBitDepth(GLenum glFormat)
+{
+	return (glFormat == GL_RGBA16 || glFormat == GL_RGBA16F || glFormat == GL_RGB10_A2);
+}
 
-} // end rgba2bgr
 
+unsigned int spoutCopy::GetBytesPerPixel(GLenum glFormat)
+{
+	unsigned int nBytes = 0;
+	bool bBGR = false;
+
+	if (format_info(glFormat, nBytes, bBGR))
+		return nBytes;
+	if (glFormat == GL_RGBA16 || glFormat == GL_RGBA16F)
+		return 8;
+	if (glFormat == GL_RGB10_A2)
+		return 4;
+	return 0;
+}
 
 
-void spoutCopy::bgra2rgb(void *bgra_source, void *rgb_dest, unsigned int width, unsigned int height, bool bInvert)
+//
+// Convert between any of rgba, bgra, rgb, bgr, GL_RGBA16, GL_RGBA16F and GL_RGB10_A2.
+// 8 bit formats are converted through rgba and high bit depth formats through GL_RGBA16.
+// Half float values outside 0-1 are clamped.
+// Line pitch in bytes, or 0 for the width times bytes per pixel.
+//
+bool spoutCopy::ConvertPixels(const void *source, void *dest,
+							  unsigned int width, unsigned int height,
+							  unsigned int srcPitch, GLenum srcFormat,
+							  unsigned int dstPitch, GLenum dstFormat, bool bInvert)
 {
-	unsigned long rgbsize = width*height*3;
-	unsigned long rgbpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
+	unsigned int srcBytes = GetBytesPerPixel(srcFormat);
+	unsigned int dstBytes = GetBytesPerPixel(dstFormat);
+	unsigned int midBytes = 4;
+	spoutRowFunc first = NULL;
+	spoutRowFunc second = NULL;
+	bool bSrcBGR = (srcFormat == GL_BGRA_EXT || srcFormat == GL_BGR_EXT);
+	bool bDstBGR = (dstFormat == GL_BGRA_EXT || dstFormat == GL_BGR_EXT);
+
+	if (!source || !dest || srcBytes == 0 || dstBytes == 0) {
+		if (srcBytes == 0 || dstBytes == 0)
+			printf("spoutCopy::ConvertPixels - unsupported format\n");
+		return false;
+	}
+
+	bool bSrcHigh = IsHighBitDepth(srcFormat);
+	bool bDstHigh = IsHighBitDepth(dstFormat);
+
+	// 8 bit source to rgba
+	if (!bSrcHigh) {
+		if (srcBytes == 3)
+			first = bSrcBGR ? m_RowFunc[SPOUT_ROW_3TO4_SWAP] : m_RowFunc[SPOUT_ROW_3TO4];
+		else if (bSrcBGR)
+			first = m_RowFunc[SPOUT_ROW_SWAP4];
+	}
 
-	// Start of buffers
-	unsigned char *bgra = (unsigned char *)bgra_source; // BGRA
-	unsigned char *rgb  = (unsigned char *)rgb_dest; // RGB
-	if(bInvert) {
-		rgb += rgbsize; // end of rgb buffer
-		rgb -= rgbpitch; // beginning of the last rgb line
+	// rgba to 8 bit destination
+	if (!bDstHigh) {
+		if (dstBytes == 3)
+			second = bDstBGR ? m_RowFunc[SPOUT_ROW_4TO3_SWAP] : m_RowFunc[SPOUT_ROW_4TO3];
+		else if (bDstBGR)
+			second = m_RowFunc[SPOUT_ROW_SWAP4];
 	}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// bgra source - rgb dest
-			*(rgb + 0) = *(bgra + 2); // red
-			*(rgb + 1) = *(bgra + 1); // grn
-			*(rgb + 2) = *(bgra + 0); // blu
-			rgb += 3;
-			bgra += 4;
-        }
-		if(bInvert)
-			rgb -= rgbpitch*2; // move up a line for invert
+	if (!bSrcHigh && !bDstHigh) {
+		// Both 8 bit - a single function for the same pixel size
+		if (srcFormat == dstFormat) {
+			first = NULL;
+			second = NULL;
+		}
+		else if (srcBytes == 4 && dstBytes == 4) {
+			first = m_RowFunc[SPOUT_ROW_SWAP4];
+			second = NULL;
+		}
+		else if (srcBytes == 4) {
+			first = (bSrcBGR != bDstBGR) ? m_RowFunc[SPOUT_ROW_4TO3_SWAP] : m_RowFunc[SPOUT_ROW_4TO3];
+			second = NULL;
+		}
+		else if (dstBytes == 4) {
+			first = (bSrcBGR != bDstBGR) ? m_RowFunc[SPOUT_ROW_3TO4_SWAP] : m_RowFunc[SPOUT_ROW_3TO4];
+			second = NULL;
+		}
+		// rgb <> bgr is 3TO4 then 4TO3_SWAP
+	}
+	else if (!bSrcHigh) {
+		// 8 bit to high bit depth
+		if (dstFormat == GL_RGBA16)       second = m_RowFunc[SPOUT_ROW_8TO16];
+		else if (dstFormat == GL_RGBA16F) second = m_RowFunc[SPOUT_ROW_8TO16F];
+		else                              second = m_RowFunc[SPOUT_ROW_8TO10];
+	}
+	else if (!bDstHigh) {
+		// High bit depth to 8 bit
+		if (srcFormat == GL_RGBA16)       first = m_RowFunc[SPOUT_ROW_16TO8];
+		else if (srcFormat == GL_RGBA16F) first = m_RowFunc[SPOUT_ROW_16FTO8];
+		else                              first = m_RowFunc[SPOUT_ROW_10TO8];
+	}
+	else if (srcFormat != dstFormat) {
+		// Between high bit depth formats through GL_RGBA16
+		midBytes = 8;
+		if (srcFormat == GL_RGBA16F)       first = m_RowFunc[SPOUT_ROW_16FTO16];
+		else if (srcFormat == GL_RGB10_A2) first = m_RowFunc[SPOUT_ROW_10TO16];
+		if (dstFormat == GL_RGBA16F)       second = m_RowFunc[SPOUT_ROW_16TO16F];
+		else if (dstFormat == GL_RGB10_A2) second = m_RowFunc[SPOUT_ROW_16TO10];
 	}
 
-} // end bgra2rgb
+	if (!first) {
+		first = second;
+		second = NULL;
+	}
 
+	return ConvertRows(source, dest, width, height, srcBytes, dstBytes, srcPitch, dstPitch, first, bInvert, second, midBytes, !bDstHigh);
+}
 
 
-void spoutCopy::bgra2bgr(void *bgra_source, void *bgr_dest, unsigned int width, unsigned int height, bool bInvert)
+//
+// Alpha mode for conversion to rgba or bgra (SpoutAlphaMode)
+//
+// SPOUT_ALPHA_KEEP          - alpha and colour unchanged (default)
+// SPOUT_ALPHA_OPAQUE        - alpha 255, e.g. for an X8R8G8B8 source
+// SPOUT_ALPHA_PREMULTIPLY   - straight alpha to premultiplied
+// SPOUT_ALPHA_UNPREMULTIPLY - premultiplied alpha to straight
+//
+// Applied by the copy, rgba/bgra conversion, ConvertPixels and Resample functions
+// in the same pass, if the source has alpha and the destination is rgba or bgra.
+//
+void spoutCopy::SetAlphaMode(int mode)
 {
-	unsigned long bgrsize = width*height*3;
-	unsigned long bgrpitch = width*3;
-	unsigned int x = 0;
-	unsigned int y = 0;
+	if (mode < SPOUT_ALPHA_KEEP || mode > SPOUT_ALPHA_UNPREMULTIPLY)
+		mode = SPOUT_ALPHA_KEEP;
+	m_AlphaMode = mode;
+}
 
-	// Start of buffers
-	unsigned char *bgra = (unsigned char *)bgra_source; // BGRA
-	unsigned char *bgr  = (unsigned char *)bgr_dest; // BGR
-	if(bInvert) {
-		bgr += bgrsize; // end of bgr buffer
-		bgr -= bgrpitch; // beginning of the last bgr line
-	}
 
-	for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-			// bgra source - bgr dest
-			*(bgr + 2) = *(bgra + 2); // red
-			*(bgr + 1) = *(bgra + 1); // grn
-			*(bgr + 0) = *(bgra + 0); // blu
-			bgr += 3;
-			bgra += 4;
-        }
-		if(bInvert)
-			bgr -= bgrpitch*2; // move up a line for invert
-	}
+int spoutCopy::GetAlphaMode()
+{
+	return m_AlphaMode;
+}
 
-} // end bgra2bgr
 
+// Line function for the alpha mode, NULL to keep
+spoutRowFunc spoutCopy::GetAlphaFunction()
+{
+	switch (m_AlphaMode) {
+		case SPOUT_ALPHA_OPAQUE:        return m_RowFunc[SPOUT_ROW_OPAQUE];
+		case SPOUT_ALPHA_PREMULTIPLY:   return m_RowFunc[SPOUT_ROW_PREMULTIPLY];
+		case SPOUT_ALPHA_UNPREMULTIPLY: return m_RowFunc[SPOUT_ROW_UNPREMULTIPLY];
+		default: return NULL;
+	}
+}
@@ -34,13 +34,112 @@
 #define __spoutCopy__
 
 #include "SpoutCommon.h"
+#if defined(_WIN32)
 #include <windows.h>
-#include <stdio.h> // for debug printf
 #include <gl/gl.h> // For OpenGL definitions
 #include <intrin.h> // for cpuid to test for SSE2
+#endif
+#include <stdio.h> // for debug printf
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <emmintrin.h> // for SSE2
 #include <tmmintrin.h> // for SSSE3
+#include <immintrin.h> // for AVX2 and AVX-512
+
+// AVX-512 intrinsics are not available before Visual Studio 2017
+#if !defined(_MSC_VER) || (_MSC_VER >= 1910)
+#define SPOUT_AVX512
+#endif
+
+// OpenGL formats used without an OpenGL header
+#ifndef GL_RGBA
+typedef unsigned int GLenum;
+#define GL_RGB 0x1907
+#define GL_RGBA 0x1908
+#endif
+#ifndef GL_BGR_EXT
+#define GL_BGR_EXT 0x80E0
+#endif
+#ifndef GL_BGRA_EXT
+#define GL_BGRA_EXT 0x80E1
+#endif
 
+// High bit depth formats for ConvertPixels
+#ifndef GL_RGB10_A2
+#define GL_RGB10_A2 0x8059
+#endif
+#ifndef GL_RGBA16
+#define GL_RGBA16 0x805B
+#endif
+#ifndef GL_RGBA16F
+#define GL_RGBA16F 0x881A
+#endif
+
+// Instruction set used for pixel conversion
+enum SpoutCopyISA {
+	SPOUT_ISA_SCALAR = 0,
+	SPOUT_ISA_SSE2,
+	SPOUT_ISA_SSSE3,
+	SPOUT_ISA_AVX2,
+	SPOUT_ISA_AVX512
+};
+
+// Conversion of a single line of pixels.
+// Each serves two format pairs with the same byte order
+enum SpoutCopyRow {
+	SPOUT_ROW_SWAP4 = 0,  // rgba <> bgra
+	SPOUT_ROW_3TO4,       // rgb > rgba, bgr > bgra
+	SPOUT_ROW_3TO4_SWAP,  // bgr > rgba, rgb > bgra
+	SPOUT_ROW_4TO3,       // rgba > rgb, bgra > bgr
+	SPOUT_ROW_4TO3_SWAP,  // rgba > bgr, bgra > rgb
+	SPOUT_ROW_8TO16,      // rgba > GL_RGBA16
+	SPOUT_ROW_16TO8,      // GL_RGBA16 > rgba
+	SPOUT_ROW_8TO16F,     // rgba > GL_RGBA16F
+	SPOUT_ROW_16FTO8,     // GL_RGBA16F > rgba
+	SPOUT_ROW_8TO10,      // rgba > GL_RGB10_A2
+	SPOUT_ROW_10TO8,      // GL_RGB10_A2 > rgba
+	SPOUT_ROW_16TO16F,    // GL_RGBA16 > GL_RGBA16F
+	SPOUT_ROW_16FTO16,    // GL_RGBA16F > GL_RGBA16
+	SPOUT_ROW_16TO10,     // GL_RGBA16 > GL_RGB10_A2
+	SPOUT_ROW_10TO16,     // GL_RGB10_A2 > GL_RGBA16
+	SPOUT_ROW_OPAQUE,        // rgba or bgra alpha 255
+	SPOUT_ROW_PREMULTIPLY,   // rgba or bgra colour times alpha
+	SPOUT_ROW_UNPREMULTIPLY, // rgba or bgra colour divided by alpha
+	SPOUT_ROW_COUNT
+};
+
+typedef void (*spoutRowFunc)(const unsigned char *src, unsigned char *dst, unsigned int width);
+
+// Resample modes
+enum SpoutResampleMode {
+	SPOUT_RESAMPLE_NEAREST = 0,
+	SPOUT_RESAMPLE_BILINEAR,
+	SPOUT_RESAMPLE_BOX
+};
+
+// Alpha handling for conversion to rgba or bgra
+enum SpoutAlphaMode {
+	SPOUT_ALPHA_KEEP = 0,
+	SPOUT_ALPHA_OPAQUE,
+	SPOUT_ALPHA_PREMULTIPLY,
+	SPOUT_ALPHA_UNPREMULTIPLY
+};
+
+// YUV formats (FOURCC)
+#define SPOUT_YUV_NV12 0x3231564E
+#define SPOUT_YUV_I420 0x30323449
+#define SPOUT_YUV_YUY2 0x32595559
+#define SPOUT_YUV_UYVY 0x59565955
+
+// YUV conversion matrix
+enum SpoutYUVMatrix {
+	SPOUT_YUV_BT601 = 0,
+	SPOUT_YUV_BT709
+};
+
+// Worker threads for large images (SpoutCopy.cpp)
+class spoutCopyPool;
 
 class SPOUT_DLLEXP spoutCopy {
 
@@ -57,6 +156,18 @@ class SPOUT_DLLEXP spoutCopy {
 						unsigned int width, unsigned int height,
 						GLenum glFormat = GL_RGBA);
 
+		// Source and destination line pitch in bytes for padded lines.
+		// A pitch of 0 is width*4, or width*3 for rgb and bgr.
+		void CopyPixels(const unsigned char *src, unsigned char *dst,
+						unsigned int width, unsigned int height,
+						unsigned int srcPitch, unsigned int dstPitch,
+						GLenum glFormat, bool bInvert = false);
+
+		bool FlipBuffer(const unsigned char *src, unsigned char *dst,
+						unsigned int width, unsigned int height,
+						unsigned int srcPitch, unsigned int dstPitch,
+						GLenum glFormat = GL_RGBA);
+
 		void memcpy_sse2(void* dst, void* src, size_t size);
 
 		void rgba2bgra(void* rgba_source, void *bgra_dest, unsigned int width, unsigned int height, bool bInvert = false);
@@ -66,7 +177,7 @@ class SPOUT_DLLEXP spoutCopy {
 		void rgba_bgra_sse2(void *rgba_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert = false);
 		void rgba_bgra_ssse3(void *rgba_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert = false);
 		
-		// TODO avoid redundancy
+		// All conversions use the line functions selected for the cpu
 		void rgb2rgba (void* rgb_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert = false);
 		void bgr2rgba (void* bgr_source, void *rgba_dest, unsigned int width, unsigned int height, bool bInvert = false);
 
@@ -79,12 +190,111 @@ class SPOUT_DLLEXP spoutCopy {
 		void bgra2rgb (void* bgra_source, void *rgb_dest,  unsigned int width, unsigned int height, bool bInvert = false);
 		void bgra2bgr (void* bgra_source, void *bgr_dest,  unsigned int width, unsigned int height, bool bInvert = false);
 
+		// With source and destination line pitch in bytes (0 for width*bytes per pixel)
+		void rgba2bgra(void* rgba_source, void *bgra_dest, unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void bgra2rgba(void* bgra_source, void *rgba_dest, unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void rgb2rgba (void* rgb_source,  void *rgba_dest, unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void bgr2rgba (void* bgr_source,  void *rgba_dest, unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void rgb2bgra (void* rgb_source,  void *bgra_dest, unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void bgr2bgra (void* bgr_source,  void *bgra_dest, unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void rgba2rgb (void* rgba_source, void *rgb_dest,  unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void rgba2bgr (void* rgba_source, void *bgr_dest,  unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void bgra2rgb (void* bgra_source, void *rgb_dest,  unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+		void bgra2bgr (void* bgra_source, void *bgr_dest,  unsigned int width, unsigned int height, unsigned int srcPitch, unsigned int dstPitch, bool bInvert = false);
+
+		// Convert between rgba, bgra, rgb and bgr, resize and flip in one pass (SpoutResampleMode).
+		// Line pitch in bytes, or 0 for the width times bytes per pixel.
+		bool Resample(const void *source, void *dest,
+					  unsigned int srcWidth, unsigned int srcHeight, unsigned int srcPitch, GLenum srcFormat,
+					  unsigned int dstWidth, unsigned int dstHeight, unsigned int dstPitch, GLenum dstFormat,
+					  int mode = SPOUT_RESAMPLE_BILINEAR, bool bInvert = false);
+
+		// Conversion between 8 bit and high bit depth formats (GL_RGBA16, GL_RGBA16F, GL_RGB10_A2).
+		// Line pitch in bytes, or 0 for the width times bytes per pixel.
+		bool ConvertPixels(const void *source, void *dest,
+						   unsigned int width, unsigned int height,
+						   unsigned int srcPitch, GLenum srcFormat,
+						   unsigned int dstPitch, GLenum dstFormat, bool bInvert = false);
+		bool IsHighBitDepth(GLenum glFormat);
+		unsigned int GetBytesPerPixel(GLenum glFormat);
+
+		// Conversion between rgba, bgra, rgb or bgr and a yuv format (SPOUT_YUV_NV12 etc.)
+		// The yuv buffer is tightly packed. Width must be even, and height also for NV12 and I420.
+		bool rgba2yuv(const void *source, void *yuv_dest,
+					  unsigned int width, unsigned int height,
+					  unsigned int srcPitch, GLenum srcFormat,
+					  unsigned int yuvFormat, bool bInvert = false);
+		bool yuv2rgba(const void *yuv_source, void *dest,
+					  unsigned int width, unsigned int height,
+					  unsigned int yuvFormat,
+					  unsigned int dstPitch, GLenum dstFormat, bool bInvert = false);
+		bool IsYUVformat(unsigned int format);
+		unsigned int GetYUVsize(unsigned int format, unsigned int width, unsigned int height);
+		// BT.601 (default) or BT.709 (SpoutYUVMatrix), full (0-255) or limited (16-235) range (default)
+		void SetYUVmatrix(int matrix, bool bFullRange = false);
+
+		// Alpha applied with copy and conversion to rgba or bgra (SpoutAlphaMode)
+		void SetAlphaMode(int mode);
+		int  GetAlphaMode();
+
+		// Instruction set used by the conversion functions (SpoutCopyISA).
+		// Detected on construction, but can be set lower for testing.
+		int  GetISA();
+		bool SetISA(int isa);
+
+		// Copy and conversion of large images divided between threads.
+		// Number of threads including the caller : 0 - all processors, 1 - disabled (default)
+		void SetThreadCount(unsigned int nThreads);
+		unsigned int GetThreadCount();
+		// Minimum image size in bytes to use threads (default 2MB)
+		void SetThreadThreshold(unsigned int nBytes);
+		unsigned int GetThreadThreshold();
+
 	private :
 
 		void CheckSSE();
+		void CheckAVX();
+		void InitRowFunctions(int isa);
+		bool ConvertRows(const void *source, void *dest,
+						 unsigned int width, unsigned int height,
+						 unsigned int srcBytes, unsigned int dstBytes,
+						 unsigned int srcPitch, unsigned int dstPitch,
+						 spoutRowFunc rowfunc, bool bInvert,
+						 spoutRowFunc rowfunc2 = NULL, unsigned int midBytes = 0,
+						 bool bAlpha = true);
+		spoutRowFunc GetAlphaFunction();
+
 		bool m_bSSE2;
 		bool m_bSSE3;
 		bool m_bSSSE3;
+		bool m_bAVX2;
+		bool m_bAVX512BW;
+		bool m_bF16C;
+		int m_ISA; // instruction set in use
+		int m_maxISA; // highest instruction set supported by the cpu
+		spoutRowFunc m_RowFunc[SPOUT_ROW_COUNT]; // line conversion for each SpoutCopyRow
+
+		// Pointer to avoid size differences between compilers
+		spoutCopyPool *m_pPool;
+		unsigned int m_ThreadThreshold;
+
+		// Line buffer for conversion without threads,
+		// kept between frames and enlarged when necessary
+		unsigned char *m_pScratch;
+		size_t m_ScratchSize;
+
+		// Horizontal resample positions for the last size and mode
+		unsigned int *m_pResampleX;
+		unsigned short *m_pResampleF;
+		unsigned int m_ResampleSrcWidth;
+		unsigned int m_ResampleDstWidth;
+		int m_ResampleMode;
+
+		// Yuv conversion matrix and range
+		int m_YUVmatrix;
+		bool m_bYUVfullRange;
+
+		int m_AlphaMode; // SpoutAlphaMode
 
 };
 
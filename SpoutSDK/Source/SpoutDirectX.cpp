@@ -34,6 +34,7 @@
 //		16.01.17	- Add WriteDX9surface
 //		23.01.17	- pEventQuery->Release() for writeDX9surface
 //		24.04.17	- Add MessageBox error warnings in CreateSharedDX11Texture
+//		16.10.26	- Optional wait counters for CheckAccess - SetLockStats
 //		11.11.18	- Add GetImmediateContext()
 //
 // ====================================================================================
@@ -74,6 +75,7 @@ spoutDirectX::spoutDirectX() {
 
 	// For debugging only - to toggle texture access locks disable/enable
 	bUseAccessLocks     = true; // use texture access locks by default
+	m_pAccessStats      = NULL; // no wait counters
 
 	// Output graphics adapter
 	// Programmer can set for an application
@@ -605,7 +607,22 @@ bool spoutDirectX::CheckAccess(HANDLE hAccessMutex)
 		return true; 
 	}
 
-	dwWaitResult = WaitForSingleObject(hAccessMutex, 67); // 4 frames at 60fps
+	if(m_pAccessStats) {
+		// Try without waiting first to find if another process has it
+		dwWaitResult = WaitForSingleObject(hAccessMutex, 0);
+		if(dwWaitResult == WAIT_TIMEOUT) {
+			unsigned long long start = SpoutSharedMemory::GetLockTime();
+			dwWaitResult = WaitForSingleObject(hAccessMutex, 67); // 4 frames at 60fps
+			SpoutSharedMemory::AddLockWait(m_pAccessStats, dwWaitResult == WAIT_OBJECT_0, true, SpoutSharedMemory::GetLockTime() - start);
+		}
+		else {
+			SpoutSharedMemory::AddLockWait(m_pAccessStats, dwWaitResult == WAIT_OBJECT_0, false, 0);
+		}
+	}
+	else {
+		dwWaitResult = WaitForSingleObject(hAccessMutex, 67); // 4 frames at 60fps
+	}
+
 	if (dwWaitResult == WAIT_OBJECT_0 ) {
 		// The state of the object is signalled.
 		return true;
@@ -642,6 +659,12 @@ void spoutDirectX::AllowAccess(HANDLE hAccessMutex)
 }
 
 
+void spoutDirectX::SetLockStats(SpoutLockStats *pStats)
+{
+	m_pAccessStats = pStats;
+}
+
+
 // Set required graphics adapter for output
 bool spoutDirectX::SetAdapter(int index)
 {
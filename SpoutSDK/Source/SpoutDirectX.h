@@ -33,6 +33,7 @@
 #define __spoutDirectX__
 
 #include "SpoutCommon.h"
+#include "SpoutSharedMemory.h" // for SpoutLockStats
 #include <windowsx.h>
 #include <d3d9.h>
 #include <d3d11.h>
@@ -83,6 +84,7 @@ class SPOUT_DLLEXP spoutDirectX {
 		void CloseAccessMutex(HANDLE &hAccessMutex);
 		bool CheckAccess(HANDLE hAccessMutex);
 		void AllowAccess(HANDLE hAccessMutex);
+		void SetLockStats(SpoutLockStats *pStats); // Count the waits of CheckAccess, or NULL not to
 
 		// For debugging only - to toggle texture access locks disable/enable
 		bool bUseAccessLocks;
@@ -97,6 +99,7 @@ class SPOUT_DLLEXP spoutDirectX {
 		ID3D11DeviceContext*	g_pImmediateContext;
 		D3D_DRIVER_TYPE			g_driverType;
 		D3D_FEATURE_LEVEL		g_featureLevel;
+		SpoutLockStats*			m_pAccessStats;
 
 };
 
@@ -194,6 +194,19 @@
 		11.11.18	- Correct release of DX11 immediate context
 					  TODO : DX9 leak checking
 		12.11.18	- Always release DX9 device. Fix Milkdrop crash.
+		16.10.26	- Use staging texture RowPitch and DX9 surface Pitch
+					  for WriteDX11pixels, ReadDX11pixels, WriteDX9pixels, ReadDX9pixels
+					- Yuv formats (NV12, I420, YUY2, UYVY) for Read/WriteTexturePixels and Read/WriteMemoryPixels
+					- GL_RGBA16, GL_RGBA16F and GL_RGB10_A2 for Read/WriteTexturePixels and Read/WriteMemoryPixels
+					- WriteGLDXpixels - copy through the rgba buffer for the spoutcopy alpha mode if there is no pbo
+					- Memoryshare functions use BeginWrite/EndWrite and BeginRead/EndRead for the memoryshare ring
+					- AcquireWriteBuffer and CommitWriteBuffer for senders to write pixels in place
+					- AcquireReadBuffer and ReleaseReadBuffer for receivers to read pixels in place
+					- Line pitch of the source pixels for WriteTexturePixels, WriteMemoryPixels,
+					  WriteDX11pixels, WriteDX9pixels, WriteGLDXpixels and LoadTexturePixels
+					- ReadDX11texture and ReadDX9texture upload with the staging texture
+					  RowPitch and DX9 surface Pitch
+					- Memoryshare frames have the frame number of the sender info map - GetMemoryFrame
 
 */
 
@@ -243,6 +256,8 @@ spoutGLDXinterop::spoutGLDXinterop() {
 	DX11format          = DXGI_FORMAT_B8G8R8A8_UNORM; // Default compatible with DX9
 
 	g_pStagingTexture   = NULL; // DX11 staging texture
+	m_bWriteBuffer      = false;
+	m_bReadBuffer       = false;
 	g_DX9surface        = NULL; // DX9 texture surface in CPU memory
 
 	m_bInitialized      = false;
@@ -286,6 +301,10 @@ spoutGLDXinterop::spoutGLDXinterop() {
 	NextPboIndex = 0;
 	m_pbo[0]     = NULL;
 	m_pbo[1]     = NULL;
+
+	// Rgba buffer for yuv and high bit depth conversion
+	m_pRGBAbuffer    = NULL;
+	m_RGBAbufferSize = 0;
 	
 	// Check the mode currently in the registry
 	// PBO extension availability is checked by SetBufferMode 
@@ -313,6 +332,7 @@ spoutGLDXinterop::~spoutGLDXinterop() {
 	// Because cleanup is not here it has to be specifically called
 	// This is because it can crash on exit - see cleanup for details
 	m_bInitialized = false;
+	if(m_pRGBAbuffer) free((void *)m_pRGBAbuffer);
 }
 
 
@@ -975,6 +995,8 @@ bool spoutGLDXinterop::CreateDX11interop(unsigned int width, unsigned int height
 	//
 	if(m_bUseCPU) {
 		// DX11 staging texture
+		CommitWriteBuffer(false);
+		ReleaseReadBuffer();
 		if(g_pStagingTexture != NULL) {
 			g_pStagingTexture->Release();
 			g_pStagingTexture = NULL;
@@ -1129,6 +1151,8 @@ void spoutGLDXinterop::CleanupDX11(bool bExit)
 		}
 
 		// DX11 staging texture
+		CommitWriteBuffer(false);
+		ReleaseReadBuffer();
 		if(g_pStagingTexture != NULL) {
 			g_pStagingTexture->Release();
 			g_pStagingTexture = NULL;
@@ -1209,6 +1233,10 @@ void spoutGLDXinterop::CleanupInterop(bool bExit)
 	spoutdx.CloseAccessMutex(m_hAccessMutex);
 	m_hAccessMutex = NULL; // Double check that the global handle is NULL
 
+	if(m_pRGBAbuffer) free((void *)m_pRGBAbuffer);
+	m_pRGBAbuffer = NULL;
+	m_RGBAbufferSize = 0;
+
 	m_bInitialized = false;
 
 }
@@ -1489,27 +1517,217 @@ bool spoutGLDXinterop::ReadTexture (GLuint TextureID, GLuint TextureTarget,
 
 bool spoutGLDXinterop::WriteTexturePixels (const unsigned char *pixels, 
 										   unsigned int width, unsigned int height, 
-										   GLenum glFormat, bool bInvert, GLuint HostFBO)
+										   GLenum glFormat, bool bInvert, GLuint HostFBO,
+										   unsigned int pitch)
 {
 	if(m_bUseMemory) { // Memoryshare
-		return(WriteMemoryPixels(pixels, width, height, glFormat, bInvert));
+		return(WriteMemoryPixels(pixels, width, height, glFormat, bInvert, pitch));
 	}
-	else if(m_bUseCPU) { // DirectX CPU
+
+	// Yuv and high bit depth pixels are converted to rgba first
+	if(spoutcopy.IsYUVformat(glFormat) || spoutcopy.IsHighBitDepth(glFormat)) {
+		unsigned char *pRGBA = GetRGBAbuffer(width, height);
+		if(!pRGBA)
+			return false;
+		if(spoutcopy.IsYUVformat(glFormat)) {
+			if(!spoutcopy.yuv2rgba(pixels, pRGBA, width, height, glFormat, 0, GL_RGBA))
+				return false;
+		}
+		else if(!spoutcopy.ConvertPixels(pixels, pRGBA, width, height, pitch, glFormat, 0, GL_RGBA)) {
+			return false;
+		}
+		pixels = pRGBA;
+		glFormat = GL_RGBA;
+		pitch = 0;
+	}
+
+	if(m_bUseCPU) { // DirectX CPU
 		if(GetDX9()) {
-			return(WriteDX9pixels(pixels, width, height, glFormat, bInvert));
+			return(WriteDX9pixels(pixels, width, height, glFormat, bInvert, pitch));
 		}
 		else {
-			return(WriteDX11pixels(pixels, width, height, glFormat, bInvert));
+			return(WriteDX11pixels(pixels, width, height, glFormat, bInvert, pitch));
 		}
 	}
 	else if(m_bGLDXavailable) { // GL/DX interop
-		return(WriteGLDXpixels(pixels, width, height, glFormat, bInvert, HostFBO));
+		return(WriteGLDXpixels(pixels, width, height, glFormat, bInvert, HostFBO, pitch));
 	}
 	else {
 		return false;
 	}
 }
 
+//
+// Buffer for a sender to write the next frame in place, instead of
+// passing pixels to WriteTexturePixels to be copied.
+//
+// Memoryshare returns the next frame of the memory map, RGBA.
+// DirectX CPU mode returns the mapped DX11 staging texture, in the
+// texture format with lines padded to the pitch, or NULL for a texture
+// format with no GL equivalent (GetStagingFormat).
+// There is no buffer for DX9 or the GL/DX interop and NULL is returned.
+// The buffer must be written and passed on by CommitWriteBuffer
+// before any other function of the sender.
+//
+unsigned char * spoutGLDXinterop::AcquireWriteBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedSubResource;
+	unsigned int memWidth, memHeight;
+
+	CommitWriteBuffer(false);
+
+	if(m_bUseMemory) { // Memoryshare
+		if(!memoryshare.GetSenderMemorySize(memWidth, memHeight)
+			|| width != memWidth || height != memHeight)
+			return NULL;
+		unsigned char *pBuffer = memoryshare.BeginWrite();
+		if(!pBuffer)
+			return NULL;
+		pitch = width*4;
+		glFormat = GL_RGBA;
+		m_bWriteBuffer = true;
+		return pBuffer;
+	}
+
+	if(!m_bUseCPU || GetDX9() || !g_pImmediateContext)
+		return NULL;
+
+	if(width != m_TextureInfo.width || height != m_TextureInfo.height)
+		return NULL;
+
+	// No buffer for a texture format that the caller could not write
+	if(!GetStagingFormat(glFormat))
+		return NULL;
+
+	if(!CheckStagingTexture(width, height))
+		return NULL;
+
+	if(FAILED(g_pImmediateContext->Map(g_pStagingTexture, 0, D3D11_MAP_WRITE, 0, &mappedSubResource))
+		|| !mappedSubResource.pData)
+		return NULL;
+
+	pitch = mappedSubResource.RowPitch;
+	m_bWriteBuffer = true;
+
+	return (unsigned char *)mappedSubResource.pData;
+
+} // end AcquireWriteBuffer
+
+
+// Pass on the buffer from AcquireWriteBuffer, or discard it if bPublish is false
+bool spoutGLDXinterop::CommitWriteBuffer(bool bPublish)
+{
+	if(!m_bWriteBuffer)
+		return false;
+
+	m_bWriteBuffer = false;
+
+	if(m_bUseMemory) { // Memoryshare
+		memoryshare.EndWrite(bPublish, GetMemoryFrame());
+		return bPublish;
+	}
+
+	if(!g_pImmediateContext || !g_pStagingTexture)
+		return false;
+
+	g_pImmediateContext->Unmap(g_pStagingTexture, 0);
+
+	// Copy the staging texture to the shared texture
+	if(!bPublish)
+		return false;
+
+	return WriteTexture(&g_pStagingTexture);
+
+} // end CommitWriteBuffer
+
+
+//
+// Buffer for a receiver to read the latest frame in place, instead
+// of having ReadTexturePixels copy it to the receiver's pixels.
+//
+// Memoryshare returns the latest frame of the memory map, RGBA, and holds
+// it so that the sender does not write it. The frame number is that of the
+// frame held, or zero for a sender of an earlier version.
+// DirectX CPU mode copies the shared texture to the DX11 staging texture
+// and returns it mapped, in the texture format with lines padded to the
+// pitch, or NULL for a texture format with no GL equivalent. The frame
+// number is zero.
+// There is no buffer for DX9 or the GL/DX interop and NULL is returned.
+// The buffer is valid until ReleaseReadBuffer.
+//
+const unsigned char * spoutGLDXinterop::AcquireReadBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat, long &frame)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedSubResource;
+	unsigned int memWidth, memHeight;
+
+	ReleaseReadBuffer();
+
+	frame = 0;
+
+	if(m_bUseMemory) { // Memoryshare
+		if(!memoryshare.GetSenderMemorySize(memWidth, memHeight)
+			|| width != memWidth || height != memHeight)
+			return NULL;
+		unsigned char *pBuffer = memoryshare.BeginRead();
+		if(!pBuffer)
+			return NULL;
+		// Not the header frame count, which the sender
+		// may already have moved on since BeginRead
+		frame = memoryshare.GetReadFrame();
+		pitch = width*4;
+		glFormat = GL_RGBA;
+		m_bReadBuffer = true;
+		return pBuffer;
+	}
+
+	if(!m_bUseCPU || GetDX9() || !g_pImmediateContext)
+		return NULL;
+
+	if(width != m_TextureInfo.width || height != m_TextureInfo.height)
+		return NULL;
+
+	// No buffer for a texture format that the caller could not read
+	if(!GetStagingFormat(glFormat))
+		return NULL;
+
+	if(!CheckStagingTexture(width, height))
+		return NULL;
+
+	// Read the shared texture data into the staging texture so it can be accessed
+	if(!ReadTexture(&g_pStagingTexture))
+		return NULL;
+
+	FlushWait(); // Wait for access to the staging texture
+	if(FAILED(g_pImmediateContext->Map(g_pStagingTexture, 0, D3D11_MAP_READ, 0, &mappedSubResource))
+		|| !mappedSubResource.pData)
+		return NULL;
+
+	pitch = mappedSubResource.RowPitch;
+	m_bReadBuffer = true;
+
+	return (const unsigned char *)mappedSubResource.pData;
+
+} // end AcquireReadBuffer
+
+
+void spoutGLDXinterop::ReleaseReadBuffer()
+{
+	if(!m_bReadBuffer)
+		return;
+
+	m_bReadBuffer = false;
+
+	if(m_bUseMemory) { // Memoryshare
+		memoryshare.EndRead();
+		return;
+	}
+
+	if(g_pImmediateContext && g_pStagingTexture)
+		g_pImmediateContext->Unmap(g_pStagingTexture, 0);
+
+} // end ReleaseReadBuffer
+
+
 bool spoutGLDXinterop::ReadTexturePixels (unsigned char *pixels,
 										  unsigned int width, unsigned int height, 
 										  GLenum glFormat, bool bInvert, GLuint HostFBO)
@@ -1517,7 +1735,18 @@ bool spoutGLDXinterop::ReadTexturePixels (unsigned char *pixels,
 	if(m_bUseMemory) { // Memoryshare
 		return(ReadMemoryPixels(pixels, width, height, glFormat, bInvert));
 	}
-	else if(m_bUseCPU) { // DirectX CPU
+
+	// Yuv and high bit depth pixels are converted from rgba
+	if(spoutcopy.IsYUVformat(glFormat) || spoutcopy.IsHighBitDepth(glFormat)) {
+		unsigned char *pRGBA = GetRGBAbuffer(width, height);
+		if(!pRGBA || !ReadTexturePixels(pRGBA, width, height, GL_RGBA, bInvert, HostFBO))
+			return false;
+		if(spoutcopy.IsYUVformat(glFormat))
+			return(spoutcopy.rgba2yuv(pRGBA, pixels, width, height, 0, GL_RGBA, glFormat));
+		return(spoutcopy.ConvertPixels(pRGBA, pixels, width, height, 0, GL_RGBA, 0, glFormat));
+	}
+
+	if(m_bUseCPU) { // DirectX CPU
 		if(GetDX9()) 
 			return(ReadDX9pixels(pixels, width, height, glFormat, bInvert));
 		else
@@ -1531,6 +1760,21 @@ bool spoutGLDXinterop::ReadTexturePixels (unsigned char *pixels,
 	}
 }
 
+
+// Rgba buffer for yuv and high bit depth conversion, kept for the next frame of the same size
+unsigned char * spoutGLDXinterop::GetRGBAbuffer(unsigned int width, unsigned int height)
+{
+	size_t size = (size_t)width*height*4;
+
+	if(!m_pRGBAbuffer || m_RGBAbufferSize < size) {
+		if(m_pRGBAbuffer) free((void *)m_pRGBAbuffer);
+		m_pRGBAbuffer = (unsigned char *)malloc(size);
+		m_RGBAbufferSize = m_pRGBAbuffer ? size : 0;
+	}
+
+	return m_pRGBAbuffer;
+}
+
 bool spoutGLDXinterop::DrawSharedTexture(float max_x, float max_y, float aspect, bool bInvert, GLuint HostFBO)
 {
 	if(m_bUseMemory) { // Memoryshare
@@ -1811,7 +2055,8 @@ bool spoutGLDXinterop::WriteGLDXpixels(const unsigned char *pixels,
 										  unsigned int height, 
 										  GLenum glFormat,
 										  bool bInvert,
-										  GLuint HostFBO)
+										  GLuint HostFBO,
+										  unsigned int pitch)
 {
 	GLenum glformat = glFormat;
 
@@ -1825,9 +2070,19 @@ bool spoutGLDXinterop::WriteGLDXpixels(const unsigned char *pixels,
 	// Transfer the pixels to the local texture
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	if(IsPBOavailable()) {
-		LoadTexturePixels(m_TexID, GL_TEXTURE_2D, width, height, (const unsigned char *)pixels, glFormat);
+		LoadTexturePixels(m_TexID, GL_TEXTURE_2D, width, height, (const unsigned char *)pixels, glFormat, false, pitch);
 	}
 	else {
+		// Pixels are not copied by spoutcopy in this case, so apply the alpha mode
+		// or remove line padding with a copy
+		if((spoutcopy.GetAlphaMode() != SPOUT_ALPHA_KEEP && (glFormat == GL_RGBA || glFormat == 0x80E1))
+			|| (pitch > 0 && pitch != width*spoutcopy.GetBytesPerPixel(glFormat))) {
+			unsigned char *pRGBA = GetRGBAbuffer(width, height);
+			if(!pRGBA)
+				return false;
+			spoutcopy.CopyPixels(pixels, pRGBA, width, height, pitch, 0, glFormat);
+			pixels = pRGBA;
+		}
 		glBindTexture(GL_TEXTURE_2D, m_TexID);
 		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, glformat, GL_UNSIGNED_BYTE, (GLvoid *)pixels);
 		glBindTexture(GL_TEXTURE_2D, 0);
@@ -2171,7 +2426,8 @@ void spoutGLDXinterop::FlushWait()
 bool spoutGLDXinterop::LoadTexturePixels(GLuint TextureID, GLuint TextureTarget, 
 										 unsigned int width, unsigned int height, 
 										 const unsigned char *data, 
-										 GLenum glFormat, bool bInvert)
+										 GLenum glFormat, bool bInvert,
+										 unsigned int pitch)
 {
 	void *pboMemory = NULL;
 	int channels = 4; // RGBA or RGB
@@ -2210,7 +2466,8 @@ bool spoutGLDXinterop::LoadTexturePixels(GLuint TextureID, GLuint TextureTarget,
 	GLerror(); // soak up the error for Processing - only happens once
 	if(pboMemory) {
 		// Update data directly on the mapped buffer
-		spoutcopy.CopyPixels((const unsigned char *)data, (unsigned char *)pboMemory, width, height, glFormat, bInvert);
+		// Source lines can be padded (pitch), the pbo is tightly packed
+		spoutcopy.CopyPixels((const unsigned char *)data, (unsigned char *)pboMemory, width, height, pitch, 0, glFormat, bInvert);
 		glUnmapBufferEXT(GL_PIXEL_UNPACK_BUFFER); // release the mapped buffer
 	}
 	else {
@@ -2338,6 +2595,34 @@ bool spoutGLDXinterop::CheckStagingTexture(unsigned int width, unsigned int heig
 }
 
 
+//
+// GL format of the staging texture pixels, for AcquireWriteBuffer and AcquireReadBuffer.
+// Returns false for a DX11 format that has no GL equivalent.
+//
+bool spoutGLDXinterop::GetStagingFormat(GLenum &glFormat)
+{
+	switch(DX11format) {
+		case DXGI_FORMAT_B8G8R8A8_UNORM :
+			glFormat = GL_BGRA_EXT;
+			return true;
+		case DXGI_FORMAT_R8G8B8A8_UNORM :
+			glFormat = GL_RGBA;
+			return true;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT :
+			glFormat = GL_RGBA16F;
+			return true;
+		case DXGI_FORMAT_R16G16B16A16_UNORM :
+			glFormat = GL_RGBA16;
+			return true;
+		case DXGI_FORMAT_R10G10B10A2_UNORM :
+			glFormat = GL_RGB10_A2;
+			return true;
+		default :
+			return false;
+	}
+}
+
+
 //
 // COPY FROM A USER OPENGL TEXTURE TO THE SHARED DIRECTX TEXTURE BY WAY OF A DX11 STAGING TEXTURE 
 //
@@ -2458,9 +2743,11 @@ bool spoutGLDXinterop::ReadDX11texture (GLuint TextureID,
 				dataPointer = mappedSubResource.pData;
 				if(dataPointer) {
 					if(IsPBOavailable()) { // PBO method
-						LoadTexturePixels(TextureID, TextureTarget, width, height, (const unsigned char *)dataPointer, GL_BGRA_EXT, bInvert);
+						LoadTexturePixels(TextureID, TextureTarget, width, height, (const unsigned char *)dataPointer, GL_BGRA_EXT, bInvert, mappedSubResource.RowPitch);
 					}
 					else {
+						// The staging texture lines can be padded (RowPitch)
+						glPixelStorei(GL_UNPACK_ROW_LENGTH, mappedSubResource.RowPitch/4);
 						if(bInvert) {
 							// Create or resize a local OpenGL texture
 							CheckOpenGLTexture(m_TexID, GL_RGBA, width, height, m_TexWidth, m_TexHeight);
@@ -2477,6 +2764,7 @@ bool spoutGLDXinterop::ReadDX11texture (GLuint TextureID,
 							glTexSubImage2D(TextureTarget, 0, 0, 0, width, height, GL_BGRA_EXT, GL_UNSIGNED_BYTE, dataPointer);
 							glBindTexture(TextureTarget, 0);
 						}
+						glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 					}
 				}
 				g_pImmediateContext->Unmap(g_pStagingTexture, 0);
@@ -2496,7 +2784,8 @@ bool spoutGLDXinterop::WriteDX11pixels (const unsigned char *pixels,
 										unsigned int width,
 										unsigned int height,
 										GLenum glFormat,
-										bool bInvert)
+										bool bInvert,
+										unsigned int pitch)
 {
 	D3D11_MAPPED_SUBRESOURCE mappedSubResource;
 	HRESULT hr;
@@ -2521,18 +2810,19 @@ bool spoutGLDXinterop::WriteDX11pixels (const unsigned char *pixels,
 			dataPointer = mappedSubResource.pData;
 			if(dataPointer) {
 				// Write the user pixel buffer to the staging texture
+				// The staging texture lines can be padded (RowPitch)
 				switch(glFormat) {
 					case GL_BGRA_EXT: // direct copy
-						spoutcopy.CopyPixels(pixels, (unsigned char *)dataPointer, width, height, GL_RGBA, bInvert);
+						spoutcopy.CopyPixels(pixels, (unsigned char *)dataPointer, width, height, pitch, mappedSubResource.RowPitch, GL_RGBA, bInvert);
 						break;
 					case GL_RGBA: // Convert the rgba pixels to bgra for the DX11 texture
-						spoutcopy.rgba2bgra((void *)pixels, dataPointer, width, height, bInvert);
+						spoutcopy.rgba2bgra((void *)pixels, dataPointer, width, height, pitch, mappedSubResource.RowPitch, bInvert);
 						break;
 					case GL_RGB: // Convert the rgb pixels to bgra for the DX11 texture
-						spoutcopy.rgb2bgra((void *)pixels, dataPointer, width, height, bInvert);
+						spoutcopy.rgb2bgra((void *)pixels, dataPointer, width, height, pitch, mappedSubResource.RowPitch, bInvert);
 						break;
 					case GL_BGR_EXT: // Convert the bgr pixels to bgra for the DX11 texture
-						spoutcopy.bgr2bgra((void *)pixels, dataPointer, width, height, bInvert);
+						spoutcopy.bgr2bgra((void *)pixels, dataPointer, width, height, pitch, mappedSubResource.RowPitch, bInvert);
 						break;
 					default:
 						break;
@@ -2581,18 +2871,19 @@ bool spoutGLDXinterop::ReadDX11pixels (unsigned char *pixels,
 				// Get a pointer to the staging texture data
 				dataPointer = mappedSubResource.pData;
 				// Write the the bgra staging texture to the user pixel buffer
+				// The staging texture lines can be padded (RowPitch)
 				switch(glFormat) {
 					case GL_BGRA_EXT: // direct copy
-						spoutcopy.CopyPixels((unsigned char *)dataPointer, pixels, width, height, GL_RGBA, bInvert);
+						spoutcopy.CopyPixels((unsigned char *)dataPointer, pixels, width, height, mappedSubResource.RowPitch, 0, GL_RGBA, bInvert);
 						break;
 					case GL_RGBA:
-						spoutcopy.bgra2rgba(dataPointer, (void *)pixels, width, height, bInvert);
+						spoutcopy.bgra2rgba(dataPointer, (void *)pixels, width, height, mappedSubResource.RowPitch, 0, bInvert);
 						break;
 					case GL_RGB:
-						spoutcopy.bgra2rgb(dataPointer, (void *)pixels, width, height, bInvert);
+						spoutcopy.bgra2rgb(dataPointer, (void *)pixels, width, height, mappedSubResource.RowPitch, 0, bInvert);
 						break;
 					case GL_BGR_EXT:
-						spoutcopy.bgra2bgr(dataPointer, (void *)pixels, width, height, bInvert);
+						spoutcopy.bgra2bgr(dataPointer, (void *)pixels, width, height, mappedSubResource.RowPitch, 0, bInvert);
 						break;
 					default:
 						break;
@@ -2934,12 +3225,15 @@ bool spoutGLDXinterop::ReadDX9texture (GLuint TextureID,
 				if(SUCCEEDED(hr)) {
 					// Copy the surface pixels to the local OpenGL texture
 					if(IsPBOavailable()) {
-						LoadTexturePixels(m_TexID, GL_TEXTURE_2D, width, height, (const unsigned char *)d3dlr.pBits, GL_BGRA_EXT);
+						LoadTexturePixels(m_TexID, GL_TEXTURE_2D, width, height, (const unsigned char *)d3dlr.pBits, GL_BGRA_EXT, false, (unsigned int)d3dlr.Pitch);
 					}
 					else {
+						// The surface lines can be padded (Pitch)
+						glPixelStorei(GL_UNPACK_ROW_LENGTH, d3dlr.Pitch/4);
 						glBindTexture(GL_TEXTURE_2D, m_TexID);
 						glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA_EXT, GL_UNSIGNED_BYTE, d3dlr.pBits);
 						glBindTexture(GL_TEXTURE_2D, 0);
+						glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 					}
 					// Copy the local texture to the user texture and invert as necessary
 					CopyTexture(m_TexID, GL_TEXTURE_2D, TextureID, TextureTarget, width, height, bInvert, HostFBO);
@@ -2967,7 +3261,8 @@ bool spoutGLDXinterop::WriteDX9pixels (const unsigned char *pixels,
 									   unsigned int width,
 									   unsigned int height,
 									   GLenum glFormat,
-									   bool bInvert)
+									   bool bInvert,
+									   unsigned int pitch)
 {
 	D3DLOCKED_RECT d3dlr; // LockRect for data transfer
 	HRESULT hr;
@@ -2988,18 +3283,19 @@ bool spoutGLDXinterop::WriteDX9pixels (const unsigned char *pixels,
 	hr = g_DX9surface->LockRect(&d3dlr, NULL, D3DLOCK_DISCARD);
 	if(SUCCEEDED(hr)) {
 		// Write the user buffer to the bgra DX9 surface
+		// The surface lines can be padded (Pitch)
 		switch(glFormat) {
 			case GL_BGRA_EXT: // direct copy
-				spoutcopy.CopyPixels(pixels, (unsigned char *)d3dlr.pBits, width, height, GL_RGBA, bInvert);
+				spoutcopy.CopyPixels(pixels, (unsigned char *)d3dlr.pBits, width, height, pitch, (unsigned int)d3dlr.Pitch, GL_RGBA, bInvert);
 				break;
 			case GL_RGBA: // Convert the rgba pixels to bgra
-				spoutcopy.rgba2bgra((void *)pixels, d3dlr.pBits, width, height, bInvert);
+				spoutcopy.rgba2bgra((void *)pixels, d3dlr.pBits, width, height, pitch, (unsigned int)d3dlr.Pitch, bInvert);
 				break;
 			case GL_RGB: // Convert the rgb pixels to bgra
-				spoutcopy.rgb2bgra((void *)pixels, d3dlr.pBits, width, height, bInvert);
+				spoutcopy.rgb2bgra((void *)pixels, d3dlr.pBits, width, height, pitch, (unsigned int)d3dlr.Pitch, bInvert);
 				break;
 			case GL_BGR_EXT: // Convert the bgr pixels to bgra
-				spoutcopy.bgr2bgra((void *)pixels, d3dlr.pBits, width, height, bInvert);
+				spoutcopy.bgr2bgra((void *)pixels, d3dlr.pBits, width, height, pitch, (unsigned int)d3dlr.Pitch, bInvert);
 				break;
 			default:
 				break;
@@ -3050,18 +3346,19 @@ bool spoutGLDXinterop::ReadDX9pixels (unsigned char *pixels,
 				hr = g_DX9surface->LockRect(&d3dlr, NULL, D3DLOCK_NO_DIRTY_UPDATE | D3DLOCK_READONLY);
 				if(SUCCEEDED(hr)) {
 					// Write BGRA pixels to the user buffer
+					// The surface lines can be padded (Pitch)
 					switch(glFormat) {
 						case GL_BGRA_EXT: // direct copy
-							spoutcopy.CopyPixels((const unsigned char *)d3dlr.pBits, pixels, width, height, GL_RGBA, bInvert);
+							spoutcopy.CopyPixels((const unsigned char *)d3dlr.pBits, pixels, width, height, (unsigned int)d3dlr.Pitch, 0, GL_RGBA, bInvert);
 							break;
 						case GL_RGBA: // Convert bgra to rgba
-							spoutcopy.bgra2rgba(d3dlr.pBits, (void *)pixels, width, height, bInvert);
+							spoutcopy.bgra2rgba(d3dlr.pBits, (void *)pixels, width, height, (unsigned int)d3dlr.Pitch, 0, bInvert);
 							break;
 						case GL_RGB: // Convert bgra to rgb
-							spoutcopy.bgra2rgb(d3dlr.pBits, (void *)pixels, width, height, bInvert);
+							spoutcopy.bgra2rgb(d3dlr.pBits, (void *)pixels, width, height, (unsigned int)d3dlr.Pitch, 0, bInvert);
 							break;
 						case GL_BGR_EXT: // Convert bgra to bgr
-							spoutcopy.bgra2bgr(d3dlr.pBits, (void *)pixels, width, height, bInvert);
+							spoutcopy.bgra2bgr(d3dlr.pBits, (void *)pixels, width, height, (unsigned int)d3dlr.Pitch, 0, bInvert);
 							break;
 						default:
 							break;
@@ -3665,6 +3962,22 @@ void spoutGLDXinterop::PrintFBOstatus(GLenum status)
 //               2.005 Memoryshare functions
 // =======================================================
 
+//
+// Frame number that SetFrameReady gives the frame being written, so that
+// the frame of the memory map is the sender frame count of receivers.
+// Zero if there is no sender info to count it, and the map counts it.
+//
+long spoutGLDXinterop::GetMemoryFrame()
+{
+	long frame = 0;
+
+	if(!senders.GetFrameCount(memoryshare.GetSenderName(), frame))
+		return 0;
+
+	return frame + 1;
+}
+
+
 //
 // Write user texture pixel data to shared memory
 // rgba textures only
@@ -3677,7 +3990,7 @@ bool spoutGLDXinterop::WriteMemory (GLuint TexID,
 									GLuint HostFBO)
 {
 
-	unsigned char *pBuffer = memoryshare.LockSenderMemory();
+	unsigned char *pBuffer = memoryshare.BeginWrite();
 	if(!pBuffer) {
 		return false;
 	}
@@ -3702,7 +4015,7 @@ bool spoutGLDXinterop::WriteMemory (GLuint TexID,
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
-	memoryshare.UnlockSenderMemory();
+	memoryshare.EndWrite(true, GetMemoryFrame());
 
 	return true;
 }
@@ -3718,7 +4031,7 @@ bool spoutGLDXinterop::ReadMemory(GLuint TexID,
 								  bool bInvert,
 								  GLuint HostFBO)
 {
-	unsigned char *pBuffer = memoryshare.LockSenderMemory();
+	unsigned char *pBuffer = memoryshare.BeginRead();
 	if(!pBuffer) return false;
 
 	// Create or resize a local OpenGL texture
@@ -3737,7 +4050,7 @@ bool spoutGLDXinterop::ReadMemory(GLuint TexID,
 	// Copy the local rgba texture to the user texture and invert as necessary
 	CopyTexture(m_TexID, GL_TEXTURE_2D, TexID, TextureTarget, width, height, bInvert, HostFBO);
 
-	memoryshare.UnlockSenderMemory();
+	memoryshare.EndRead();
 	
 	return true;
 
@@ -3745,30 +4058,44 @@ bool spoutGLDXinterop::ReadMemory(GLuint TexID,
 
 //
 // Write image pixels to shared memory
-// rgba, bgra, rgb, bgr source buffers supported
+// rgba, bgra, rgb, bgr, yuv and high bit depth source buffers supported
+// Line pitch of the source pixels in bytes, 0 for tightly packed lines (not yuv)
 //
-bool spoutGLDXinterop::WriteMemoryPixels(const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat, bool bInvert)
+bool spoutGLDXinterop::WriteMemoryPixels(const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat, bool bInvert, unsigned int pitch)
 {
-	unsigned char *pBuffer = memoryshare.LockSenderMemory();
+	bool bResult = true;
+	unsigned char *pBuffer = memoryshare.BeginWrite();
 
 	if(!pBuffer)
 		return false;
 
 	// Write pixels to shared memory
 	if(glFormat == GL_RGBA) {
-		spoutcopy.CopyPixels(pixels, pBuffer, width, height, GL_RGBA, bInvert);
+		spoutcopy.CopyPixels(pixels, pBuffer, width, height, pitch, 0, GL_RGBA, bInvert);
 	}
 	else if(glFormat == 0x80E1) { // GL_BGRA_EXT if supported
-		spoutcopy.bgra2rgba((void *)pixels, (void *)pBuffer, width, height, bInvert);
+		spoutcopy.bgra2rgba((void *)pixels, (void *)pBuffer, width, height, pitch, 0, bInvert);
 	}
 	else if(glFormat == 0x80E0) { // GL_BGR_EXT if supported
-		spoutcopy.bgr2rgba((void *)pixels, (void *)pBuffer, width, height, bInvert);
+		spoutcopy.bgr2rgba((void *)pixels, (void *)pBuffer, width, height, pitch, 0, bInvert);
 	}
 	else if(glFormat == GL_RGB) {
-		spoutcopy.rgb2rgba((void *)pixels, (void *)pBuffer, width, height, bInvert);
+		spoutcopy.rgb2rgba((void *)pixels, (void *)pBuffer, width, height, pitch, 0, bInvert);
+	}
+	else if(spoutcopy.IsYUVformat(glFormat)) {
+		bResult = spoutcopy.yuv2rgba(pixels, pBuffer, width, height, glFormat, 0, GL_RGBA, bInvert);
+	}
+	else if(spoutcopy.IsHighBitDepth(glFormat)) { // GL_RGBA16, GL_RGBA16F, GL_RGB10_A2
+		bResult = spoutcopy.ConvertPixels(pixels, pBuffer, width, height, pitch, glFormat, 0, GL_RGBA, bInvert);
+	}
+
+	// Do not publish a frame that was not converted
+	if(!bResult) {
+		memoryshare.EndWrite(false);
+		return false;
 	}
 
-	memoryshare.UnlockSenderMemory();
+	memoryshare.EndWrite(true, GetMemoryFrame());
 
 	return true;
 
@@ -3777,13 +4104,14 @@ bool spoutGLDXinterop::WriteMemoryPixels(const unsigned char *pixels, unsigned i
 
 //
 // Read shared memory to image pixels
-// rgba, bgra, rgb, bgr destination buffers supported
+// rgba, bgra, rgb, bgr, yuv and high bit depth destination buffers supported
 // Most efficient if the receiving buffer is rgba
 // Invert currently not used
 //
 bool spoutGLDXinterop::ReadMemoryPixels(unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat, bool bInvert)
 {
-	unsigned char *pBuffer = memoryshare.LockSenderMemory();
+	bool bResult = true;
+	unsigned char *pBuffer = memoryshare.BeginRead();
 
 	if(!pBuffer)
 		return false;
@@ -3801,10 +4129,16 @@ bool spoutGLDXinterop::ReadMemoryPixels(unsigned char *pixels, unsigned int widt
 	else if(glFormat == GL_RGB) {
 		spoutcopy.rgba2rgb((void *)pBuffer, (void *)pixels, width, height, bInvert);
 	}
+	else if(spoutcopy.IsYUVformat(glFormat)) {
+		bResult = spoutcopy.rgba2yuv(pBuffer, pixels, width, height, 0, GL_RGBA, glFormat, bInvert);
+	}
+	else if(spoutcopy.IsHighBitDepth(glFormat)) { // GL_RGBA16, GL_RGBA16F, GL_RGB10_A2
+		bResult = spoutcopy.ConvertPixels(pBuffer, pixels, width, height, 0, GL_RGBA, 0, glFormat, bInvert);
+	}
 
-	memoryshare.UnlockSenderMemory();
+	memoryshare.EndRead();
 
-	return true;
+	return bResult;
 
 }
 
@@ -3827,7 +4161,7 @@ bool spoutGLDXinterop::DrawToSharedMemory(GLuint TexID, GLuint TextureTarget,
 	if(width != memWidth || height != memHeight) 
 		return false;
 
-	unsigned char *pBuffer = memoryshare.LockSenderMemory();
+	unsigned char *pBuffer = memoryshare.BeginWrite();
 	if(!pBuffer) {
 		return false;
 	}
@@ -3891,7 +4225,7 @@ bool spoutGLDXinterop::DrawToSharedMemory(GLuint TexID, GLuint TextureTarget,
 	else {
 		PrintFBOstatus(status);
 		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, HostFBO);
-		memoryshare.UnlockSenderMemory();
+		memoryshare.EndWrite(false);
 		return false;
 	}
 
@@ -3909,7 +4243,7 @@ bool spoutGLDXinterop::DrawToSharedMemory(GLuint TexID, GLuint TextureTarget,
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
-	memoryshare.UnlockSenderMemory();
+	memoryshare.EndWrite(true, GetMemoryFrame());
 
 
 	return true;
@@ -3928,7 +4262,7 @@ bool spoutGLDXinterop::DrawSharedMemory(float max_x, float max_y, float aspect,
 		return false;
 
 	// Find the shared memory buffer pointer
-	unsigned char *pBuffer = memoryshare.LockSenderMemory();
+	unsigned char *pBuffer = memoryshare.BeginRead();
 	if(!pBuffer) return false;
 
 	// Create or resize a local OpenGL texture
@@ -3966,7 +4300,7 @@ bool spoutGLDXinterop::DrawSharedMemory(float max_x, float max_y, float aspect,
 	glDisable(GL_TEXTURE_2D);
 	RestoreOpenGLstate();
 
-	memoryshare.UnlockSenderMemory();
+	memoryshare.EndRead();
 
 	return true;
 }
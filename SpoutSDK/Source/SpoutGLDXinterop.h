@@ -38,7 +38,7 @@
 #include "spoutDirectX.h"
 #include "spoutSenderNames.h"
 #include "SpoutMemoryShare.h"
-#include "spoutCopy.h"
+#include "SpoutCopy.h"
 
 #include <windowsx.h>
 #include <d3d9.h>	// DX9
@@ -74,12 +74,20 @@ class SPOUT_DLLEXP spoutGLDXinterop {
 		// Texture functions
 		bool WriteTexture(GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=true,  GLuint HostFBO=0);
 		bool ReadTexture (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=false, GLuint HostFBO=0);
-		bool WriteTexturePixels(const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO = 0);
+		bool WriteTexturePixels(const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO = 0, unsigned int pitch = 0);
 		bool ReadTexturePixels (unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO=0);
 		bool DrawSharedTexture (float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = true, GLuint HostFBO = 0);
 		bool DrawToSharedTexture (GLuint TexID, GLuint TexTarget, unsigned int width, unsigned int height, float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO = 0);
 		bool BindSharedTexture();
 		bool UnBindSharedTexture();
+
+		// Sender buffer written in place of WriteTexturePixels
+		unsigned char * AcquireWriteBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat);
+		bool CommitWriteBuffer(bool bPublish = true);
+
+		// Receiver buffer read in place of ReadTexturePixels
+		const unsigned char * AcquireReadBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat, long &frame);
+		void ReleaseReadBuffer();
 		
 		// DX11 shared texture write and read
 		bool WriteTexture(ID3D11Texture2D** texture);
@@ -94,7 +102,7 @@ class SPOUT_DLLEXP spoutGLDXinterop {
 		bool LoadTexturePixels(GLuint TextureID, GLuint TextureTarget, 
 							   unsigned int width, unsigned int height,
 							   const unsigned char *data, GLenum glFormat = GL_RGBA, 
-							   bool bInvert = false);
+							   bool bInvert = false, unsigned int pitch = 0);
 
 		// DX9
 		bool m_bUseDX9; // Use DX11 (default) or DX9
@@ -210,6 +218,11 @@ protected:
 		int PboIndex;
 		int NextPboIndex;
 
+		// Rgba buffer for yuv and high bit depth conversion
+		unsigned char *m_pRGBAbuffer;
+		size_t m_RGBAbufferSize;
+		unsigned char *GetRGBAbuffer(unsigned int width, unsigned int height);
+
 		// For InitOpenGL and CloseOpenGL
 		HDC m_hdc;
 		HWND m_hwndButton;
@@ -220,6 +233,8 @@ protected:
 		D3D_DRIVER_TYPE      g_driverType;
 		D3D_FEATURE_LEVEL    g_featureLevel;
 		ID3D11Texture2D*     g_pStagingTexture; // A staging texture for CPU access
+		bool                 m_bWriteBuffer;    // AcquireWriteBuffer has mapped the staging texture or memory map
+		bool                 m_bReadBuffer;     // AcquireReadBuffer has mapped the staging texture or memory map
 
 		// DX9
 		IDirect3D9Ex* m_pD3D; // DX9 object
@@ -236,7 +251,7 @@ protected:
 		// GL/DX interop texture functions
 		bool WriteGLDXtexture (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=true,  GLuint HostFBO=0);
 		bool ReadGLDXtexture  (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=false, GLuint HostFBO=0);
-		bool WriteGLDXpixels  (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO = 0);
+		bool WriteGLDXpixels  (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO = 0, unsigned int pitch = 0);
 		bool ReadGLDXpixels   (unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO=0);
 		bool DrawGLDXtexture  (float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = true);
 		bool DrawToGLDXtexture(GLuint TexID, GLuint TexTarget, unsigned int width, unsigned int height, float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO = 0);
@@ -244,18 +259,19 @@ protected:
 		// DX11 staging texture functions for CPU access
 		bool WriteDX11texture (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=false, GLuint HostFBO=0);
 		bool ReadDX11texture  (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=false, GLuint HostFBO=0);
-		bool WriteDX11pixels  (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=false);
+		bool WriteDX11pixels  (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=false, unsigned int pitch = 0);
 		bool ReadDX11pixels   (unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=false);
 		bool DrawDX11texture  (float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO=0);
 		bool DrawToDX11texture(GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO = 0);
 		bool CheckStagingTexture(unsigned int width, unsigned int height);
+		bool GetStagingFormat(GLenum &glFormat);
 		void FlushWait();
 
 		// DX9 surface functions for CPU access
 		bool WriteDX9surface (LPDIRECT3DSURFACE9 source_surface);
 		bool WriteDX9texture (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=false, GLuint HostFBO=0);
 		bool ReadDX9texture  (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=false, GLuint HostFBO=0);
-		bool WriteDX9pixels  (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=false);
+		bool WriteDX9pixels  (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=false, unsigned int pitch = 0);
 		bool ReadDX9pixels   (unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=false);
 		bool DrawDX9texture  (float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO = 0);
 		bool DrawToDX9texture(GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO = 0);
@@ -264,10 +280,11 @@ protected:
 		// Memoryshare functions
 		bool WriteMemory (GLuint TexID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert = false,  GLuint HostFBO=0);
 		bool ReadMemory  (GLuint TexID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert = false,  GLuint HostFBO=0);
-		bool WriteMemoryPixels (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false);
+		bool WriteMemoryPixels (const unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false, unsigned int pitch = 0);
 		bool ReadMemoryPixels  (unsigned char *pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert = false);
 		bool DrawSharedMemory  (float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false);
 		bool DrawToSharedMemory(GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = false, GLuint HostFBO = 0);
+		long GetMemoryFrame();
 
 		// Utility
 		bool OpenDeviceKey(const char* key, int maxsize, char *description, char *version);
@@ -14,6 +14,20 @@
 	25.09.15 - set sendermem object pointer to NULL in constructor
 	11.10.15 - introduced global width and height and GetSenderMemorySize function
 	29.02.16 - cleanup
+	16.10.26 - Ring of image buffers so that the sender and receivers do not wait for each other
+			   BeginWrite, EndWrite, BeginRead and EndRead for both single buffer and ring
+			 - Binary header with image size, format, frame count and time at the start of the map
+			   OpenSenderMemory sets the global width and height from the header
+			 - Maps are created with a capacity larger than the image and a new size
+			   within the capacity only changes the header. SetSenderMemoryCapacity.
+			 - Optional wait counters for the map mutex - SetLockStats
+			 - The ring map has its lock in the map instead of a named mutex
+			 - Take-back epoch with the reader count of each ring slot
+			 - Frame number of each ring slot - GetReadFrame
+			 - The header of the single buffer map is in a separate "<sendername>_header" map
+			   and "_map" has the layout of earlier versions for their receivers
+			 - EndWrite records the frame number of the sender info map so that
+			   GetReadFrame is the same count as the sender frame of receivers
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 	Copyright (c) 2014-2017, Lynn Jarvis. All rights reserved.
@@ -45,14 +59,30 @@
 
 spoutMemoryShare::spoutMemoryShare() {
 	senderMem = NULL; // Important because this is checked
+	headerMem = NULL;
+	m_pLockStats = NULL;
 	m_Width = 0;
 	m_Height = 0;
+	m_RingSlots = 0; // single buffer
+	m_MaxCapacity = 0; // size classes
+	m_bRing = false;
+	m_bHeader = false;
+	m_WriteSlot = -1;
+	m_ReadSlot = -1;
+	m_ReadEpoch = 0;
+	m_ReadFrame = 0;
+	m_SenderName[0] = 0;
+	for(int i = 0; i < SPOUT_RING_MAX_SLOTS; i++)
+		m_SlotBusyTime[i] = 0;
 }
 
 spoutMemoryShare::~spoutMemoryShare() {
 
+	EndRead();
+	EndWrite(false);
 	if(senderMem) delete senderMem;
 	senderMem = NULL;
+	CloseHeaderMap();
 	m_Width = 0;
 	m_Height = 0;
 	
@@ -63,32 +93,22 @@ spoutMemoryShare::~spoutMemoryShare() {
 // RECEIVER : Attach to an existing named shared memory map
 bool spoutMemoryShare::CreateSenderMemory(const char *sendername, unsigned int width, unsigned int height)
 {
-	string namestring = sendername;
-
-	// Create a name for the map from the sender name
-	namestring += "_map";
-
-	// Create a new shared memory class object for this sender
-	if(senderMem) delete senderMem;
-	senderMem = new SpoutSharedMemory();
-
-	// Create a shared memory map for this sender
-	// Allocate enough width*height*4 - RGBA image
-	SpoutCreateResult result = senderMem->Create(namestring.c_str(), width*height*4 );
-
-	if(result == SPOUT_CREATE_FAILED) {
-		delete senderMem;
-		senderMem = NULL;
-		m_Width = 0;
-		m_Height = 0;
-		return false;
+	// Already open with room for the image
+	if(ResizeSenderMemory(sendername, width, height))
+		return true;
+
+	// A sender creates a ring if slots have been set.
+	// A receiver attaches to the ring of a sender that has created one.
+	if(m_RingSlots > 0)
+		return CreateSenderRing(sendername, width, height);
+
+	if(OpenSenderRing(sendername)) {
+		m_Width = width;
+		m_Height = height;
+		return true;
 	}
-	
-	// Set the global width and height for future reference
-	m_Width = width;
-	m_Height = height;
 
-	return true;
+	return CreateSenderMap(sendername, width, height);
 		
 } // end CreateSenderMemory
 
@@ -97,31 +117,28 @@ bool spoutMemoryShare::CreateSenderMemory(const char *sendername, unsigned int w
 // Only the sender can update the memory map size by creating a new one because 
 // the sender creates the map and it's map handle cannot be released by a receiver,
 // so a new map cannot be created by a receiver.
+// Within the capacity of the map only the header is changed.
 bool spoutMemoryShare::UpdateSenderMemorySize(const char *sendername, unsigned int width, unsigned int height)
 {
-	string namestring = sendername;
-
-	namestring += "_map";
-
-	// Delete the existing sender shared memory object - Releases mutex and maps
-	if(senderMem) delete senderMem;
-	// Create a new shared memory map for this sender
-	senderMem = new SpoutSharedMemory();
-
-	SpoutCreateResult result = senderMem->Create(namestring.c_str(), width*height*4 );
-	if(result == SPOUT_CREATE_FAILED) {
-		delete senderMem;
-		senderMem = NULL;
-		m_Width = 0;
-		m_Height = 0;
-		return false;
+	if(ResizeSenderMemory(sendername, width, height)) {
+		// The header of the single buffer is changed by the next frame written.
+		// Ring slots all have the size in the header, so receivers
+		// have no frame until the first at the new size.
+		SpoutMemoryRingHeader *header = GetRingHeader();
+		if(header && senderMem->Lock()) {
+			InterlockedExchange(&header->latest, -1);
+			header->info.width = width;
+			header->info.height = height;
+			header->info.pitch = width*4;
+			senderMem->Unlock();
+		}
+		return true;
 	}
 
-	// Reset the global width and height
-	m_Width = width;
-	m_Height = height;
+	if(m_RingSlots > 0)
+		return CreateSenderRing(sendername, width, height);
 
-	return true;
+	return CreateSenderMap(sendername, width, height);
 		
 } // end UpdateSenderMemorySize
 
@@ -135,16 +152,36 @@ bool spoutMemoryShare::OpenSenderMemory(const char *sendername)
 	// Create a name for the map from the sender name
 	namestring += "_map";
 
+	// A sender with a ring
+	if(OpenSenderRing(sendername)) {
+		SpoutMemoryRingHeader *ring = GetRingHeader();
+		m_Width = ring->info.width;
+		m_Height = ring->info.height;
+		return true;
+	}
+
+	EndRead();
+	if(m_bRing && senderMem) {
+		delete senderMem;
+		senderMem = NULL;
+	}
+	m_bRing = false;
+	CloseHeaderMap();
+
 	// Create a new shared memory class object for this receiver
 	if(!senderMem) senderMem = new SpoutSharedMemory();
+	senderMem->SetLockStats(m_pLockStats);
 
 	if(!senderMem->Open(namestring.c_str()) ) {
 		return false;
 	}
 
-	// TODO : Set the global width and height - how ?
-	// m_Width = width;
-	// m_Height = height;
+	// Set the global width and height from the header
+	if(OpenHeaderMap(sendername)) {
+		SpoutMemoryHeader *header = GetHeader();
+		m_Width = header->width;
+		m_Height = header->height;
+	}
 
 	return true;
 		
@@ -164,11 +201,53 @@ bool spoutMemoryShare::GetSenderMemorySize(unsigned int &width, unsigned int &he
 } // end GetSenderMemorySize
 
 
+// Copy the header of the open map without waiting for the mutex
+// Returns false for a map of an earlier version without a header
+bool spoutMemoryShare::GetSenderMemoryHeader(SpoutMemoryHeader &header)
+{
+	SpoutMemoryHeader *pHeader = GetHeader();
+	if(!pHeader) return false;
+
+	header = *pHeader;
+
+	return true;
+
+} // end GetSenderMemoryHeader
+
+
+
+// SENDER : Set the maximum image size so that a new map does
+// not have to be created when the sender changes size
+void spoutMemoryShare::SetSenderMemoryCapacity(unsigned int width, unsigned int height)
+{
+	m_MaxCapacity = width*height*4;
+}
+
+
+// Bytes available for the image, or for each slot of a ring
+unsigned int spoutMemoryShare::GetSenderMemoryCapacity()
+{
+	SpoutMemoryHeader *header = GetHeader();
+	if(!header) return 0;
+	return header->capacity;
+}
+
+
+void spoutMemoryShare::SetLockStats(SpoutLockStats *pStats)
+{
+	m_pLockStats = pStats;
+	if(senderMem) senderMem->SetLockStats(pStats);
+}
+
 
 //	Close the sender shared memory map
 void spoutMemoryShare::CloseSenderMemory()
 {
+	EndRead();
+	EndWrite(false);
 	if(senderMem) senderMem->Close();
+	CloseHeaderMap();
+	m_bRing = false;
 	m_Width = 0;
 	m_Height = 0;
 		
@@ -179,8 +258,12 @@ void spoutMemoryShare::CloseSenderMemory()
 void spoutMemoryShare::ReleaseSenderMemory()
 {
 	// Delete the sender shared memory object - Releases mutex and maps
+	EndRead();
+	EndWrite(false);
 	if(senderMem) delete senderMem;
 	senderMem = NULL;
+	CloseHeaderMap();
+	m_bRing = false;
 	m_Width = 0;
 	m_Height = 0;
 
@@ -209,3 +292,578 @@ void spoutMemoryShare::UnlockSenderMemory()
 	senderMem->Unlock();
 }
 
+
+// =======================================================
+//                   Memory map header
+// =======================================================
+
+// Create a memory map and its header map, or attach to existing ones.
+// A map that is still open by other processes keeps the size it was
+// created with, so fail if that is too small for the image.
+bool spoutMemoryShare::CreateSenderMap(const char *sendername, unsigned int width, unsigned int height)
+{
+	string namestring = sendername;
+
+	// Create a name for the map from the sender name
+	namestring += "_map";
+
+	// Delete the existing sender shared memory object - Releases mutex and maps
+	EndRead();
+	EndWrite(false);
+	if(senderMem) delete senderMem;
+	CloseHeaderMap();
+	m_bRing = false;
+	m_Width = 0;
+	m_Height = 0;
+
+	// Create a new shared memory class object for this sender
+	senderMem = new SpoutSharedMemory();
+	senderMem->SetLockStats(m_pLockStats);
+
+	// Create a shared memory map for this sender
+	// Allocate the capacity for an RGBA image
+	unsigned int capacity = GetCapacity(width, height);
+	SpoutCreateResult result = senderMem->Create(namestring.c_str(), capacity);
+	if(result == SPOUT_CREATE_FAILED) {
+		delete senderMem;
+		senderMem = NULL;
+		return false;
+	}
+
+	// The header is written and read with the image map locked
+	SpoutCreateResult headerResult = CreateHeaderMap(sendername);
+	if(!senderMem->Lock()) {
+		delete senderMem;
+		senderMem = NULL;
+		CloseHeaderMap();
+		return false;
+	}
+
+	SpoutMemoryHeader *header = headerMem ? (SpoutMemoryHeader *)headerMem->GetBuffer() : NULL;
+	if(result == SPOUT_ALREADY_EXISTS) {
+		// A map without a header is from a sender of an earlier version
+		if(header && headerResult == SPOUT_ALREADY_EXISTS && header->magic == SPOUT_MEMORY_MAGIC) {
+			if(header->capacity < width*height*4) {
+				printf("spoutMemoryShare::CreateSenderMap - existing map is too small\n");
+				senderMem->Unlock();
+				delete senderMem;
+				senderMem = NULL;
+				CloseHeaderMap();
+				return false;
+			}
+			m_bHeader = true;
+		}
+	}
+	else if(header) {
+		SetHeader(header, width, height, capacity);
+		m_bHeader = true;
+	}
+
+	senderMem->Unlock();
+
+	if(!m_bHeader)
+		CloseHeaderMap();
+
+	// Set the global width and height for future reference
+	m_Width = width;
+	m_Height = height;
+	if(sendername != m_SenderName)
+		strcpy_s(m_SenderName, 256, sendername);
+
+	return true;
+
+} // end CreateSenderMap
+
+
+// Keep the open map if the image fits
+bool spoutMemoryShare::ResizeSenderMemory(const char *sendername, unsigned int width, unsigned int height)
+{
+	SpoutMemoryHeader *header = GetHeader();
+	if(!header || strcmp(sendername, m_SenderName) != 0)
+		return false;
+
+	if(header->capacity < width*height*4)
+		return false;
+
+	m_Width = width;
+	m_Height = height;
+
+	return true;
+
+} // end ResizeSenderMemory
+
+
+// Bytes to allocate for an image, at least the size set by SetSenderMemoryCapacity.
+// Otherwise the next of four size classes between powers of two,
+// so that less than a quarter of the image size is unused.
+unsigned int spoutMemoryShare::GetCapacity(unsigned int width, unsigned int height)
+{
+	unsigned int size = width*height*4;
+
+	if(m_MaxCapacity >= size)
+		return m_MaxCapacity;
+
+	if(size <= SPOUT_MEMORY_MIN_CAPACITY)
+		return SPOUT_MEMORY_MIN_CAPACITY;
+
+	unsigned int step = SPOUT_MEMORY_MIN_CAPACITY/4;
+	while(step*8 <= size)
+		step *= 2;
+
+	return ((size + step - 1)/step)*step;
+
+} // end GetCapacity
+
+
+// The header of the open map or ring
+SpoutMemoryHeader * spoutMemoryShare::GetHeader()
+{
+	if(!senderMem) return NULL;
+	if(m_bRing) return (SpoutMemoryHeader *)senderMem->GetBuffer();
+	if(m_bHeader && headerMem) return (SpoutMemoryHeader *)headerMem->GetBuffer();
+	return NULL;
+}
+
+
+// SENDER : Create the header map of the single buffer map, or attach to an existing one.
+// Only this version uses it, so the lock can be in the map, but the header
+// is written and read with the image map locked instead.
+SpoutCreateResult spoutMemoryShare::CreateHeaderMap(const char *sendername)
+{
+	string namestring = sendername;
+	namestring += "_header";
+
+	CloseHeaderMap();
+	headerMem = new SpoutSharedMemory();
+	SpoutCreateResult result = headerMem->Create(namestring.c_str(), SPOUT_MEMORY_HEADER_SIZE, true);
+	if(result == SPOUT_CREATE_FAILED) {
+		delete headerMem;
+		headerMem = NULL;
+	}
+
+	return result;
+
+} // end CreateHeaderMap
+
+
+// RECEIVER : Attach to the header map of a sender.
+// Returns false for a sender of an earlier version that has none.
+bool spoutMemoryShare::OpenHeaderMap(const char *sendername)
+{
+	string namestring = sendername;
+	namestring += "_header";
+
+	CloseHeaderMap();
+	headerMem = new SpoutSharedMemory();
+	if(!headerMem->Open(namestring.c_str(), true)) {
+		CloseHeaderMap();
+		return false;
+	}
+
+	SpoutMemoryHeader *header = (SpoutMemoryHeader *)headerMem->GetBuffer();
+	if(!header || header->magic != SPOUT_MEMORY_MAGIC) {
+		CloseHeaderMap();
+		return false;
+	}
+	m_bHeader = true;
+
+	return true;
+
+} // end OpenHeaderMap
+
+
+void spoutMemoryShare::CloseHeaderMap()
+{
+	if(headerMem) delete headerMem;
+	headerMem = NULL;
+	m_bHeader = false;
+}
+
+
+// SENDER : Initialize a new header
+void spoutMemoryShare::SetHeader(SpoutMemoryHeader *header, unsigned int width, unsigned int height, unsigned int capacity)
+{
+	header->magic = SPOUT_MEMORY_MAGIC;
+	header->version = SPOUT_MEMORY_VERSION;
+	header->width = width;
+	header->height = height;
+	header->format = 0x1908; // GL_RGBA
+	header->pitch = width*4;
+	header->capacity = capacity;
+	header->frame = 0;
+	header->timestamp = 0;
+}
+
+
+// SENDER : Record a new frame, with the frame number given or the next
+void spoutMemoryShare::WriteHeader(SpoutMemoryHeader *header, long frame)
+{
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	header->timestamp = (unsigned __int64)count.QuadPart;
+	if(frame > 0)
+		InterlockedExchange(&header->frame, (LONG)frame);
+	else
+		InterlockedIncrement(&header->frame);
+}
+
+
+// =======================================================
+//                  Ring of image buffers
+// =======================================================
+
+void spoutMemoryShare::SetRingSlots(unsigned int nSlots)
+{
+	if(nSlots > SPOUT_RING_MAX_SLOTS) nSlots = SPOUT_RING_MAX_SLOTS;
+	// A receiver must be able to hold the latest frame and the one
+	// before it while the sender writes another
+	if(nSlots > 0 && nSlots < 3) nSlots = 3;
+	m_RingSlots = nSlots;
+}
+
+
+unsigned int spoutMemoryShare::GetRingSlots()
+{
+	return m_RingSlots;
+}
+
+
+bool spoutMemoryShare::IsRing()
+{
+	return m_bRing;
+}
+
+
+SpoutMemoryRingHeader * spoutMemoryShare::GetRingHeader()
+{
+	if(!m_bRing || !senderMem) return NULL;
+	return (SpoutMemoryRingHeader *)senderMem->GetBuffer();
+}
+
+
+// SENDER : Create a ring memory map or re-use the existing one.
+// A map that is still open by receivers keeps the size it was created with,
+// so fail if that is too small and try again with the next frame.
+bool spoutMemoryShare::CreateSenderRing(const char *sendername, unsigned int width, unsigned int height)
+{
+	string namestring = sendername;
+	namestring += "_ring";
+
+	// For BeginWrite to try again if this fails
+	if(sendername != m_SenderName)
+		strcpy_s(m_SenderName, 256, sendername);
+	m_Width = width;
+	m_Height = height;
+
+	EndWrite(false);
+	if(senderMem) delete senderMem;
+	CloseHeaderMap();
+	senderMem = new SpoutSharedMemory();
+	senderMem->SetLockStats(m_pLockStats);
+	m_bRing = false;
+
+	unsigned int slotSize = ((GetCapacity(width, height) + 63)/64)*64; // cache line aligned slots
+	// Only this version uses the ring, so the lock can be in the map
+	SpoutCreateResult result = senderMem->Create(namestring.c_str(), SPOUT_RING_HEADER_SIZE + m_RingSlots*slotSize, true);
+	if(result == SPOUT_CREATE_FAILED) {
+		delete senderMem;
+		senderMem = NULL;
+		return false;
+	}
+
+	SpoutMemoryRingHeader *header = (SpoutMemoryRingHeader *)senderMem->Lock();
+	if(!header) {
+		delete senderMem;
+		senderMem = NULL;
+		return false;
+	}
+
+	if(result == SPOUT_ALREADY_EXISTS && header->info.magic == SPOUT_MEMORY_MAGIC) {
+		if(header->info.capacity < width*height*4) {
+			printf("spoutMemoryShare::CreateSenderRing - existing ring is too small\n");
+			senderMem->Unlock();
+			delete senderMem;
+			senderMem = NULL;
+			return false;
+		}
+		// Keep the slots and reader counts of the existing ring
+	}
+	else {
+		SetHeader(&header->info, width, height, slotSize);
+		header->slots = m_RingSlots;
+		for(int i = 0; i < SPOUT_RING_MAX_SLOTS; i++) {
+			header->readers[i] = 0;
+			header->frames[i] = 0;
+		}
+	}
+	header->info.width = width;
+	header->info.height = height;
+	header->info.pitch = width*4;
+	InterlockedExchange(&header->latest, -1);
+
+	senderMem->Unlock();
+
+	for(int i = 0; i < SPOUT_RING_MAX_SLOTS; i++)
+		m_SlotBusyTime[i] = 0;
+	m_bRing = true;
+
+	return true;
+
+} // end CreateSenderRing
+
+
+// RECEIVER : Attach to the ring memory map of a sender
+bool spoutMemoryShare::OpenSenderRing(const char *sendername)
+{
+	string namestring = sendername;
+	namestring += "_ring";
+
+	SpoutSharedMemory *ringMem = new SpoutSharedMemory();
+	ringMem->SetLockStats(m_pLockStats);
+	if(!ringMem->Open(namestring.c_str(), true)) {
+		delete ringMem;
+		return false;
+	}
+
+	SpoutMemoryRingHeader *header = (SpoutMemoryRingHeader *)ringMem->GetBuffer();
+	if(!header || header->info.magic != SPOUT_MEMORY_MAGIC
+		|| header->slots == 0 || header->slots > SPOUT_RING_MAX_SLOTS) {
+		delete ringMem;
+		return false;
+	}
+
+	EndRead();
+	if(senderMem) delete senderMem;
+	CloseHeaderMap();
+	senderMem = ringMem;
+	m_bRing = true;
+	if(sendername != m_SenderName)
+		strcpy_s(m_SenderName, 256, sendername);
+
+	return true;
+
+} // end OpenSenderRing
+
+
+//
+// SENDER : Get a buffer for the next frame
+//
+// A ring slot is free if it is not the latest frame and no receiver is reading it.
+// The reader count is checked after the previous frame was published with an
+// interlocked exchange, and a receiver checks the latest frame again after
+// incrementing the count, so they cannot both miss the other.
+// Returns NULL if every other slot is held, and the frame is skipped.
+//
+unsigned char * spoutMemoryShare::BeginWrite()
+{
+	EndWrite(false);
+
+	if(!m_bRing) {
+		// Create the ring again if it failed at a new size
+		if(m_RingSlots > 0 && m_SenderName[0]) {
+			if(!CreateSenderRing(m_SenderName, m_Width, m_Height))
+				return NULL;
+		}
+		else {
+			unsigned char *pBuffer = LockSenderMemory();
+			if(!pBuffer) return NULL;
+			SpoutMemoryHeader *header = GetHeader();
+			if(header) {
+				if(header->capacity < m_Width*m_Height*4) {
+					UnlockSenderMemory();
+					return NULL;
+				}
+				header->width = m_Width;
+				header->height = m_Height;
+				header->pitch = m_Width*4;
+			}
+			m_WriteSlot = 0;
+			return pBuffer;
+		}
+	}
+
+	SpoutMemoryRingHeader *header = GetRingHeader();
+	if(!header) return NULL;
+
+	unsigned int nSlots = header->slots;
+	LONG latest = header->latest;
+	DWORD dwTime = GetTickCount();
+
+	// Time how long each slot has been held by receivers
+	for(unsigned int i = 0; i < nSlots; i++) {
+		if((header->readers[i] & SPOUT_RING_READER_MASK) == 0)
+			m_SlotBusyTime[i] = 0;
+		else if(m_SlotBusyTime[i] == 0)
+			m_SlotBusyTime[i] = dwTime | 1; // zero is not held
+	}
+
+	for(unsigned int i = 1; i <= nSlots; i++) {
+		unsigned int slot = (unsigned int)(latest + i) % nSlots;
+		if((LONG)slot == latest)
+			continue;
+		if(m_SlotBusyTime[slot] == 0) {
+			m_WriteSlot = (int)slot;
+			break;
+		}
+	}
+
+	// Every other slot is held. A receiver that has held one for too long
+	// has probably stopped, so take it back. The reader count is cleared
+	// and the epoch incremented, so the receiver cannot release it later.
+	if(m_WriteSlot < 0) {
+		for(unsigned int i = 0; i < nSlots; i++) {
+			if((LONG)i != latest && m_SlotBusyTime[i] != 0
+			 && (LONG)(dwTime - m_SlotBusyTime[i]) > SPOUT_RING_TIMEOUT) {
+				LONG readers = header->readers[i];
+				for(;;) {
+					LONG epoch = (LONG)((unsigned __int32)(readers & ~SPOUT_RING_READER_MASK) + SPOUT_RING_EPOCH_ONE);
+					LONG previous = InterlockedCompareExchange(&header->readers[i], epoch, readers);
+					if(previous == readers) break;
+					readers = previous;
+				}
+				m_SlotBusyTime[i] = 0;
+				m_WriteSlot = (int)i;
+				break;
+			}
+		}
+	}
+
+	if(m_WriteSlot < 0)
+		return NULL;
+
+	return (unsigned char *)header + SPOUT_RING_HEADER_SIZE + (size_t)m_WriteSlot*header->info.capacity;
+
+} // end BeginWrite
+
+
+// SENDER : Publish the frame as the latest
+// The frame number is that of the sender info map (SetFrameReady) for
+// the frame, so that receivers have one count, or zero to count here.
+void spoutMemoryShare::EndWrite(bool bPublish, long frame)
+{
+	if(!m_bRing) {
+		// Single buffer locked by BeginWrite
+		if(m_WriteSlot >= 0) {
+			SpoutMemoryHeader *header = GetHeader();
+			if(header && bPublish)
+				WriteHeader(header, frame);
+			UnlockSenderMemory();
+		}
+		m_WriteSlot = -1;
+		return;
+	}
+
+	// The slot keeps its frame number for receivers that hold it
+	// while the sender goes on to the next frames
+	SpoutMemoryRingHeader *header = GetRingHeader();
+	if(header && m_WriteSlot >= 0 && bPublish) {
+		header->frames[m_WriteSlot] = frame > 0 ? (LONG)frame : header->info.frame + 1;
+		InterlockedExchange(&header->latest, (LONG)m_WriteSlot);
+		WriteHeader(&header->info, header->frames[m_WriteSlot]);
+	}
+	m_WriteSlot = -1;
+
+} // end EndWrite
+
+
+//
+// RECEIVER : Get the buffer of the latest frame
+//
+// The slot is held by incrementing its reader count, then checked to still be
+// the latest, otherwise the sender may already have started to write it.
+// The take-back epoch of the slot is kept to release it.
+// Returns NULL if there is no frame yet or the image is not the expected size.
+//
+unsigned char * spoutMemoryShare::BeginRead()
+{
+	EndRead();
+
+	if(!m_bRing) {
+		unsigned char *pBuffer = LockSenderMemory();
+		if(!pBuffer) return NULL;
+		// The sender has changed size
+		SpoutMemoryHeader *header = GetHeader();
+		if(header && (header->width != m_Width || header->height != m_Height)) {
+			UnlockSenderMemory();
+			return NULL;
+		}
+		m_ReadSlot = 0;
+		m_ReadFrame = header ? header->frame : 0; // the map is locked
+		return pBuffer;
+	}
+
+	SpoutMemoryRingHeader *header = GetRingHeader();
+	if(!header) return NULL;
+
+	for(int i = 0; i < 100; i++) {
+		LONG slot = header->latest;
+		if(slot < 0 || slot >= (LONG)header->slots)
+			return NULL;
+		LONG epoch = InterlockedIncrement(&header->readers[slot]) & ~SPOUT_RING_READER_MASK;
+		if(header->latest == slot) {
+			if(header->info.width != m_Width || header->info.height != m_Height) {
+				ReleaseRingSlot((int)slot, epoch);
+				return NULL;
+			}
+			m_ReadSlot = (int)slot;
+			m_ReadEpoch = epoch;
+			m_ReadFrame = header->frames[slot];
+			return (unsigned char *)header + SPOUT_RING_HEADER_SIZE + (size_t)slot*header->info.capacity;
+		}
+		ReleaseRingSlot((int)slot, epoch);
+	}
+
+	return NULL;
+
+} // end BeginRead
+
+
+void spoutMemoryShare::EndRead()
+{
+	if(!m_bRing) {
+		// Single buffer locked by BeginRead
+		if(m_ReadSlot >= 0) UnlockSenderMemory();
+		m_ReadSlot = -1;
+		m_ReadFrame = 0;
+		return;
+	}
+
+	if(m_ReadSlot >= 0)
+		ReleaseRingSlot(m_ReadSlot, m_ReadEpoch);
+	m_ReadSlot = -1;
+	m_ReadFrame = 0;
+
+} // end EndRead
+
+
+// RECEIVER : Frame number of the buffer held by BeginRead.
+// Zero if there is none or the map is from an earlier version.
+long spoutMemoryShare::GetReadFrame()
+{
+	return m_ReadFrame;
+}
+
+
+// SENDER : Name of the sender of the map created, empty if none
+const char * spoutMemoryShare::GetSenderName()
+{
+	return m_SenderName;
+}
+
+
+// RECEIVER : Decrement the reader count of a slot held at the epoch given.
+// If the sender has taken the slot back since, the count belongs to
+// other receivers and is left as it is. It never goes below zero.
+void spoutMemoryShare::ReleaseRingSlot(int slot, LONG epoch)
+{
+	SpoutMemoryRingHeader *header = GetRingHeader();
+	if(!header) return;
+
+	LONG readers = header->readers[slot];
+	while((readers & ~SPOUT_RING_READER_MASK) == epoch && (readers & SPOUT_RING_READER_MASK) > 0) {
+		LONG previous = InterlockedCompareExchange(&header->readers[slot], readers - 1, readers);
+		if(previous == readers) break;
+		readers = previous;
+	}
+
+} // end ReleaseRingSlot
@@ -44,6 +44,70 @@
 
 using namespace std;
 
+//
+// Binary header of a sender memory map
+//
+// Receivers find the image size and format from the header and do not
+// have to look up the sender in the sender names map for each frame.
+// The single buffer map "<sendername>_map" keeps the layout of earlier
+// versions with the image at zero, so that their receivers can still
+// read it, and the header is in a separate map "<sendername>_header".
+// Senders of earlier versions have no header map.
+//
+#define SPOUT_MEMORY_MAGIC 0x534D5053 // "SPMS"
+#define SPOUT_MEMORY_VERSION 1
+#define SPOUT_MEMORY_HEADER_SIZE 64 // size of the header map
+
+//
+// Capacity of a sender memory map
+//
+// Maps are created larger than the image, rounded up to the next of four
+// size classes between powers of two, or to a maximum size set by the
+// sender. A change of size within the capacity only changes the header,
+// so the sender and receivers keep the same map.
+//
+#define SPOUT_MEMORY_MIN_CAPACITY 65536 // bytes
+
+struct SpoutMemoryHeader {
+	unsigned __int32 magic;     // SPOUT_MEMORY_MAGIC
+	unsigned __int32 version;   // SPOUT_MEMORY_VERSION
+	unsigned __int32 width;     // image size
+	unsigned __int32 height;
+	unsigned __int32 format;    // GL format of the image, GL_RGBA
+	unsigned __int32 pitch;     // bytes per line
+	unsigned __int32 capacity;  // bytes available for each image
+	volatile LONG frame;        // number of frames written
+	volatile unsigned __int64 timestamp; // QueryPerformanceCounter when the last frame was written
+};
+
+//
+// Ring of image buffers in one memory map "<sendername>_ring"
+//
+// The sender writes a slot that no receiver is reading and publishes
+// its index as the latest frame. Receivers copy the latest slot and
+// hold it with a reader count instead of the mutex, so neither has to
+// wait for the other. Receivers of earlier versions only use "_map".
+//
+#define SPOUT_RING_SLOTS 3 // default number of slots
+#define SPOUT_RING_MAX_SLOTS 8
+#define SPOUT_RING_HEADER_SIZE 256 // slots start after the header
+#define SPOUT_RING_TIMEOUT 1000 // msec before a slot held by a receiver is taken back
+
+// The reader count of a slot is in the low 16 bits and the upper bits
+// count the times the sender has taken the slot back. A receiver
+// releases its hold only if the slot has not been taken back since,
+// so that it cannot release the hold of another receiver.
+#define SPOUT_RING_READER_MASK 0xFFFF
+#define SPOUT_RING_EPOCH_ONE 0x10000
+
+struct SpoutMemoryRingHeader {
+	SpoutMemoryHeader info;    // capacity is the size of each slot
+	unsigned __int32 slots;    // number of slots
+	volatile LONG latest;      // latest complete slot, -1 before the first frame
+	volatile LONG readers[SPOUT_RING_MAX_SLOTS]; // take-back epoch and receivers reading each slot
+	volatile LONG frames[SPOUT_RING_MAX_SLOTS];  // frame number of the image in each slot
+};
+
 class SPOUT_DLLEXP spoutMemoryShare {
 
 	public:
@@ -57,22 +121,79 @@ class SPOUT_DLLEXP spoutMemoryShare {
 		bool OpenSenderMemory (const char *sendername);
 		void CloseSenderMemory ();
 
+		// SENDER : maximum image size for a new sender memory map,
+		// 0 to round the size up to the next size class (default)
+		void SetSenderMemoryCapacity(unsigned int width, unsigned int height);
+		unsigned int GetSenderMemoryCapacity(); // bytes for the image of the open map
+
+		// Count the waits for the map mutex, or NULL not to
+		void SetLockStats(SpoutLockStats *pStats);
+
 		// Retrieve global width and height
 		bool GetSenderMemorySize(unsigned int &width, unsigned int &height);
 
+		// Copy of the header of the open map
+		bool GetSenderMemoryHeader(SpoutMemoryHeader &header);
+
 		// Lock and unlock memory and retrieve buffer pointer
 		unsigned char * LockSenderMemory();
 		void UnlockSenderMemory();
 
+		// SENDER : number of ring slots for a new sender memory map,
+		// 0 for a single buffer compatible with earlier versions (default)
+		void SetRingSlots(unsigned int nSlots = SPOUT_RING_SLOTS);
+		unsigned int GetRingSlots();
+		bool IsRing(); // the open map is a ring
+
+		// SENDER : buffer for the next frame, published by EndWrite
+		// with the frame number of the sender info map, or zero to count
+		// the frames of the memory map
+		unsigned char * BeginWrite();
+		void EndWrite(bool bPublish = true, long frame = 0);
+		const char * GetSenderName(); // name of the map created
+
+		// RECEIVER : buffer of the latest frame, held until EndRead
+		unsigned char * BeginRead();
+		void EndRead();
+		long GetReadFrame(); // frame number of the buffer held, 0 if unknown
+
 		// Close and release memory object
 		void ReleaseSenderMemory ();
 
 protected:
 
 		SpoutSharedMemory *senderMem;
+		SpoutSharedMemory *headerMem; // "<sendername>_header" of the single buffer map
+		SpoutLockStats *m_pLockStats;
 		unsigned int m_Width;
 		unsigned int m_Height;
 
+		bool CreateSenderMap(const char *sendername, unsigned int width, unsigned int height);
+		bool ResizeSenderMemory(const char *sendername, unsigned int width, unsigned int height);
+		unsigned int GetCapacity(unsigned int width, unsigned int height);
+		SpoutMemoryHeader * GetHeader();
+		void SetHeader(SpoutMemoryHeader *header, unsigned int width, unsigned int height, unsigned int capacity);
+		void WriteHeader(SpoutMemoryHeader *header, long frame);
+		SpoutCreateResult CreateHeaderMap(const char *sendername);
+		bool OpenHeaderMap(const char *sendername);
+		void CloseHeaderMap();
+
+		bool CreateSenderRing(const char *sendername, unsigned int width, unsigned int height);
+		bool OpenSenderRing(const char *sendername);
+		SpoutMemoryRingHeader * GetRingHeader();
+		void ReleaseRingSlot(int slot, LONG epoch);
+
+		unsigned int m_RingSlots; // slots for a new ring
+		unsigned int m_MaxCapacity; // bytes for the image of a new map, or 0 for size classes
+		char m_SenderName[256]; // name of the open map, and to create the ring again
+		bool m_bRing; // senderMem is a ring
+		bool m_bHeader; // headerMem is open with a SpoutMemoryHeader
+		int m_WriteSlot; // slot being written, 0 for the single buffer locked, or -1
+		int m_ReadSlot; // slot being read, 0 for the single buffer locked, or -1
+		LONG m_ReadEpoch; // take-back epoch of the slot when it was held
+		long m_ReadFrame; // frame number of the buffer held by BeginRead
+		DWORD m_SlotBusyTime[SPOUT_RING_MAX_SLOTS]; // when the sender found a slot held
+
 };
 
 #endif
@@ -26,6 +26,12 @@
 //		13.01.17	- Add SetCPUmode, GetCPUmode, SetBufferMode, GetBufferMode
 //					- Add HostFBO arg to DrawSharedTexture
 //		15.01.17	- Add GetShareMode, SetShareMode
+//		16.10.26	- Add WaitFrameReady
+//					- Add SetSkipUnchanged, GetSkipUnchanged, IsFrameNew, GetSenderFrame,
+//					  GetDroppedFrames and GetDuplicateFrames
+//					- Add BorrowReceiveBuffer, ReleaseReceiveBuffer
+//					- Add EnumerateSenders, SetSenderReaper
+//					- Add CheckSenderListChanged, WaitSenderListChanged, SetSenderListCallback
 //
 // ====================================================================================
 /*
@@ -87,6 +93,20 @@ bool SpoutReceiver::ReceiveImage(char* Sendername,
 }
 
 
+//---------------------------------------------------------
+bool SpoutReceiver::BorrowReceiveBuffer(char* Sendername, unsigned int &width, unsigned int &height, const unsigned char* &pBuffer, unsigned int &pitch, GLenum &glFormat, long &frame)
+{
+	return spout.BorrowReceiveBuffer(Sendername, width, height, pBuffer, pitch, glFormat, frame);
+}
+
+
+//---------------------------------------------------------
+void SpoutReceiver::ReleaseReceiveBuffer()
+{
+	spout.ReleaseReceiveBuffer();
+}
+
+
 //---------------------------------------------------------
 bool SpoutReceiver::CheckReceiver(char* name, unsigned int &width, unsigned int &height, bool &bConnected)
 {
@@ -113,6 +133,50 @@ void SpoutReceiver::ReleaseReceiver()
 }
 
 
+//---------------------------------------------------------
+bool SpoutReceiver::WaitFrameReady(DWORD dwTimeout)
+{
+	return spout.WaitFrameReady(dwTimeout);
+}
+
+
+//---------------------------------------------------------
+void SpoutReceiver::SetSkipUnchanged(bool bSkip)
+{
+	spout.SetSkipUnchanged(bSkip);
+}
+
+//---------------------------------------------------------
+bool SpoutReceiver::GetSkipUnchanged()
+{
+	return spout.GetSkipUnchanged();
+}
+
+//---------------------------------------------------------
+bool SpoutReceiver::IsFrameNew()
+{
+	return spout.IsFrameNew();
+}
+
+//---------------------------------------------------------
+long SpoutReceiver::GetSenderFrame()
+{
+	return spout.GetSenderFrame();
+}
+
+//---------------------------------------------------------
+long SpoutReceiver::GetDroppedFrames()
+{
+	return spout.GetDroppedFrames();
+}
+
+//---------------------------------------------------------
+long SpoutReceiver::GetDuplicateFrames()
+{
+	return spout.GetDuplicateFrames();
+}
+
+
 //---------------------------------------------------------
 bool SpoutReceiver::BindSharedTexture()
 {
@@ -146,6 +210,36 @@ bool SpoutReceiver::GetSenderName(int index, char* sendername, int MaxNameSize)
 	return spout.GetSenderName(index, sendername, MaxNameSize);
 }
 
+//---------------------------------------------------------
+int SpoutReceiver::EnumerateSenders(SpoutSenderDetails *senders, int maxSenders)
+{
+	return spout.EnumerateSenders(senders, maxSenders);
+}
+
+//---------------------------------------------------------
+void SpoutReceiver::SetSenderReaper(DWORD dwInterval)
+{
+	spout.SetSenderReaper(dwInterval);
+}
+
+//---------------------------------------------------------
+bool SpoutReceiver::CheckSenderListChanged()
+{
+	return spout.CheckSenderListChanged();
+}
+
+//---------------------------------------------------------
+bool SpoutReceiver::WaitSenderListChanged(DWORD dwTimeout)
+{
+	return spout.WaitSenderListChanged(dwTimeout);
+}
+
+//---------------------------------------------------------
+void SpoutReceiver::SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData)
+{
+	spout.SetSenderListCallback(pCallback, pUserData);
+}
+
 //---------------------------------------------------------
 bool SpoutReceiver::GetActiveSender(char* Sendername)
 {
@@ -42,9 +42,19 @@ class SPOUT_DLLEXP SpoutReceiver {
 	bool CreateReceiver(char* Sendername, unsigned int &width, unsigned int &height, bool bUseActive = false);
 	bool ReceiveTexture(char* Sendername, unsigned int &width, unsigned int &height, GLuint TextureID = 0, GLuint TextureTarget = 0, bool bInvert = false, GLuint HostFBO = 0);
 	bool ReceiveImage(char* Sendername, unsigned int &width, unsigned int &height, unsigned char* pixels, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO=0);
+	bool BorrowReceiveBuffer(char* Sendername, unsigned int &width, unsigned int &height, const unsigned char* &pBuffer, unsigned int &pitch, GLenum &glFormat, long &frame);
+	void ReleaseReceiveBuffer();
 	bool CheckReceiver (char* Sendername, unsigned int &width, unsigned int &height, bool &bConnected);
 	bool GetImageSize  (char* Sendername, unsigned int &width, unsigned int &height, bool &bMemoryMode);
 	void ReleaseReceiver(); 
+	bool WaitFrameReady(DWORD dwTimeout = 0);
+
+	void SetSkipUnchanged(bool bSkip = true);
+	bool GetSkipUnchanged();
+	bool IsFrameNew();
+	long GetSenderFrame();
+	long GetDroppedFrames();
+	long GetDuplicateFrames();
 
 	bool BindSharedTexture();
 	bool UnBindSharedTexture();
@@ -52,6 +62,11 @@ class SPOUT_DLLEXP SpoutReceiver {
 	
 	int  GetSenderCount();
 	bool GetSenderName(int index, char* Sendername, int MaxSize = 256);
+	int  EnumerateSenders(SpoutSenderDetails *senders, int maxSenders);
+	void SetSenderReaper(DWORD dwInterval);
+	bool CheckSenderListChanged();
+	bool WaitSenderListChanged(DWORD dwTimeout);
+	void SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData = NULL);
 	bool GetSenderInfo(const char* Sendername, unsigned int &width, unsigned int &height, HANDLE &dxShareHandle, DWORD &dwFormat);
 
 	bool GetActiveSender(char* Sendername);
@@ -109,6 +109,24 @@
 //					  https://github.com/leadedge/Spout2/issues/24
 //					  temporary changes to allow selection of a sender 
 //					  when a name is provided for CreateReceiver
+//		16.10.26	- SendImage and ReceiveImage accept yuv formats (SPOUT_YUV_NV12 etc.)
+//					- SendImage and ReceiveImage accept GL_RGBA16, GL_RGBA16F and GL_RGB10_A2
+//					- SendTexture, SendImage and DrawToSharedTexture signal a new frame
+//					- Added WaitFrameReady for receivers to wait for a new frame
+//					- Added SetSkipUnchanged so that ReceiveTexture and ReceiveImage do not copy
+//					  a frame already received. IsFrameNew, GetSenderFrame, GetDroppedFrames
+//					  and GetDuplicateFrames from the sender frame count.
+//					- Added AcquireSendBuffer and CommitSendBuffer for senders to write
+//					  pixels directly to shared memory or the staging texture
+//					- Added BorrowReceiveBuffer and ReleaseReceiveBuffer for receivers to read
+//					  pixels directly from shared memory or the staging texture
+//					- Added SetLockStats, GetLockStats and ResetLockStats to count
+//					  the waits for each type of lock
+//					- Added EnumerateSenders for the names and info of all senders at once
+//					- Added line pitch argument to SendImage for padded lines
+//					- Added SetSenderReaper to release the names of senders that have exited
+//					- Added CheckSenderListChanged, WaitSenderListChanged and SetSenderListCallback
+//					  so that a sender list can be read again only when it has changed
 //
 // ================================================================
 /*
@@ -154,6 +172,10 @@ Spout::Spout()
 	g_Height              = 0;
 	g_ShareHandle         = 0;
 	g_Format              = 0;
+	g_FrameCount          = 0;
+	g_DroppedFrames       = 0;
+	g_DuplicateFrames     = 0;
+	g_SenderListGeneration = -1;    // changed at the first check
 	g_TexID               = 0;
 	g_hWnd                = NULL;   // handle to render window
 	g_SharedMemoryName[0] = 0;      // No name to start 
@@ -168,6 +190,10 @@ Spout::Spout()
 	bUseActive            = false;  // Use the active sender for CreateReceiver
 	
 	bSpoutPanelOpened     = false;  // Selection panel "spoutpanel.exe" opened
+	bSkipUnchanged        = false;  // Copy every frame as for earlier versions
+	bFrameNew             = false;  // No frame received yet
+	bLockStats            = false;  // Do not count lock waits
+	ZeroMemory(g_LockStats, sizeof(g_LockStats));
 	bSpoutPanelActive     = false;  // The SpoutPanel window has been activated
 	ZeroMemory(&m_ShExecInfo, sizeof(m_ShExecInfo));
 
@@ -328,8 +354,14 @@ bool Spout::SendTexture(GLuint TextureID, GLuint TextureTarget, unsigned int wid
 	// (the application resets the size of any texture that is being sent out)
 	if(width != g_Width || height != g_Height) 
 		return(UpdateSender(g_SharedMemoryName, width, height));
-	else
-		return(interop.WriteTexture(TextureID, TextureTarget, width, height, bInvert, HostFBO));
+
+	if(!interop.WriteTexture(TextureID, TextureTarget, width, height, bInvert, HostFBO))
+		return false;
+
+	// Wake receivers waiting for a new frame
+	interop.senders.SetFrameReady(g_SharedMemoryName);
+
+	return true;
 
 } // end SendTexture
 
@@ -341,7 +373,8 @@ bool Spout::SendImage(const unsigned char* pixels,
 					  unsigned int height, 
 					  GLenum glFormat, 
 					  bool bInvert,
-					  GLuint HostFBO)
+					  GLuint HostFBO,
+					  unsigned int pitch)
 {
 	// bool bResult = true;
 	GLenum glformat = glFormat;
@@ -352,8 +385,9 @@ bool Spout::SendImage(const unsigned char* pixels,
 	if(width != g_Width || height != g_Height)
 		return(UpdateSender(g_SharedMemoryName, width, height));
 
-	// Only RGBA, BGRA, RGB, BGR supported
-	if(!(glformat == GL_RGBA || glFormat == 0x80E1 || glformat == GL_RGB || glFormat == 0x80E0))
+	// Only RGBA, BGRA, RGB, BGR, yuv and high bit depth supported
+	if(!(glformat == GL_RGBA || glFormat == 0x80E1 || glformat == GL_RGB || glFormat == 0x80E0
+		|| interop.spoutcopy.IsYUVformat(glFormat) || interop.spoutcopy.IsHighBitDepth(glFormat)))
 		return false;
 
 	// Check for BGRA support
@@ -365,11 +399,50 @@ bool Spout::SendImage(const unsigned char* pixels,
 	}
 
 	// Write the pixel data to the rgba shared texture from the user pixel format
-	return(interop.WriteTexturePixels(pixels, width, height, glformat, bInvert, HostFBO));
+	if(!interop.WriteTexturePixels(pixels, width, height, glformat, bInvert, HostFBO, pitch))
+		return false;
+
+	interop.senders.SetFrameReady(g_SharedMemoryName);
+
+	return true;
 
 } // end SendImage
 
 
+//
+// AcquireSendBuffer
+//
+// Returns a buffer for the next frame of the sender, the bytes per line and
+// the pixel format, GL_RGBA or GL_BGRA_EXT. The sender writes the pixels and
+// passes the frame on with CommitSendBuffer, without the copy of SendImage.
+// Only memoryshare and DirectX 11 CPU modes have a buffer. For other modes,
+// or if the frame cannot be written, NULL is returned and SendImage can be used.
+//
+unsigned char * Spout::AcquireSendBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat)
+{
+	// width, g_Width should all be the same
+	if(width != g_Width || height != g_Height) {
+		if(!UpdateSender(g_SharedMemoryName, width, height))
+			return NULL;
+	}
+
+	return interop.AcquireWriteBuffer(width, height, pitch, glFormat);
+
+} // end AcquireSendBuffer
+
+
+bool Spout::CommitSendBuffer(bool bPublish)
+{
+	if(!interop.CommitWriteBuffer(bPublish))
+		return false;
+
+	interop.senders.SetFrameReady(g_SharedMemoryName);
+
+	return true;
+
+} // end CommitSendBuffer
+
+
 //
 // ReceiveTexture
 //
@@ -414,17 +487,24 @@ bool Spout::ReceiveTexture(char* name,
 	width  = g_Width;
 	height = g_Height;
 
+	// The frame has already been received
+	long frame = 0;
+	if(!CheckFrameCount(frame))
+		return true;
+
 	if(TextureID > 0 && TextureTarget > 0) {
 		// If a valid texture was passed, read the shared texture into it.
 		// Otherwise skip it. All the other checks for name and size are already done.
-		return(interop.ReadTexture(TextureID, TextureTarget, g_Width, g_Height, bInvert, HostFBO));
-	}
-	else {
-		// Just depend on the shared texture being updated and don't return one
-		// e.g. can use DrawSharedTexture to use the shared texture directly
-		// ReceiveTexture still does all the check for sender presence and size change etc.
-		return true;
+		if(!interop.ReadTexture(TextureID, TextureTarget, g_Width, g_Height, bInvert, HostFBO))
+			return false;
 	}
+	// Otherwise just depend on the shared texture being updated and don't return one
+	// e.g. can use DrawSharedTexture to use the shared texture directly
+	// ReceiveTexture still does all the check for sender presence and size change etc.
+
+	CommitFrameCount(frame);
+
+	return true;
 
 } // end ReceiveTexture
 
@@ -443,8 +523,9 @@ bool Spout::ReceiveImage(char* name,
 
 	// printf("Spout::ReceiveImage (%dx%d) - format = %x\n", width, height, glFormat);
 
-	// Only RGBA, BGRA, RGB and BGR supported
-	if(!(glformat == GL_RGBA || glFormat == 0x80E1  || glFormat == GL_RGB || glFormat == 0x80E0))
+	// Only RGBA, BGRA, RGB, BGR, yuv and high bit depth supported
+	if(!(glformat == GL_RGBA || glFormat == 0x80E1  || glFormat == GL_RGB || glFormat == 0x80E0
+		|| interop.spoutcopy.IsYUVformat(glFormat) || interop.spoutcopy.IsHighBitDepth(glFormat)))
 		return false;
 
 	// Check for BGRA support
@@ -464,13 +545,87 @@ bool Spout::ReceiveImage(char* name,
 	width  = g_Width;
 	height = g_Height;
 
+	// The frame has already been received
+	long frame = 0;
+	if(!CheckFrameCount(frame))
+		return true;
+
 	// Read the shared texture into the pixel buffer
 	// Functions handle the formats supported
-	return(interop.ReadTexturePixels(pixels, width, height, glformat, bInvert, HostFBO));
+	if(!interop.ReadTexturePixels(pixels, width, height, glformat, bInvert, HostFBO))
+		return false;
+
+	CommitFrameCount(frame);
+
+	return true;
 
 }  // end ReceiveImage
 
 
+//
+// BorrowReceiveBuffer
+//
+// Connects and checks for a sender change as ReceiveImage does, then returns
+// the latest frame in place in pBuffer, with the bytes per line, the pixel
+// format, GL_RGBA or GL_BGRA_EXT, and the sender frame number. The frame is
+// held until ReleaseReceiveBuffer and must not be written.
+//
+// Returns false with pBuffer NULL if there is no sender or the sender has
+// changed, if there is no frame yet, for a frame already received if
+// SetSkipUnchanged is on (IsFrameNew is then false), and for modes other
+// than memoryshare and DirectX 11 CPU which have no buffer.
+//
+bool Spout::BorrowReceiveBuffer(char* name, 
+								unsigned int &width, 
+								unsigned int &height, 
+								const unsigned char* &pBuffer, 
+								unsigned int &pitch, 
+								GLenum &glFormat, 
+								long &frame)
+{
+	bool bConnected = true;
+
+	ReleaseReceiveBuffer();
+	pBuffer = NULL;
+
+	// Test for sender change and user selection
+	if(!CheckReceiver(name, width, height, bConnected))
+		return false;
+
+	// globals are all current, so pass back the current name and size
+	strcpy_s(name, 256, g_SharedMemoryName);
+	width  = g_Width;
+	height = g_Height;
+
+	// The frame has already been received
+	long count = 0;
+	if(!CheckFrameCount(count))
+		return false;
+
+	pBuffer = interop.AcquireReadBuffer(width, height, pitch, glFormat, frame);
+	if(!pBuffer)
+		return false;
+
+	// The memoryshare frame held has the number of the sender frame count,
+	// and may be one sent since the count was checked
+	if(frame > count)
+		count = frame;
+	CommitFrameCount(count);
+
+	if(frame == 0)
+		frame = g_FrameCount;
+
+	return true;
+
+} // end BorrowReceiveBuffer
+
+
+void Spout::ReleaseReceiveBuffer()
+{
+	interop.ReleaseReadBuffer();
+}
+
+
 
 //
 // CheckReceiver
@@ -666,11 +821,154 @@ bool Spout::DrawToSharedTexture(GLuint TextureID, GLuint TextureTarget, unsigned
 			return(UpdateSender(g_SharedMemoryName, width, height));
 		}
 	}
-	return(interop.DrawToSharedTexture(TextureID, TextureTarget, width, height, max_x, max_y, aspect, bInvert, HostFBO));
+	if(!interop.DrawToSharedTexture(TextureID, TextureTarget, width, height, max_x, max_y, aspect, bInvert, HostFBO))
+		return false;
+
+	interop.senders.SetFrameReady(g_SharedMemoryName);
+
+	return true;
+
+}
+
+
+//---------------------------------------------------------
+// Returns true if the sender has sent a frame that ReceiveTexture or
+// ReceiveImage has not received yet, waiting up to dwTimeout msec for one.
+// Also true if not yet connected, so that ReceiveTexture or ReceiveImage
+// can connect, and for a sender of an earlier version that does not count
+// frames, so that every call copies as before.
+bool Spout::WaitFrameReady(DWORD dwTimeout)
+{
+	long frame = 0;
+
+	if(!bInitialized || !bIsReceiving)
+		return true;
+
+	if(!interop.senders.GetFrameCount(g_SharedMemoryName, frame) || frame == 0)
+		return true;
+
+	frame = g_FrameCount;
+	return interop.senders.WaitFrameReady(g_SharedMemoryName, frame, dwTimeout);
+
+}
+
+
+//---------------------------------------------------------
+// Compare the sender frame count with the last frame received.
+// The count is read before the copy, so a frame sent during the
+// copy is received again rather than missed.
+// Returns false if the frame has been received and is not to be copied again.
+// The frame is zero for a sender of an earlier version that does not count frames.
+// Nothing is recorded until CommitFrameCount after the copy.
+bool Spout::CheckFrameCount(long &frame)
+{
+	frame = 0;
+	bFrameNew = false;
+
+	if(!interop.senders.GetFrameCount(g_SharedMemoryName, frame))
+		frame = 0;
+
+	if(frame != 0 && frame == g_FrameCount && bSkipUnchanged)
+		return false;
+
+	return true;
+
+}
+
+
+//---------------------------------------------------------
+// Record the frame from CheckFrameCount once it has been copied.
+// A frame that failed to copy is not recorded, so that it is copied
+// again by the next call, or counted as dropped if a later one is.
+void Spout::CommitFrameCount(long frame)
+{
+	bFrameNew = true;
+
+	// A sender of an earlier version does not count frames
+	if(frame == 0)
+		return;
+
+	if(frame == g_FrameCount) {
+		bFrameNew = false;
+		g_DuplicateFrames++;
+		return;
+	}
+
+	// Frames sent since the last one received
+	if(g_FrameCount > 0 && frame - g_FrameCount > 1)
+		g_DroppedFrames += frame - g_FrameCount - 1;
+	g_FrameCount = frame;
 
 }
 
 
+//---------------------------------------------------------
+void Spout::SetSkipUnchanged(bool bSkip)
+{
+	bSkipUnchanged = bSkip;
+}
+
+bool Spout::GetSkipUnchanged()
+{
+	return bSkipUnchanged;
+}
+
+bool Spout::IsFrameNew()
+{
+	return bFrameNew;
+}
+
+long Spout::GetSenderFrame()
+{
+	return g_FrameCount;
+}
+
+long Spout::GetDroppedFrames()
+{
+	return g_DroppedFrames;
+}
+
+long Spout::GetDuplicateFrames()
+{
+	return g_DuplicateFrames;
+}
+
+
+//---------------------------------------------------------
+// Count acquisitions, waits and timeouts for the sender list, sender info,
+// memoryshare map and shared texture access locks separately, so that
+// frames dropped can be traced to the lock that held them up.
+void Spout::SetLockStats(bool bEnable)
+{
+	bLockStats = bEnable;
+	if(bEnable) {
+		interop.senders.SetLockStats(&g_LockStats[SPOUT_LOCK_SENDER_LIST], &g_LockStats[SPOUT_LOCK_SENDER_INFO]);
+		interop.memoryshare.SetLockStats(&g_LockStats[SPOUT_LOCK_MEMORY]);
+		interop.spoutdx.SetLockStats(&g_LockStats[SPOUT_LOCK_ACCESS]);
+	}
+	else {
+		interop.senders.SetLockStats(NULL, NULL);
+		interop.memoryshare.SetLockStats(NULL);
+		interop.spoutdx.SetLockStats(NULL);
+	}
+}
+
+bool Spout::GetLockStats(int lock, SpoutLockStats &stats)
+{
+	if(!bLockStats || lock < 0 || lock >= SPOUT_LOCK_TYPES)
+		return false;
+
+	stats = g_LockStats[lock];
+
+	return true;
+}
+
+void Spout::ResetLockStats()
+{
+	ZeroMemory(g_LockStats, sizeof(g_LockStats));
+}
+
+
 //---------------------------------------------------------
 bool Spout::SetCPUmode(bool bCPU)
 {
@@ -970,6 +1268,50 @@ bool Spout::GetSenderName(int index, char* sendername, int sendernameMaxSize)
 }
 
 
+//
+// Get the names and texture info of all senders with one lock of the sender list
+// senders    - out, NULL for the count only
+// maxSenders - in
+// Returns the number of senders, which can be more than maxSenders
+int Spout::EnumerateSenders(SpoutSenderDetails *senders, int maxSenders)
+{
+	return interop.senders.EnumerateSenders(senders, maxSenders);
+}
+
+
+//
+// Release the names of senders that have exited at intervals (msec)
+// on a background thread, or 0 to stop (default)
+void Spout::SetSenderReaper(DWORD dwInterval)
+{
+	interop.senders.SetSenderReaper(dwInterval);
+}
+
+
+//---------------------------------------------------------
+// Sender list changes
+//
+// Senders registered or released and changes of the active sender
+// by applications of this version. The first check after the
+// Spout object is created always returns true.
+bool Spout::CheckSenderListChanged()
+{
+	return interop.senders.WaitSenderListChange(g_SenderListGeneration, 0);
+}
+
+bool Spout::WaitSenderListChanged(DWORD dwTimeout)
+{
+	return interop.senders.WaitSenderListChange(g_SenderListGeneration, dwTimeout);
+}
+
+// The callback is made on a background thread and should only
+// notify the application thread to read the sender list again
+void Spout::SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData)
+{
+	interop.senders.SetSenderListCallback(pCallback, pUserData);
+}
+
+
 // All of these can be directly in the Receiver class . TODO - Change/Test
 //---------------------------------------------------------
 bool Spout::GetActiveSender(char* Sendername)
@@ -1334,6 +1676,7 @@ bool Spout::InitReceiver (HWND hwnd, char* theSendername, unsigned int theWidth,
 	g_Height      = height;
 	g_ShareHandle = sharehandle;
 	g_Format      = format;
+	g_FrameCount  = 0; // the first frame is new whatever its count
 	strcpy_s(g_SharedMemoryName, 256, sendername);
 
 	bInitialized = true;
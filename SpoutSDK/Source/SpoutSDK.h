@@ -53,6 +53,13 @@
 #include "SpoutSenderNames.h"
 #include "SpoutGLDXinterop.h"
 
+// Locks counted by SetLockStats
+#define SPOUT_LOCK_SENDER_LIST 0 // sender names and active sender
+#define SPOUT_LOCK_SENDER_INFO 1 // sender information
+#define SPOUT_LOCK_MEMORY      2 // memoryshare map
+#define SPOUT_LOCK_ACCESS      3 // shared texture access
+#define SPOUT_LOCK_TYPES       4
+
 // Compile flag only - not currently used
 #if defined(__x86_64__) || defined(_M_X64)
 	#define is64bit
@@ -86,7 +93,8 @@ class SPOUT_DLLEXP Spout {
 
 	// Texture functions
 	bool SendTexture    (GLuint TextureID, GLuint TextureTarget, unsigned int width, unsigned int height, bool bInvert=true, GLuint HostFBO=0);
-	bool SendImage      (const unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=true, GLuint HostFBO = 0);
+	// pitch is the line pitch of the pixels in bytes, 0 for tightly packed lines
+	bool SendImage      (const unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat = GL_RGBA, bool bInvert=true, GLuint HostFBO = 0, unsigned int pitch = 0);
 	bool ReceiveTexture (char* Sendername, unsigned int &width, unsigned int &height, GLuint TextureID = 0, GLuint TextureTarget = 0, bool bInvert = false, GLuint HostFBO=0);
 	bool ReceiveImage   (char* Sendername, unsigned int &width, unsigned int &height, unsigned char* pixels, GLenum glFormat = GL_RGBA, bool bInvert = false, GLuint HostFBO=0);
 	bool DrawSharedTexture(float max_x = 1.0, float max_y = 1.0, float aspect = 1.0, bool bInvert = true, GLuint HostFBO = 0);
@@ -94,8 +102,43 @@ class SPOUT_DLLEXP Spout {
 	bool BindSharedTexture();
 	bool UnBindSharedTexture();
 
+	// Sender buffer to write the next frame in place of SendImage, for memoryshare
+	// and CPU modes. Returns NULL if there is none, then use SendImage.
+	unsigned char * AcquireSendBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat);
+	bool CommitSendBuffer(bool bPublish = true); // false to discard the frame
+
+	// Receiver buffer of the latest frame to read in place of ReceiveImage,
+	// for memoryshare and CPU modes, valid until ReleaseReceiveBuffer.
+	// Returns false on failure, or if the frame has already been received
+	// (SetSkipUnchanged) and there is nothing to read.
+	bool BorrowReceiveBuffer(char* Sendername, unsigned int &width, unsigned int &height, const unsigned char* &pBuffer, unsigned int &pitch, GLenum &glFormat, long &frame);
+	void ReleaseReceiveBuffer();
+
+	// Wait for the sender to send a frame the receiver has not had yet, or check with zero timeout
+	bool WaitFrameReady(DWORD dwTimeout = 0);
+
+	// Frame count
+	void SetSkipUnchanged(bool bSkip = true); // ReceiveTexture and ReceiveImage do not copy a frame already received
+	bool GetSkipUnchanged();
+	bool IsFrameNew(); // ReceiveTexture or ReceiveImage received a new frame
+	long GetSenderFrame(); // sender frame count of the last frame received
+	long GetDroppedFrames(); // sender frames never received
+	long GetDuplicateFrames(); // frames received again
+
+	// Lock wait counters
+	void SetLockStats(bool bEnable = true); // Count the waits for each type of lock (default off)
+	bool GetLockStats(int lock, SpoutLockStats &stats); // SPOUT_LOCK_SENDER_LIST etc.
+	void ResetLockStats();
+
 	int  GetSenderCount ();
 	bool GetSenderName  (int index, char* sendername, int MaxSize = 256);
+	int  EnumerateSenders(SpoutSenderDetails *senders, int maxSenders); // all names and info at once
+	void SetSenderReaper(DWORD dwInterval); // release senders that have exited every dwInterval msec, 0 to stop
+
+	// Sender list changes - senders registered or released or a new active sender
+	bool CheckSenderListChanged(); // changed since the last check
+	bool WaitSenderListChanged(DWORD dwTimeout); // wait for a change, or check with zero timeout
+	void SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData = NULL); // called on a background thread, NULL to stop
 	bool GetSenderInfo  (const char* sendername, unsigned int &width, unsigned int &height, HANDLE &dxShareHandle, DWORD &dwFormat);
 	bool GetActiveSender(char* Sendername);
 	bool SetActiveSender(const char* Sendername);
@@ -186,6 +229,11 @@ class SPOUT_DLLEXP Spout {
 	unsigned int g_Height;
 	HANDLE g_ShareHandle;
 	DWORD g_Format;
+	long g_FrameCount; // sender frame count of the last frame received
+	long g_DroppedFrames;
+	long g_DuplicateFrames;
+	long g_SenderListGeneration; // sender list generation when last checked
+	SpoutLockStats g_LockStats[SPOUT_LOCK_TYPES];
 	GLuint g_TexID;
 	HWND g_hWnd;
 	bool bGLDXcompatible;
@@ -199,6 +247,9 @@ class SPOUT_DLLEXP Spout {
 	bool bChangeRequested;
 	bool bSpoutPanelOpened;
 	bool bSpoutPanelActive;
+	bool bSkipUnchanged; // do not copy a frame already received
+	bool bFrameNew; // the last frame received was new
+	bool bLockStats; // count lock waits
 	bool bUseActive; // Use the active sender for CreateReceiver
 	SHELLEXECUTEINFOA m_ShExecInfo;
 
@@ -206,6 +257,8 @@ class SPOUT_DLLEXP Spout {
 	bool OpenReceiver (char *name, unsigned int& width, unsigned int& height);
 	bool InitReceiver (HWND hwnd, char* sendername, unsigned int width, unsigned int height, bool bMemoryMode);
 	bool InitSender   (HWND hwnd, const char* sendername, unsigned int width, unsigned int height, DWORD dwFormat, bool bMemoryMode);
+	bool CheckFrameCount(long &frame);
+	void CommitFrameCount(long frame);
 	bool InitMemoryShare(bool bReceiver);
 	bool ReleaseMemoryShare();
 
@@ -24,6 +24,8 @@
 //		17.09.16	- removed CheckSpout2004() from constructor
 //		13.01.17	- Add SetCPUmode, GetCPUmode, SetBufferMode, GetBufferMode
 //		15.01.17	- Add GetShareMode, SetShareMode
+//		16.10.26	- Add AcquireSendBuffer, CommitSendBuffer
+//					- Add line pitch argument to SendImage
 //
 // ====================================================================================
 /*
@@ -88,9 +90,23 @@ void SpoutSender::ReleaseSender(DWORD dwMsec)
 
 
 //---------------------------------------------------------
-bool SpoutSender::SendImage(const unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat, bool bInvert, GLuint HostFBO)
+bool SpoutSender::SendImage(const unsigned char* pixels, unsigned int width, unsigned int height, GLenum glFormat, bool bInvert, GLuint HostFBO, unsigned int pitch)
 {
-	return spout.SendImage(pixels, width, height, glFormat, bInvert, HostFBO);
+	return spout.SendImage(pixels, width, height, glFormat, bInvert, HostFBO, pitch);
+}
+
+
+//---------------------------------------------------------
+unsigned char * SpoutSender::AcquireSendBuffer(unsigned int width, unsigned int height, unsigned int &pitch, GLenum &glFormat)
+{
+	return spout.AcquireSendBuffer(width, height, pitch, glFormat);
+}
+
+
+//---------------------------------------------------------
+bool SpoutSender::CommitSendBuffer(bool bPublish)
+{
+	return spout.CommitSendBuffer(bPublish);
 }
 
 
@@ -12,6 +12,9 @@
 
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	21.08.15 - started class file
+	16.10.26 - Binary SpoutMemoryHeader in a separate "<sendername>_header" map
+			   "_map" keeps the width and height as text for earlier versions
+			 - UpdateSenderMemory keeps the new map instead of a local copy
 
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	Copyright (c) 2014-2015, Lynn Jarvis. All rights reserved.
@@ -39,34 +42,38 @@
 
 */
 #include "spoutSenderMemory.h"
+#include "spoutMemoryShare.h" // for SpoutMemoryHeader
 #include <assert.h>
 
 spoutSenderMemory::spoutSenderMemory() {
 
+	senderMem = NULL;
+	headerMem = NULL;
+
 }
 
 spoutSenderMemory::~spoutSenderMemory() {
 
 	if(senderMem) delete senderMem;
+	if(headerMem) delete headerMem;
 	
 }
 
 
-bool spoutSenderMemory::GetImageSizeFromSharedMemory(const char* sendername, unsigned int &width, unsigned int &height)
+// Image size from the header map, or from the start of a sender shared memory map.
+// The map starts with the width and height as four characters each, followed
+// by the image, as for earlier versions which have no header map.
+static void GetImageSizeFromBuffer(const char *pBuf, SpoutSharedMemory *headerMem, unsigned int &width, unsigned int &height)
 {
 	char temp[16];
 
-	if(!senderMem) return false;
-
-	char *pBuf = senderMem->Lock();
-	if (!pBuf) {
-		printf("senderMem lock failed\n");
-		return false;
+	SpoutMemoryHeader *header = headerMem ? (SpoutMemoryHeader *)headerMem->GetBuffer() : NULL;
+	if(header && header->magic == SPOUT_MEMORY_MAGIC) {
+		width = header->width;
+		height = header->height;
+		return;
 	}
 
-	// printf("senderMem pBuf = [%x]\n", pBuf);
-	// printf("%c%c%c%c:%c%c%c%c\n", pBuf[0],  pBuf[1], pBuf[2], pBuf[3], pBuf[4], pBuf[5], pBuf[6], pBuf[7]);
-
 	// Width - 1st 4 bytes
 	memcpy((void *)temp, (void *)pBuf, 4);
 	temp[4] = 0;
@@ -78,6 +85,40 @@ bool spoutSenderMemory::GetImageSizeFromSharedMemory(const char* sendername, uns
 	temp[4] = 0;
 	height = (unsigned int)atoi(temp);
 
+}
+
+
+// Create the header map of a sender, or attach to an existing one.
+// The header is written and read with the image map locked.
+bool spoutSenderMemory::CreateHeaderMemory(const char *sendername)
+{
+	string namestring = sendername;
+	namestring += "_header";
+
+	if(headerMem) delete headerMem;
+	headerMem = new SpoutSharedMemory();
+	if(headerMem->Create(namestring.c_str(), SPOUT_MEMORY_HEADER_SIZE, true) == SPOUT_CREATE_FAILED) {
+		delete headerMem;
+		headerMem = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+
+bool spoutSenderMemory::GetImageSizeFromSharedMemory(const char* sendername, unsigned int &width, unsigned int &height)
+{
+	if(!senderMem) return false;
+
+	char *pBuf = senderMem->Lock();
+	if (!pBuf) {
+		printf("senderMem lock failed\n");
+		return false;
+	}
+
+	GetImageSizeFromBuffer(pBuf, headerMem, width, height);
+
 	senderMem->Unlock();
 
 	return true;
@@ -105,9 +146,13 @@ bool spoutSenderMemory::CreateSenderMemory(const char *sendername, unsigned int
 	if(result == SPOUT_CREATE_FAILED) {
 		printf("CreateSenderMemory : failed\n");
 		delete senderMem;
+		senderMem = NULL;
 		return false;
 	}
 
+	// The header map is optional and the map is read without it
+	CreateHeaderMemory(sendername);
+
 	return true;
 		
 } // end CreateSenderMemory
@@ -125,13 +170,16 @@ bool spoutSenderMemory::UpdateSenderMemory(const char *sendername, unsigned int
 	senderMem = NULL;
 
 	// Create a new shared memory map for this sender
-	SpoutSharedMemory *senderMem = new SpoutSharedMemory();
+	senderMem = new SpoutSharedMemory();
 	SpoutCreateResult result = senderMem->Create(namestring.c_str(), 8 + (width*height*4) );
 	if(result == SPOUT_CREATE_FAILED) {
 		delete senderMem;
+		senderMem = NULL;
 		return false;
 	}
 
+	CreateHeaderMemory(sendername);
+
 	return true;
 		
 } // end UpdateSenderMemory
@@ -143,6 +191,8 @@ void spoutSenderMemory::CloseSenderMemory(const char *sendername)
 	// Delete the sender shared memory object - Releases mutex and maps
 	if(senderMem) delete senderMem;
 	senderMem = NULL;
+	if(headerMem) delete headerMem;
+	headerMem = NULL;
 		
 } // end CloseSenderMemory
 
@@ -161,27 +211,35 @@ bool spoutSenderMemory::SetSenderMemory(const char* sendername, unsigned int wid
 		return false;
 	}
 
-	// printf("SetSenderMemory : %d x %d (%d) [%x]\n", width, height, (width*height+8), pixels);
 	buf = pBuf;
 	
 	// Width - 1st 4 bytes
 	sprintf_s(temp, "%4d", width);
 	temp[4] = 0;
 	memcpy((void *)buf, (void *)temp, 4);
-	// printf("%c%c%c%c\n", pBuf[0],  pBuf[1], pBuf[2], pBuf[3]);
 	buf += 4;
 
 	// Height - 2nd 4 bytes
 	sprintf_s(temp, "%4d", height);
 	temp[4] = 0;
 	memcpy((void *)buf, (void *)temp, 4);
-	// printf("%c%c%c%c %c%c%c%c\n", pBuf[0],  pBuf[1], pBuf[2], pBuf[3], pBuf[4], pBuf[5], pBuf[6], pBuf[7]);
 	buf += 4;
 
+	// Header for receivers of this version
+	SpoutMemoryHeader *header = headerMem ? (SpoutMemoryHeader *)headerMem->GetBuffer() : NULL;
+	if(header) {
+		header->magic = SPOUT_MEMORY_MAGIC;
+		header->version = SPOUT_MEMORY_VERSION;
+		header->width = width;
+		header->height = height;
+		header->format = 0x1908; // GL_RGBA
+		header->pitch = width*4;
+		header->capacity = width*height*4;
+		InterlockedIncrement(&header->frame);
+	}
 
 	// Image data
 	memcpy((void *)buf, (void *)pixels, width*height*4 );
-	// printf("%c%c%c%c:%c%c%c%c\n", pBuf[0],  pBuf[1], pBuf[2], pBuf[3], pBuf[4], pBuf[5], pBuf[6], pBuf[7]);
 
 	senderMem->Unlock();
 
@@ -193,8 +251,6 @@ bool spoutSenderMemory::SetSenderMemory(const char* sendername, unsigned int wid
 // Get image size and pixels from a sender shared memory map
 bool spoutSenderMemory::GetSenderMemory(const char* sendername, unsigned int &width, unsigned int &height, unsigned char *pixels) 
 {
-	char temp[16];
-
 	if(!senderMem) return false;
 
 	char *pBuf = senderMem->Lock();
@@ -203,17 +259,8 @@ bool spoutSenderMemory::GetSenderMemory(const char* sendername, unsigned int &wi
 		return false;
 	}
 
-	// Width - 1st 4 bytes
-	memcpy((void *)temp, (void *)pBuf, 4);
-	temp[4] = 0;
-	width = (unsigned int)atoi(temp);
-	pBuf += 4;
-
-	// Height - 2nd 4 bytes
-	memcpy((void *)temp, (void *)pBuf, 4);
-	temp[4] = 0;
-	height = (unsigned int)atoi(temp);
-	pBuf += 4;
+	GetImageSizeFromBuffer(pBuf, headerMem, width, height);
+	pBuf += 8;
 
 	// Image data
 	memcpy((void *)pixels, (void *)pBuf, width*height*4 );
@@ -232,6 +279,8 @@ void spoutSenderMemory::ReleaseSenderMemory()
 	// Delete the sender shared memory object - Releases mutex and maps
 	if(senderMem) delete senderMem;
 	senderMem = NULL;
+	if(headerMem) delete headerMem;
+	headerMem = NULL;
 
 }
 
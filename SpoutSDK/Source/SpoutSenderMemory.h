@@ -101,6 +101,9 @@ protected:
 		// HANDLE m_hMap;
 		// unsigned char *m_pBuffer;
 		SpoutSharedMemory *senderMem;
+		SpoutSharedMemory *headerMem; // "<sendername>_header" with a SpoutMemoryHeader
+
+		bool CreateHeaderMemory(const char *sendername);
 
 		// std::unordered_map<std::string, SpoutSharedMemory*>*	m_senders;
 
@@ -42,6 +42,22 @@
 	03.07-16 - Use helper functions for conversion of 64bit HANDLE to unsigned __int32
 			   and unsigned __int32 to 64bit HANDLE
 			   https://msdn.microsoft.com/en-us/library/aa384267%28VS.85%29.aspx
+	16.10.26 - Shared generation of the sender name set, incremented by every change
+			 - Local copy of the set read again only when the generation changes
+			 - FindSenderName does not lock the sender name map unless the set has changed,
+			   or at intervals for senders of earlier versions
+			 - getSharedInfo and setSharedInfo keep the sender info maps open
+			 - Sequence count after the sender info for reads without the mutex
+			 - Frame count and frame ready semaphore - SetFrameReady, WaitFrameReady
+			 - Optional wait counters for the sender list and info map mutexes - SetLockStats
+			 - EnumerateSenders for all the sender names and info in one pass
+			 - GetSenderNameInfo uses the local set without a copy
+			 - Extension maps for more senders than the sender name map holds
+			 - Process id and heartbeat in the sender info map - IsSenderAlive,
+			   ReapSenders and SetSenderReaper. cleanSenderSet and GetSenderCount
+			   check them instead of opening the sender info map.
+			 - The generation also changes with the active sender and signals
+			   a semaphore - WaitSenderListChange and SetSenderListCallback
 
 
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -71,21 +87,152 @@
 */
 #include "spoutSenderNames.h"
 #include <assert.h>
+#include <iterator> // std::advance
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+
+//
+// Sender info read and write with the sequence count
+//
+// The writer holds the mutex, so that receivers built with
+// earlier versions still see the complete info.
+//
+static void writeSharedInfo(char *pBuf, const SharedTextureInfo *info)
+{
+	LONG volatile *pSequence = (LONG volatile *)(pBuf + SPOUT_INFO_SEQUENCE_OFFSET);
+
+	InterlockedIncrement(pSequence); // odd while writing
+	memcpy((void *)pBuf, (const void *)info, sizeof(SharedTextureInfo));
+	InterlockedIncrement(pSequence); // even when done
+}
+
+// Returns false if the info could not be read without a change,
+// or if the sequence count is zero because the info has only been
+// written by an earlier version, without the count. The caller
+// then reads it with the mutex.
+static bool readSharedInfo(const char *pBuf, SharedTextureInfo *info)
+{
+	const LONG volatile *pSequence = (const LONG volatile *)(pBuf + SPOUT_INFO_SEQUENCE_OFFSET);
+
+	for (int i = 0; i < SPOUT_INFO_READ_RETRIES; i++) {
+		LONG sequence = *pSequence;
+		if (sequence == 0)
+			return false;
+		if (sequence & 1) {
+			YieldProcessor(); // being written
+			continue;
+		}
+		MemoryBarrier();
+		memcpy((void *)info, (const void *)pBuf, sizeof(SharedTextureInfo));
+		MemoryBarrier();
+		if (*pSequence == sequence)
+			return true;
+	}
+
+	return false;
+}
+
+//
+// Background thread for SetSenderReaper
+//
+// It has its own object, because the local copies of the sender set
+// and the info maps are not shared between threads.
+//
+struct spoutSenderReaper {
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	DWORD dwInterval; // msec
+	int maxSenders;
+	bool bQuit;
+};
+
+static void SenderReaperThread(spoutSenderReaper *pReaper)
+{
+	spoutSenderNames senders;
+	std::unique_lock<std::mutex> lock(pReaper->mutex);
+
+	senders.SetMaxSenders(pReaper->maxSenders);
+	for (;;) {
+		if (!pReaper->bQuit)
+			pReaper->wake.wait_for(lock, std::chrono::milliseconds(pReaper->dwInterval));
+		if (pReaper->bQuit)
+			return;
+		lock.unlock();
+		senders.ReapSenders();
+		lock.lock();
+	}
+}
+
+//
+// Background thread for SetSenderListCallback, with its own object as for the reaper.
+// The wait is in slices so that the thread can be stopped.
+//
+struct spoutSenderWatcher {
+	std::thread thread;
+	void (*pCallback)(void *pUserData);
+	void *pUserData;
+	std::atomic<bool> bQuit;
+};
+
+static void SenderWatcherThread(spoutSenderWatcher *pWatcher)
+{
+	spoutSenderNames senders;
+	long generation = 0;
+
+	senders.WaitSenderListChange(generation, 0); // the current generation
+	while (!pWatcher->bQuit) {
+		if (senders.WaitSenderListChange(generation, SPOUT_WAIT_TIMEOUT) && !pWatcher->bQuit)
+			pWatcher->pCallback(pWatcher->pUserData);
+	}
+}
 
 spoutSenderNames::spoutSenderNames() {
 	m_senders = new std::unordered_map<std::string, SpoutSharedMemory*>();
 	m_MaxSenders = 10; // default maximum number of senders
+	m_senderSetCache = new std::set<std::string>();
+	m_senderSetGeneration = 0;
+	m_bSenderSetCached = false;
+	m_senderSetTime = 0;
+	m_extensionMissingGeneration = 0;
+	m_bExtensionMissing = false;
+	m_infoMaps = new std::unordered_map<std::string, SpoutSharedMemory*>();
+	m_infoMapGeneration = 0;
+	m_infoMapTime = 0;
+	m_semaphores = new std::unordered_map<std::string, HANDLE>();
+	m_senderNameExtensions = new std::vector<SpoutSharedMemory*>();
+	m_pReaper = NULL;
+	m_pWatcher = NULL;
+	m_pListStats = NULL;
+	m_pInfoStats = NULL;
 }
 
 spoutSenderNames::~spoutSenderNames() {
 
 	// SenderDebug("SpoutSenderNames", 2560);
 
+	SetSenderReaper(0);
+	SetSenderListCallback(NULL, NULL);
+
 	for (auto itr = m_senders->begin(); itr != m_senders->end(); itr++)
 	{
 		delete itr->second;
 	}
 	delete m_senders;
+	delete m_senderSetCache;
+	CloseInfoMaps();
+	delete m_infoMaps;
+	for (auto itr = m_semaphores->begin(); itr != m_semaphores->end(); itr++) {
+		CloseHandle(itr->second);
+	}
+	delete m_semaphores;
+	for (size_t i = 0; i < m_senderNameExtensions->size(); i++) {
+		delete (*m_senderNameExtensions)[i];
+	}
+	delete m_senderNameExtensions;
 	
 }
 
@@ -98,8 +245,7 @@ spoutSenderNames::~spoutSenderNames() {
 //
 bool spoutSenderNames::RegisterSenderName(const char* Sendername) {
 
-	std::pair<std::set<std::string>::iterator, bool> ret;
-	std::set<std::string> SenderNames; // set of names
+	bool bAdded;
 
 	// Create the shared memory for the sender name set if it does not exist
 	if(!CreateSenderSet())	return false;
@@ -107,23 +253,18 @@ bool spoutSenderNames::RegisterSenderName(const char* Sendername) {
 	char *pBuf = m_senderNames.Lock();
 	if (!pBuf) return false;
 
-	// Register the sender name in the list of spout senders
-	readSenderSetFromBuffer(pBuf, SenderNames, m_MaxSenders);
-
 	//
 	// Add the Sender name to the set of names
 	//
-	ret = SenderNames.insert(Sendername);
-	if(!ret.second) {
+	bAdded = addSenderName(pBuf, Sendername);
+	if(!bAdded) {
 		// See if there are any dangling entries that aren't valid anymore
 		cleanSenderSet();
-		readSenderSetFromBuffer(pBuf, SenderNames, m_MaxSenders);
-		ret = SenderNames.insert(Sendername);
+		bAdded = addSenderName(pBuf, Sendername);
 	}
 
-	if(ret.second) {
-		// write the new map to shared memory
-		writeBufferFromSenderSet(SenderNames, pBuf, m_MaxSenders);
+	if(bAdded) {
+		IncrementSenderSetGeneration();
 		// Set as the active Sender if it is the first one registered
 		// Thereafter the user can select an active Sender using SpoutPanel or SpoutSenders
 		m_activeSender.Create("ActiveSenderName", SpoutMaxSenderNameLen);
@@ -135,7 +276,7 @@ bool spoutSenderNames::RegisterSenderName(const char* Sendername) {
 
 	m_senderNames.Unlock();
 
-	return ret.second;
+	return bAdded;
 }
 
 //
@@ -160,19 +301,20 @@ bool spoutSenderNames::ReleaseSenderName(const char* Sendername)
 		m_senders->erase(namestring);
 	}
 
-	readSenderSetFromBuffer(pBuf, SenderNames, m_MaxSenders);
+	// Do not keep the info map of a released sender open
+	CloseInfoMap(Sendername);
+	CloseFrameSemaphore(Sendername);
 
 	// Discovered that the project properties had been set to CLI
 	// Properties -> General -> Common Language Runtime Support
 	// and this caused the set "find" function not to work.
 	// It also disabled intellisense.
 
-	// Get the current map to update the list
-	if(SenderNames.find(Sendername) != SenderNames.end() ) {
+	// Erase the matching Sender from the map that has it
+	if(removeSenderName(pBuf, Sendername)) {
 
-		SenderNames.erase(Sendername); // erase the matching Sender
-
-		writeBufferFromSenderSet(SenderNames, pBuf, m_MaxSenders);
+		IncrementSenderSetGeneration();
+		readSenderSet(pBuf, SenderNames);
 
 		// Is there a set left ?
 		if(SenderNames.size() > 0) {
@@ -199,18 +341,28 @@ bool spoutSenderNames::ReleaseSenderName(const char* Sendername)
 
 
 // Test to see if the Sender name exists in the sender set
+// The local copy of the set is only read again if the set has changed,
+// so the sender name map is not normally locked
 bool spoutSenderNames::FindSenderName(const char* Sendername)
 {
-	std::string namestring;
-	std::set<std::string> SenderNames;
-	
 	if(Sendername[0]) { // was a valid name passed
-		// Get the current list to update the passed list
-		if(GetSenderSet(SenderNames)) {
+		if(UpdateSenderSetCache()) {
 			// Does the name exist
-			if(SenderNames.find(Sendername) != SenderNames.end() ) {
+			if(m_senderSetCache->find(Sendername) != m_senderSetCache->end() ) {
 				return true;
 			}
+			// A sender registered by an application with an earlier
+			// Spout version does not change the generation of the set.
+			// The set is read again for it at the same interval as the
+			// info maps, so that looking for a sender that does not
+			// exist yet does not lock the sender name map every frame.
+			if(m_bSenderSetCached
+				&& GetTickCount() - m_senderSetTime > SPOUT_INFO_MAP_TIMEOUT
+				&& UpdateSenderSetCache(true)) {
+				if(m_senderSetCache->find(Sendername) != m_senderSetCache->end() ) {
+					return true;
+				}
+			}
 		}
 	}
 
@@ -230,35 +382,29 @@ void spoutSenderNames::cleanSenderSet()
 	}
 
 	std::set<std::string> SenderNames;
-	readSenderSetFromBuffer(pBuf, SenderNames, m_MaxSenders);
+	readSenderSet(pBuf, SenderNames);
 
 	bool changed = false;
 
-	for (auto itr = SenderNames.begin(); itr != SenderNames.end(); )
+	for (auto itr = SenderNames.begin(); itr != SenderNames.end(); itr++)
 	{
 		// It's one of ours, so thats fine
 		if (m_senders->find(*itr) != m_senders->end())
 		{
-			itr++;
 			continue;
 		}
-		SpoutSharedMemory mem;
-		// This isn't found, we clean it up
-		if (!mem.Open((*itr).c_str()))
+		// This isn't alive, we clean it up
+		if (!IsSenderAlive((*itr).c_str()))
 		{
-			changed = true;
-			SenderNames.erase(itr++);
-		}
-		else
-		{
-			++itr;
+			if (removeSenderName(pBuf, (*itr).c_str()))
+				changed = true;
 		}
 		
 	}
 
 	if (changed)
 	{
-		writeBufferFromSenderSet(SenderNames, pBuf, m_MaxSenders);
+		IncrementSenderSetGeneration();
 	}
 
 	m_senderNames.Unlock();
@@ -284,7 +430,6 @@ int spoutSenderNames::GetSenderCount() {
 	std::set<std::string>::iterator iter;
 	std::string namestring;
 	char name[SpoutMaxSenderNameLen];
-	SharedTextureInfo info;
 
 	// Create the shared memory for the sender name set if it does not exist
 	if(!CreateSenderSet()) {
@@ -311,8 +456,8 @@ int spoutSenderNames::GetSenderCount() {
 		for(iter = SenderSet.begin(); iter != SenderSet.end(); iter++) {
 			namestring = *iter; // the Sender name string
 			strcpy_s(name, namestring.c_str());
-			// we have the name already, so look for it's info
-			if(!getSharedInfo(name, &info)) {
+			// we have the name already, so check that it's alive
+			if(!IsSenderAlive(name)) {
 				// Sender does not exist any more
 				ReleaseSenderName(name); // release from the shared memory list
 			}
@@ -338,40 +483,97 @@ int spoutSenderNames::GetSenderCount() {
 // width, height, dxShareHandle - out
 bool spoutSenderNames::GetSenderNameInfo(int index, char* sendername, int sendernameMaxSize, unsigned int &width, unsigned int &height, HANDLE &dxShareHandle)
 {
-	char name[SpoutMaxSenderNameLen];
-	std::set<std::string> SenderNameSet;
-	std::set<std::string>::iterator iter;
-	std::string namestring;
-	int i;
 	DWORD format;
 
-	if(GetSenderNames(&SenderNameSet)) {
-		if(SenderNameSet.size() < (unsigned int)index)
-			return false;
+	// The local set is only read again if it has changed
+	if(!UpdateSenderSetCache())
+		return false;
 
-		i = 0;
-		for(iter = SenderNameSet.begin(); iter != SenderNameSet.end(); iter++) {
-			namestring = *iter; // the name string
-			strcpy_s(name, namestring.c_str()); // the 256 byte name char array
-			if(i == index) {
-				strcpy_s(sendername, sendernameMaxSize, name); // the passed name char array
-				break;
-			}
-			i++;
-		}
-		
-		// Does the retrieved sender exist or has it crashed?
-		// Find out by getting the sender info and returning it
-		if(GetSenderInfo(sendername, width, height, dxShareHandle, format))
-			return true;
+	if(index < 0 || index >= (int)m_senderSetCache->size())
+		return false;
 
-	}
+	std::set<std::string>::iterator iter = m_senderSetCache->begin();
+	std::advance(iter, index);
+	strcpy_s(sendername, sendernameMaxSize, iter->c_str()); // the passed name char array
+
+	// Does the retrieved sender exist or has it crashed?
+	// Find out by getting the sender info and returning it
+	if(GetSenderInfo(sendername, width, height, dxShareHandle, format))
+		return true;
 
 	return false;
 
 } // end GetSenderNameInfo
 
 
+// Names and info of all the senders in one pass
+// senders    - out, NULL to only count them
+// maxSenders - in
+// Returns the number of senders, which can be more than maxSenders.
+// As for GetSenderCount, senders that no longer exist are released.
+// A live sender whose info cannot be read this time, because its map
+// is locked for too long for example, is returned with zero info.
+int spoutSenderNames::EnumerateSenders(SpoutSenderDetails *senders, int maxSenders)
+{
+	SharedTextureInfo info;
+	std::vector<std::string> released;
+	int count = 0;
+
+	if(!CreateSenderSet()) {
+		return 0;
+	}
+
+	// Keep the list locked so that senders are not added
+	// or released while their info is read
+	if(!m_senderNames.Lock()) {
+		return 0;
+	}
+
+	// Read the list even if the generation has not changed,
+	// for senders of earlier versions that do not change it
+	if(!UpdateSenderSetCache(true)) {
+		m_senderNames.Unlock();
+		return 0;
+	}
+
+	for(auto iter = m_senderSetCache->begin(); iter != m_senderSetCache->end(); iter++) {
+		if(!IsSenderAlive(iter->c_str())) {
+			released.push_back(*iter);
+			continue;
+		}
+		// The info maps are kept open between calls
+		if(!getSharedInfo(iter->c_str(), &info)) {
+			memset((void *)&info, 0, sizeof(SharedTextureInfo));
+		}
+		if(senders && count < maxSenders) {
+			SpoutSenderDetails *pDetails = &senders[count];
+			strcpy_s(pDetails->name, SpoutMaxSenderNameLen, iter->c_str());
+			pDetails->width  = (unsigned int)info.width;
+			pDetails->height = (unsigned int)info.height;
+#ifdef _M_X64
+			pDetails->shareHandle = (HANDLE)(LongToHandle((long)info.shareHandle));
+#else
+			pDetails->shareHandle = (HANDLE)info.shareHandle;
+#endif
+			pDetails->format = info.format;
+			if(!GetFrameCount(iter->c_str(), pDetails->frame))
+				pDetails->frame = 0;
+		}
+		count++;
+	}
+
+	// Released after the walk because it changes the set
+	for(size_t i = 0; i < released.size(); i++) {
+		ReleaseSenderName(released[i].c_str());
+	}
+
+	m_senderNames.Unlock();
+
+	return count;
+
+} // end EnumerateSenders
+
+
 //
 // Maximum sender functions for development testing only
 //
@@ -383,6 +585,7 @@ void spoutSenderNames::SetMaxSenders(int maxSenders)
 {
 	// printf("spoutSenderNames - Setting max senders to %d\n", maxSenders);
 	m_MaxSenders = maxSenders;
+	m_bSenderSetCached = false; // read the set again with the new maximum
 }
 
 
@@ -452,7 +655,7 @@ bool spoutSenderNames::SetSenderInfo(const char* sendername, unsigned int width,
 	info.format      = (unsigned __int32)dwFormat;
 	// Usage not used
 
-	memcpy((void *)pBuf, (void *)&info, sizeof(SharedTextureInfo) );
+	writeSharedInfo(pBuf, &info);
 
 	senderInfoMap->Unlock();
 	
@@ -604,13 +807,19 @@ bool spoutSenderNames::UpdateSender(const char *sendername, unsigned int width,
 	if (m_senders->find(namestring) == m_senders->end()) {
 		// Create or open a shared memory map for this sender - allocate enough for the texture info
 		SpoutSharedMemory *senderInfoMem = new SpoutSharedMemory();
-		SpoutCreateResult result = senderInfoMem->Create(sendername, sizeof(SharedTextureInfo));
+		SpoutCreateResult result = senderInfoMem->Create(sendername, SPOUT_INFO_MAP_SIZE);
 		if(result == SPOUT_CREATE_FAILED) {
 			delete senderInfoMem;
 			m_senderNames.Unlock();
 			return false;
 		}
+		senderInfoMem->SetLockStats(m_pInfoStats);
 		(*m_senders)[namestring] = senderInfoMem;
+
+		// This process is the sender from now on
+		char *pBuf = senderInfoMem->GetBuffer();
+		*(LONG volatile *)(pBuf + SPOUT_INFO_HEARTBEAT_OFFSET) = (LONG)GetTickCount();
+		*(LONG volatile *)(pBuf + SPOUT_INFO_PROCESS_OFFSET) = (LONG)GetCurrentProcessId();
 	}
 
 	// Save the info for this sender in the sender shared memory map
@@ -783,6 +992,129 @@ void spoutSenderNames::writeBufferFromSenderSet(const std::set<std::string>& Sen
 	}
 }
 
+//
+// Sender name set over the sender name map and the extension maps
+//
+// The caller has the sender name map locked, which also covers the
+// extension maps. Extension maps are created in order and each process
+// keeps open all it has opened, so the set stops at the first that
+// does not exist.
+//
+// A new extension map is created with the sender name map locked and
+// the generation is incremented before it is unlocked. So if the next
+// map did not exist at the current generation, it is not looked for again
+// until the generation changes.
+//
+void spoutSenderNames::readSenderSet(const char* buffer, std::set<std::string>& SenderNames)
+{
+	std::set<std::string> ExtensionNames;
+	long generation = 0;
+
+	readSenderSetFromBuffer(buffer, SenderNames, m_MaxSenders);
+
+	bool bGeneration = GetSenderSetGeneration(generation);
+	int nExtensions = SPOUT_SENDER_NAMES_EXTENSIONS;
+	if (bGeneration && m_bExtensionMissing && generation == m_extensionMissingGeneration)
+		nExtensions = (int)m_senderNameExtensions->size(); // only those already open
+
+	for (int i = 0; i < nExtensions; i++) {
+		SpoutSharedMemory *mem = GetSenderSetExtension(i, false);
+		if (!mem) {
+			m_bExtensionMissing = bGeneration;
+			m_extensionMissingGeneration = generation;
+			break;
+		}
+		readSenderSetFromBuffer(mem->GetBuffer(), ExtensionNames, SPOUT_SENDER_NAMES_EXTENSION);
+		SenderNames.insert(ExtensionNames.begin(), ExtensionNames.end());
+	}
+}
+
+
+bool spoutSenderNames::addSenderName(char* buffer, const char* Sendername)
+{
+	std::set<std::string> SenderNames;
+
+	readSenderSet(buffer, SenderNames);
+	if (SenderNames.find(Sendername) != SenderNames.end())
+		return false;
+
+	// The sender name map, leaving the last name for earlier versions
+	readSenderSetFromBuffer(buffer, SenderNames, m_MaxSenders);
+	if ((int)SenderNames.size() < m_MaxSenders - 1) {
+		SenderNames.insert(Sendername);
+		writeBufferFromSenderSet(SenderNames, buffer, m_MaxSenders);
+		return true;
+	}
+
+	// The first extension map with room, created if need be
+	for (int i = 0; i < SPOUT_SENDER_NAMES_EXTENSIONS; i++) {
+		SpoutSharedMemory *mem = GetSenderSetExtension(i, true);
+		if (!mem) break;
+		char *pBuf = mem->GetBuffer();
+		readSenderSetFromBuffer(pBuf, SenderNames, SPOUT_SENDER_NAMES_EXTENSION);
+		if ((int)SenderNames.size() < SPOUT_SENDER_NAMES_EXTENSION) {
+			SenderNames.insert(Sendername);
+			writeBufferFromSenderSet(SenderNames, pBuf, SPOUT_SENDER_NAMES_EXTENSION);
+			return true;
+		}
+	}
+
+	printf("spoutSenderNames::addSenderName - no room for sender [%s]\n", Sendername);
+
+	return false;
+}
+
+
+bool spoutSenderNames::removeSenderName(char* buffer, const char* Sendername)
+{
+	std::set<std::string> SenderNames;
+
+	readSenderSetFromBuffer(buffer, SenderNames, m_MaxSenders);
+	if (SenderNames.erase(Sendername) > 0) {
+		writeBufferFromSenderSet(SenderNames, buffer, m_MaxSenders);
+		return true;
+	}
+
+	for (int i = 0; i < SPOUT_SENDER_NAMES_EXTENSIONS; i++) {
+		SpoutSharedMemory *mem = GetSenderSetExtension(i, false);
+		if (!mem) break;
+		char *pBuf = mem->GetBuffer();
+		readSenderSetFromBuffer(pBuf, SenderNames, SPOUT_SENDER_NAMES_EXTENSION);
+		if (SenderNames.erase(Sendername) > 0) {
+			writeBufferFromSenderSet(SenderNames, pBuf, SPOUT_SENDER_NAMES_EXTENSION);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// Returns the extension map of the index, opened or created if need be
+SpoutSharedMemory* spoutSenderNames::GetSenderSetExtension(int index, bool bCreate)
+{
+	char name[64];
+
+	while ((int)m_senderNameExtensions->size() <= index) {
+		int i = (int)m_senderNameExtensions->size();
+		sprintf_s(name, 64, "SpoutSenderNames_%d", i + 1);
+		SpoutSharedMemory *mem = new SpoutSharedMemory();
+		bool bOpen;
+		if (bCreate)
+			bOpen = (mem->Create(name, SPOUT_SENDER_NAMES_EXTENSION*SpoutMaxSenderNameLen) != SPOUT_CREATE_FAILED);
+		else
+			bOpen = mem->Open(name);
+		if (!bOpen) {
+			delete mem;
+			return NULL;
+		}
+		m_senderNameExtensions->push_back(mem);
+	}
+
+	return (*m_senderNameExtensions)[index];
+}
+
+
 //
 //  Functions to read and write the list of Sender names to/from shared memory
 //
@@ -810,36 +1142,147 @@ bool spoutSenderNames::CreateSenderSet()
 
 bool spoutSenderNames::GetSenderSet(std::set<std::string>& SenderNames) {
 
-	std::set<std::string>::iterator iter;
-	char* pBuf = NULL;
+	// Read the set from the sender name map if it has changed
+	if(!UpdateSenderSetCache()) {
+		return false;
+	}
 
-	// Open or create m_sendernames
-	if (!CreateSenderSet())	{
+	SenderNames = *m_senderSetCache;
+
+	return true;
+
+} // end GetSenderSet
+
+
+//
+// Generation of the sender name set
+//
+// A separate shared memory holds a 32 bit count that is incremented
+// whenever a sender name is registered, released or cleaned up,
+// or the active sender changes.
+// It is read without the mutex, so that a receiver can tell
+// whether the set has changed without locking the sender name map.
+// Applications of earlier versions do not change it.
+//
+bool spoutSenderNames::GetSenderSetGeneration(long &generation)
+{
+	if(m_senderGeneration.Create("SpoutSenderNamesGeneration", SPOUT_SENDER_GENERATION_SIZE) == SPOUT_CREATE_FAILED) {
 		return false;
 	}
 
-	pBuf = m_senderNames.Lock();
-	if (!pBuf) {
+	LONG volatile *pGeneration = (LONG volatile *)m_senderGeneration.GetBuffer();
+	if(!pGeneration) {
 		return false;
 	}
 
-	// The data has been stored with 256 bytes reserved for each Sender name
-	// and nothing will have changed with the map yet
-	if(pBuf[0] == 0) { // no senders yet
-		m_senderNames.Unlock();
+	// An aligned 32 bit read is atomic
+	generation = (long)*pGeneration;
+
+	return true;
+
+} // end GetSenderSetGeneration
+
+
+// Called after the set or the active sender has been written
+void spoutSenderNames::IncrementSenderSetGeneration()
+{
+	if(m_senderGeneration.Create("SpoutSenderNamesGeneration", SPOUT_SENDER_GENERATION_SIZE) == SPOUT_CREATE_FAILED) {
+		return;
+	}
+
+	// The waiting counts follow the generation
+	LONG volatile *pGeneration = (LONG volatile *)m_senderGeneration.GetBuffer();
+	if(pGeneration) {
+		SignalCount(pGeneration, pGeneration + 1, "SpoutSenderNamesChanged");
+	}
+
+} // end IncrementSenderSetGeneration
+
+
+// Returns true with the new generation if the sender list or the active sender
+// has changed since the generation given. Returns false if there is no change
+// within the timeout.
+bool spoutSenderNames::WaitSenderListChange(long &generation, DWORD dwTimeout)
+{
+	if(m_senderGeneration.Create("SpoutSenderNamesGeneration", SPOUT_SENDER_GENERATION_SIZE) == SPOUT_CREATE_FAILED) {
+		return false;
+	}
+
+	LONG volatile *pGeneration = (LONG volatile *)m_senderGeneration.GetBuffer();
+	if(!pGeneration) {
+		return false;
+	}
+
+	return WaitCount(pGeneration, pGeneration + 1, "SpoutSenderNamesChanged", generation, dwTimeout);
+
+} // end WaitSenderListChange
+
+
+// The callback is made on the background thread
+void spoutSenderNames::SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData)
+{
+	if(m_pWatcher) {
+		m_pWatcher->bQuit = true;
+		m_pWatcher->thread.join();
+		delete m_pWatcher;
+		m_pWatcher = NULL;
+	}
+
+	if(!pCallback) {
+		return;
+	}
+
+	m_pWatcher = new spoutSenderWatcher();
+	m_pWatcher->pCallback = pCallback;
+	m_pWatcher->pUserData = pUserData;
+	m_pWatcher->bQuit = false;
+	m_pWatcher->thread = std::thread(SenderWatcherThread, m_pWatcher);
+
+} // end SetSenderListCallback
+
+
+//
+// Read the sender name map into the local set
+// if the generation has changed since it was last read, or if forced.
+//
+// The generation is read before the map, so a change while
+// the map is being read leaves the local set marked with the
+// earlier generation and it is read again next time.
+//
+bool spoutSenderNames::UpdateSenderSetCache(bool bForce)
+{
+	long generation = 0;
+	bool bGeneration = GetSenderSetGeneration(generation);
+
+	if(!bForce && bGeneration && m_bSenderSetCached && generation == m_senderSetGeneration) {
 		return true;
 	}
 
-	// Read back from the mapped memory buffer and rebuild the set that was passed in
+	// Open or create m_sendernames
+	if (!CreateSenderSet())	{
+		return false;
+	}
+
+	char *pBuf = m_senderNames.Lock();
+	if (!pBuf) {
+		return false;
+	}
+
+	// Read back from the mapped memory buffer and rebuild the local set
 	// The set will then contain the senders currently in the memory map
 	// and allow for any that have been added or deleted
-	readSenderSetFromBuffer(pBuf, SenderNames, m_MaxSenders);
+	readSenderSet(pBuf, *m_senderSetCache);
 
 	m_senderNames.Unlock();
 
+	// Without the generation map, the set is read every time
+	m_senderSetGeneration = generation;
+	m_bSenderSetCached = bGeneration;
+	m_senderSetTime = GetTickCount();
+
 	return true;
 
-} // end GetSenderSet
+} // end UpdateSenderSetCache
 
 
 // Create a shared memory map to set the active Sender name to shared memory
@@ -859,10 +1302,16 @@ bool spoutSenderNames::setActiveSenderName(const char* SenderName)
 	}
 
 	// Fill it with the Sender name string
+	bool bChanged = (strncmp(pBuf, SenderName, SpoutMaxSenderNameLen) != 0);
 	memcpy( (void *)pBuf, (void *)SenderName, len + 1 ); // write the Sender name string to the shared memory
 	
 	m_activeSender.Unlock();
 
+	// Only a new name is a change of the sender list
+	if(bChanged) {
+		IncrementSenderSetGeneration();
+	}
+
 	return true;
 
 } // end setActiveSenderName
@@ -897,21 +1346,33 @@ bool spoutSenderNames::getActiveSenderName(char SenderName[SpoutMaxSenderNameLen
 // A receiver checks this all the time so it has to be compact
 // Does not have to be the info of this instance
 // so the creation pointer and handle may not be known
+// The info map is kept open and read without the mutex,
+// so this is normally only a copy
 bool spoutSenderNames::getSharedInfo(const char* sharedMemoryName, SharedTextureInfo* info) 
 {
-	SpoutSharedMemory mem;
+	SpoutSharedMemory *mem = GetInfoMap(sharedMemoryName);
+	if(!mem) {
+		return false;
+	}
 
-	// Possibly faster because the functon is called all the time
-	if(mem.Open(sharedMemoryName)) {
-		char *pBuf = mem.Lock();
-		if(pBuf) {
-			memcpy((void *)info, (void *)pBuf, sizeof(SharedTextureInfo) );
-			mem.Unlock();
-			return true;
-		}
+	char *pBuf = mem->GetBuffer();
+	if(pBuf && readSharedInfo(pBuf, info)) {
+		return true;
 	}
 
-	return false;
+	// The info is changing all the time, a writer has stopped part way
+	// through or it was written by an earlier version, so wait for the mutex
+	pBuf = mem->Lock();
+	if(!pBuf) {
+		// Open it again next time
+		CloseInfoMap(sharedMemoryName);
+		return false;
+	}
+
+	memcpy((void *)info, (void *)pBuf, sizeof(SharedTextureInfo) );
+	mem->Unlock();
+
+	return true;
 
 } // end getSharedInfo
 
@@ -919,26 +1380,377 @@ bool spoutSenderNames::getSharedInfo(const char* sharedMemoryName, SharedTexture
 // 12.06.15 - Added to allow direct modification of a sender's information in shared memory
 bool spoutSenderNames::setSharedInfo(const char* sharedMemoryName, SharedTextureInfo* info) 
 {
-	SpoutSharedMemory mem;
-	bool result = mem.Open(sharedMemoryName);
-
-	if (!result) {
+	SpoutSharedMemory *mem = GetInfoMap(sharedMemoryName);
+	if(!mem) {
 		return false;
 	}
 
-	char *pBuf = mem.Lock();
-
+	char *pBuf = mem->Lock();
 	if (!pBuf)	{
+		CloseInfoMap(sharedMemoryName);
 		return false;
 	}
 
-	memcpy((void *)pBuf, (void *)info, sizeof(SharedTextureInfo) );
+	writeSharedInfo(pBuf, info);
 
-	mem.Unlock();
+	mem->Unlock();
 	
 	return true;
 
-} // end getSharedInfo
+} // end setSharedInfo
+
+
+//
+// Sender info maps
+//
+// Opening an info map takes several system calls, so the maps of other
+// senders are kept open between calls. An open map is not removed by
+// the system when the sender closes, so all are closed again whenever
+// the sender set changes, and at intervals to find senders that have
+// closed without releasing their name. The maps of senders created
+// by this instance are already open.
+//
+SpoutSharedMemory* spoutSenderNames::GetInfoMap(const char* sendername)
+{
+	std::string namestring = sendername;
+
+	auto foundSender = m_senders->find(namestring);
+	if (foundSender != m_senders->end()) {
+		return foundSender->second;
+	}
+
+	long generation = 0;
+	DWORD dwTime = GetTickCount();
+	if(!GetSenderSetGeneration(generation)
+		|| generation != m_infoMapGeneration
+		|| dwTime - m_infoMapTime > SPOUT_INFO_MAP_TIMEOUT) {
+		CloseInfoMaps();
+		m_infoMapGeneration = generation;
+		m_infoMapTime = dwTime;
+	}
+
+	auto foundMap = m_infoMaps->find(namestring);
+	if (foundMap != m_infoMaps->end()) {
+		return foundMap->second;
+	}
+
+	SpoutSharedMemory *mem = new SpoutSharedMemory();
+	if(!mem->Open(sendername)) {
+		delete mem;
+		return NULL;
+	}
+	mem->SetLockStats(m_pInfoStats);
+	(*m_infoMaps)[namestring] = mem;
+
+	return mem;
+
+} // end GetInfoMap
+
+
+void spoutSenderNames::CloseInfoMap(const char* sendername)
+{
+	auto foundMap = m_infoMaps->find(sendername);
+	if (foundMap != m_infoMaps->end()) {
+		delete foundMap->second;
+		m_infoMaps->erase(foundMap);
+	}
+}
+
+
+void spoutSenderNames::CloseInfoMaps()
+{
+	for (auto itr = m_infoMaps->begin(); itr != m_infoMaps->end(); itr++) {
+		delete itr->second;
+	}
+	m_infoMaps->clear();
+}
+
+
+// Wait counters for the sender list, active sender and info map mutexes
+void spoutSenderNames::SetLockStats(SpoutLockStats *pListStats, SpoutLockStats *pInfoStats)
+{
+	m_pListStats = pListStats;
+	m_pInfoStats = pInfoStats;
+
+	m_senderNames.SetLockStats(pListStats);
+	m_activeSender.SetLockStats(pListStats);
+	m_senderGeneration.SetLockStats(pListStats);
+
+	for (auto itr = m_senders->begin(); itr != m_senders->end(); itr++) {
+		itr->second->SetLockStats(pInfoStats);
+	}
+	for (auto itr = m_infoMaps->begin(); itr != m_infoMaps->end(); itr++) {
+		itr->second->SetLockStats(pInfoStats);
+	}
+}
+
+
+//
+// Shared counts with a wait for them to change
+//
+// The frame count of a sender and the generation of the sender list are
+// both counts in shared memory with two waiting counts. A process waiting
+// for a change increments the waiting count before checking the count
+// again, and the process that changes it increments the count before
+// reading the waiting count, so either the waiter finds the change or
+// it is released. There are two semaphores, "<name>0" and "<name>1",
+// used for odd and even counts, so that a process that has already had
+// the change and waits again cannot take a release meant for one still
+// waiting for it. A process that times out just as it is released leaves
+// a count in the semaphore, so the count is checked again after every wake.
+//
+
+// Increment the count and release the processes waiting for it to change
+void spoutSenderNames::SignalCount(LONG volatile *pCount, LONG volatile *pWaiters, const char* semaphore)
+{
+	LONG count = InterlockedIncrement(pCount) - 1;
+
+	// Processes that had the count before this one
+	LONG waiters = pWaiters[count & 1];
+	if(waiters > 0) {
+		HANDLE hSemaphore = GetCountSemaphore(semaphore, count);
+		if(hSemaphore) ReleaseSemaphore(hSemaphore, waiters, NULL);
+	}
+
+} // end SignalCount
+
+
+// Returns true with the new count if it has changed from the one given.
+// Returns false if it does not change within the timeout, or at once for zero.
+bool spoutSenderNames::WaitCount(LONG volatile *pCount, LONG volatile *pWaiters, const char* semaphore, long &count, DWORD dwTimeout)
+{
+	pWaiters += (count & 1);
+
+	if(*pCount != count || dwTimeout == 0) {
+		bool bChanged = (*pCount != count);
+		count = (long)*pCount;
+		return bChanged;
+	}
+
+	HANDLE hSemaphore = GetCountSemaphore(semaphore, count);
+	if(!hSemaphore) return false;
+
+	DWORD dwStart = GetTickCount();
+	DWORD dwWait = dwTimeout;
+
+	InterlockedIncrement(pWaiters);
+	while(*pCount == count) {
+		if(WaitForSingleObject(hSemaphore, dwWait) != WAIT_OBJECT_0)
+			break;
+		if(dwTimeout != INFINITE) {
+			DWORD dwElapsed = GetTickCount() - dwStart;
+			if(dwElapsed >= dwTimeout) break;
+			dwWait = dwTimeout - dwElapsed;
+		}
+	}
+	InterlockedDecrement(pWaiters);
+
+	bool bChanged = (*pCount != count);
+	count = (long)*pCount;
+
+	return bChanged;
+
+} // end WaitCount
+
+
+// The semaphore released for the count after the one given,
+// created or opened the first time and kept open
+HANDLE spoutSenderNames::GetCountSemaphore(const char* semaphore, long count)
+{
+	std::string namestring = semaphore;
+	namestring += (count & 1) ? "1" : "0";
+
+	auto found = m_semaphores->find(namestring);
+	if (found != m_semaphores->end()) {
+		return found->second;
+	}
+
+	// Create it or open the one created by another process
+	HANDLE hSemaphore = CreateSemaphoreA(NULL, 0, 0x7FFFFFFF, namestring.c_str());
+	if(!hSemaphore) {
+		printf("spoutSenderNames::GetCountSemaphore - CreateSemaphore failed\n");
+		return NULL;
+	}
+	(*m_semaphores)[namestring] = hSemaphore;
+
+	return hSemaphore;
+
+} // end GetCountSemaphore
+
+
+//
+// Frame ready signal
+//
+// The frame count in the sender info map is compared with the last one
+// seen by the receiver. The sender releases waiting receivers with the
+// semaphores "<sendername>_frame_ready0" and "<sendername>_frame_ready1".
+//
+bool spoutSenderNames::SetFrameReady(const char* sendername)
+{
+	SpoutSharedMemory *mem = GetInfoMap(sendername);
+	if(!mem) return false;
+
+	char *pBuf = mem->GetBuffer();
+	*(LONG volatile *)(pBuf + SPOUT_INFO_HEARTBEAT_OFFSET) = (LONG)GetTickCount();
+
+	std::string semaphore = sendername;
+	semaphore += "_frame_ready";
+	SignalCount((LONG volatile *)(pBuf + SPOUT_INFO_FRAME_OFFSET),
+				(LONG volatile *)(pBuf + SPOUT_INFO_WAITERS_OFFSET), semaphore.c_str());
+
+	return true;
+
+} // end SetFrameReady
+
+
+// Senders of earlier versions do not count frames and the count stays zero
+bool spoutSenderNames::GetFrameCount(const char* sendername, long &frame)
+{
+	SpoutSharedMemory *mem = GetInfoMap(sendername);
+	if(!mem) return false;
+
+	frame = (long)*(LONG volatile *)(mem->GetBuffer() + SPOUT_INFO_FRAME_OFFSET);
+
+	return true;
+
+} // end GetFrameCount
+
+
+// Returns true with the new frame count if the sender has sent a frame
+// since the one given. Returns false if there is none within the timeout.
+bool spoutSenderNames::WaitFrameReady(const char* sendername, long &frame, DWORD dwTimeout)
+{
+	SpoutSharedMemory *mem = GetInfoMap(sendername);
+	if(!mem) return false;
+
+	char *pBuf = mem->GetBuffer();
+	std::string semaphore = sendername;
+	semaphore += "_frame_ready";
+
+	return WaitCount((LONG volatile *)(pBuf + SPOUT_INFO_FRAME_OFFSET),
+					 (LONG volatile *)(pBuf + SPOUT_INFO_WAITERS_OFFSET), semaphore.c_str(), frame, dwTimeout);
+
+} // end WaitFrameReady
+
+
+//
+// Sender liveness
+//
+// A sender that has sent a frame within the heartbeat timeout is alive.
+// Otherwise the process that created it is checked, which does not need
+// the sender list locked and finds a sender that has crashed even while
+// its info map is kept open by receivers. A sender of an earlier version
+// has no process id and is alive while its info map can be opened.
+//
+bool spoutSenderNames::IsSenderAlive(const char* sendername)
+{
+	// Senders of this object
+	if (m_senders->find(sendername) != m_senders->end()) {
+		return true;
+	}
+
+	SpoutSharedMemory *mem = GetInfoMap(sendername);
+	if(!mem) return false;
+
+	char *pBuf = mem->GetBuffer();
+	DWORD dwProcessId = (DWORD)*(LONG volatile *)(pBuf + SPOUT_INFO_PROCESS_OFFSET);
+	DWORD dwHeartbeat = (DWORD)*(LONG volatile *)(pBuf + SPOUT_INFO_HEARTBEAT_OFFSET);
+
+	if(dwProcessId == 0 || GetTickCount() - dwHeartbeat < SPOUT_SENDER_HEARTBEAT_TIMEOUT) {
+		return true;
+	}
+
+	HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, dwProcessId);
+	if(!hProcess) {
+		// A process of another user can exist but not be opened
+		return (GetLastError() == ERROR_ACCESS_DENIED);
+	}
+
+	DWORD dwExitCode = 0;
+	bool bAlive = (GetExitCodeProcess(hProcess, &dwExitCode) && dwExitCode == STILL_ACTIVE);
+	CloseHandle(hProcess);
+
+	return bAlive;
+
+} // end IsSenderAlive
+
+
+// The senders are checked with the local copy of the set and
+// only those that are not alive are checked again with the list locked
+int spoutSenderNames::ReapSenders()
+{
+	std::vector<std::string> stale;
+	int nReleased = 0;
+
+	if(!UpdateSenderSetCache()) {
+		return 0;
+	}
+
+	for(auto iter = m_senderSetCache->begin(); iter != m_senderSetCache->end(); iter++) {
+		if(!IsSenderAlive(iter->c_str()))
+			stale.push_back(*iter);
+	}
+
+	if(stale.empty() || !CreateSenderSet() || !m_senderNames.Lock()) {
+		return 0;
+	}
+
+	for(size_t i = 0; i < stale.size(); i++) {
+		// Another sender may have taken the name since
+		if(!IsSenderAlive(stale[i].c_str()) && ReleaseSenderName(stale[i].c_str()))
+			nReleased++;
+	}
+
+	m_senderNames.Unlock();
+
+	return nReleased;
+
+} // end ReapSenders
+
+
+void spoutSenderNames::SetSenderReaper(DWORD dwInterval)
+{
+	if(m_pReaper) {
+		if(dwInterval > 0) {
+			std::lock_guard<std::mutex> lock(m_pReaper->mutex);
+			m_pReaper->dwInterval = dwInterval;
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_pReaper->mutex);
+			m_pReaper->bQuit = true;
+		}
+		m_pReaper->wake.notify_all();
+		m_pReaper->thread.join();
+		delete m_pReaper;
+		m_pReaper = NULL;
+		return;
+	}
+
+	if(dwInterval == 0) {
+		return;
+	}
+
+	m_pReaper = new spoutSenderReaper();
+	m_pReaper->dwInterval = dwInterval;
+	m_pReaper->maxSenders = m_MaxSenders;
+	m_pReaper->bQuit = false;
+	m_pReaper->thread = std::thread(SenderReaperThread, m_pReaper);
+
+} // end SetSenderReaper
+
+
+void spoutSenderNames::CloseFrameSemaphore(const char* sendername)
+{
+	std::string namestring = sendername;
+	for (int i = 0; i < 2; i++) {
+		auto found = m_semaphores->find(namestring + (i ? "_frame_ready1" : "_frame_ready0"));
+		if (found != m_semaphores->end()) {
+			CloseHandle(found->second);
+			m_semaphores->erase(found);
+		}
+	}
+}
 
 
 //---------------------------------------------------------
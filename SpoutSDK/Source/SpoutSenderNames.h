@@ -52,6 +52,24 @@
 #define SPOUT_WAIT_TIMEOUT 100 // 100 msec wait for events
 // Now replaced by a global class variable // #define MaxSenders 10 // Max for list of Sender names
 #define SpoutMaxSenderNameLen 256
+#define SPOUT_INFO_MAP_TIMEOUT 1000 // msec before sender info maps are opened again
+
+// The "SpoutSenderNames" map has room for m_MaxSenders names, fixed by
+// the first application to create it. Further names are kept in the
+// extension maps "SpoutSenderNames_1", "SpoutSenderNames_2" etc.,
+// which are locked with the sender name map. The last name of the
+// sender name map is left for applications of earlier versions, which
+// only read that map. A name stays in the map it was added to, so the
+// map stays open in the process that registered it.
+#define SPOUT_SENDER_NAMES_EXTENSION 64 // names in an extension map
+#define SPOUT_SENDER_NAMES_EXTENSIONS 15 // maximum number of extension maps
+
+// The generation of the sender set, incremented by every change of the
+// set or of the active sender, is followed by the number of processes
+// waiting for a change after an even or an odd generation. As for the
+// frame ready semaphores, each change releases "SpoutSenderNamesChanged0"
+// or "SpoutSenderNamesChanged1" once for each process waiting.
+#define SPOUT_SENDER_GENERATION_SIZE (3*sizeof(LONG))
 
 // The texture information structure that is saved to shared memory
 // and used for communication between senders and receivers
@@ -75,6 +93,39 @@ struct SharedTextureInfo {
 	unsigned __int32 partnerId; // Wyphon id of partner that shared it with us (not unused)
 };
 
+// A sequence count follows the texture info in the sender info map.
+// It is odd while a sender is writing the info, so a receiver can copy
+// the info without the mutex and try again if the count has changed.
+// Maps created by earlier versions have no count, but the rest of the
+// page is zero. A count of zero means that no sender of this version has
+// written the info, and it is read with the mutex as before.
+#define SPOUT_INFO_SEQUENCE_OFFSET sizeof(SharedTextureInfo)
+
+// Then the number of frames sent and the number of receivers waiting for
+// the frame after an even or an odd count. For each frame the sender
+// releases the "<sendername>_frame_ready0" or "_frame_ready1" semaphore
+// once for each receiver waiting, so that all of them wake.
+#define SPOUT_INFO_FRAME_OFFSET (SPOUT_INFO_SEQUENCE_OFFSET + sizeof(LONG))
+#define SPOUT_INFO_WAITERS_OFFSET (SPOUT_INFO_FRAME_OFFSET + sizeof(LONG))
+// Then the process id of the sender and a heartbeat, the tick count when it
+// last sent a frame, so that a sender that has exited is found without
+// opening its map. Both are zero for a sender of an earlier version.
+#define SPOUT_INFO_PROCESS_OFFSET (SPOUT_INFO_WAITERS_OFFSET + 2*sizeof(LONG))
+#define SPOUT_INFO_HEARTBEAT_OFFSET (SPOUT_INFO_PROCESS_OFFSET + sizeof(LONG))
+#define SPOUT_INFO_MAP_SIZE (sizeof(SharedTextureInfo) + 6*sizeof(LONG))
+#define SPOUT_SENDER_HEARTBEAT_TIMEOUT 2000 // msec without a frame before the process is checked
+#define SPOUT_INFO_READ_RETRIES 100 // before waiting for the mutex
+
+// The name and texture info of a sender returned by EnumerateSenders
+struct SpoutSenderDetails {
+	char name[SpoutMaxSenderNameLen];
+	unsigned int width;
+	unsigned int height;
+	HANDLE shareHandle;
+	DWORD format;
+	long frame; // frames sent, 0 for a sender of an earlier version
+};
+
 
 class SPOUT_DLLEXP spoutSenderNames {
 
@@ -96,6 +147,10 @@ class SPOUT_DLLEXP spoutSenderNames {
 		bool GetSenderNames	   (std::set<std::string> *Sendernames);
 		int  GetSenderCount();
 		bool GetSenderNameInfo (int index, char* sendername, int sendernameMaxSize, unsigned int &width, unsigned int &height, HANDLE &dxShareHandle);
+		// All the senders in one pass with the sender list locked. Fills up to maxSenders
+		// and returns the number of senders, which can be more. NULL to only count.
+		// The info is zero for a sender whose info map could not be read this time.
+		int  EnumerateSenders  (SpoutSenderDetails *senders, int maxSenders);
 
 		// ------------------------------------------------------------
 		// New for 2.005
@@ -111,6 +166,26 @@ class SPOUT_DLLEXP spoutSenderNames {
 		bool getSharedInfo (const char* SenderName, SharedTextureInfo* info);
 		bool setSharedInfo (const char* SenderName, SharedTextureInfo* info);
 
+		// ------------------------------------------------------------
+		// Frame count and frame ready signal of a sender
+		bool SetFrameReady (const char* sendername); // count a new frame and wake receivers waiting for it
+		bool GetFrameCount (const char* sendername, long &frame);
+		// Wait for a frame after the one given, or just check with zero timeout
+		bool WaitFrameReady(const char* sendername, long &frame, DWORD dwTimeout);
+
+		// ------------------------------------------------------------
+		// Sender liveness from the process id and heartbeat in the sender info map
+		bool IsSenderAlive (const char* sendername);
+		int  ReapSenders(); // release the names of senders that are not alive and return the number
+		void SetSenderReaper(DWORD dwInterval); // ReapSenders at intervals on a background thread, 0 to stop
+
+		// ------------------------------------------------------------
+		// Changes of the sender list or the active sender
+		// Wait for a change after the generation given, or just check with zero timeout
+		bool WaitSenderListChange(long &generation, DWORD dwTimeout);
+		// Call a function on a background thread after each change, NULL to stop
+		void SetSenderListCallback(void (*pCallback)(void *pUserData), void *pUserData);
+
 		// ------------------------------------------------------------
 		// Functions to maintain the active sender
 		bool SetActiveSender     (const char* Sendername);
@@ -129,12 +204,35 @@ class SPOUT_DLLEXP spoutSenderNames {
 		// Debug function
 		bool SenderDebug (const char *Sendername, int size);
 
+		// Count the waits for the sender list and active sender mutexes,
+		// and for the sender info map mutexes, or NULL not to
+		void SetLockStats(SpoutLockStats *pListStats, SpoutLockStats *pInfoStats);
+
 protected:
 
 		// Sender name set management
 		bool CreateSenderSet();
 		bool GetSenderSet (std::set<std::string>& SenderNames);
 
+		// Generation of the sender name set, incremented by every change,
+		// so that the set is only read again when it has changed
+		bool GetSenderSetGeneration(long &generation);
+		void IncrementSenderSetGeneration();
+		bool UpdateSenderSetCache(bool bForce = false);
+
+		// Sender info maps kept open between calls to getSharedInfo
+		SpoutSharedMemory* GetInfoMap(const char* sendername);
+		void CloseInfoMap(const char* sendername);
+		void CloseInfoMaps();
+
+		// Shared counts with two waiting counts after them and two semaphores
+		// "<semaphore>0" and "<semaphore>1", for the sender frame count
+		// and the sender list generation
+		void SignalCount(LONG volatile *pCount, LONG volatile *pWaiters, const char* semaphore);
+		bool WaitCount(LONG volatile *pCount, LONG volatile *pWaiters, const char* semaphore, long &count, DWORD dwTimeout);
+		HANDLE GetCountSemaphore(const char* semaphore, long count);
+		void CloseFrameSemaphore(const char* sendername);
+
 		// Active sender management
 		bool setActiveSenderName (const char* SenderName);
 		bool getActiveSenderName (char SenderName[SpoutMaxSenderNameLen]);
@@ -148,8 +246,51 @@ protected:
 		static void readSenderSetFromBuffer(const char* buffer, std::set<std::string>& SenderNames, int maxSenders);
 		static void	writeBufferFromSenderSet(const std::set<std::string>& SenderNames, char *buffer, int maxSenders);
 
+		// The set of names in the sender name map and the extension maps,
+		// with the sender name map locked
+		void readSenderSet(const char* buffer, std::set<std::string>& SenderNames);
+		bool addSenderName(char* buffer, const char* Sendername); // false if it is there already or there is no room
+		bool removeSenderName(char* buffer, const char* Sendername); // false if it is not there
+		SpoutSharedMemory* GetSenderSetExtension(int index, bool bCreate);
+
 		SpoutSharedMemory	m_senderNames;
 		SpoutSharedMemory	m_activeSender;
+		SpoutSharedMemory	m_senderGeneration;
+
+		// Extension maps of the sender name set that have been opened,
+		// kept open until the object is deleted. A pointer as for m_senders.
+		std::vector<SpoutSharedMemory*>* m_senderNameExtensions;
+
+		// Local copy of the sender name set and the generation it was read at.
+		// A pointer as for m_senders.
+		std::set<std::string>* m_senderSetCache;
+		long m_senderSetGeneration;
+		bool m_bSenderSetCached;
+		DWORD m_senderSetTime; // when the set was last read
+
+		// Generation at which the next extension map did not exist
+		long m_extensionMissingGeneration;
+		bool m_bExtensionMissing;
+
+		// Info maps of other senders opened by getSharedInfo,
+		// closed when the sender set changes and at intervals
+		std::unordered_map<std::string, SpoutSharedMemory*>* m_infoMaps;
+		long m_infoMapGeneration;
+		DWORD m_infoMapTime;
+
+		// Frame ready semaphores of this sender or of senders waited for,
+		// and the sender list change semaphores, by name
+		std::unordered_map<std::string, HANDLE>* m_semaphores;
+
+		// Background thread of SetSenderReaper
+		struct spoutSenderReaper* m_pReaper;
+
+		// Background thread of SetSenderListCallback
+		struct spoutSenderWatcher* m_pWatcher;
+
+		// Wait counters kept by the owner
+		SpoutLockStats *m_pListStats;
+		SpoutLockStats *m_pInfoStats;
 
 		// This should be a unordered_map of sender names ->SharedMemory
 		// to handle multiple inputs and outputs all going through the
@@ -8,6 +8,12 @@ http://www.codeproject.com/Articles/835818/Ultimate-Shared-Memory-A-flexible-cla
 
 	https://github.com/mbechard
 
+	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+	16.10.26 - POSIX shared memory and process shared mutex for other systems
+			 - Optional lock wait counters - SetLockStats
+			 - Spin before blocking and optional lock in the segment for Windows
+			 - POSIX segments record the processes open on them and drop those that
+			   have exited without Close, so that the last one still removes the name
 	- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 		Copyright (c) 2014-2017, Lynn Jarvis. All rights reserved.
@@ -39,14 +45,252 @@ http://www.codeproject.com/Articles/835818/Ultimate-Shared-Memory-A-flexible-cla
 #include <assert.h>
 #include <string>
 
+#ifndef _WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+// POSIX shared memory
+//
+// The segment starts with a control block for the mutex, so that it
+// exists as long as the memory, as a Windows named mutex does while a
+// handle is open. The mutex is recursive like a Windows mutex, and
+// robust so that it is not left locked by a process that has exited.
+// The glibc mutex is a futex, so that an uncontended lock does not
+// enter the kernel, and Lock only spins with trylock before blocking.
+// A POSIX segment is not removed when the last process closes it, so
+// the control block has a count of the objects open on it and the
+// last one to close removes the name. An object that finds the count
+// already at zero is too late and tries again for a new segment.
+// A process that exits without Close, as Windows releases its handles,
+// would leave the count above zero and the segment would never be
+// removed. So the control block also records the objects open in each
+// process, and those of a process that no longer exists are taken from
+// the count when another object is opened or closed on the segment.
+// If there are more processes than owner slots, the rest are counted
+// without an owner slot and are not dropped if they exit.
+//
+#define SPOUT_SHARED_MEMORY_OWNERS 32 // processes recorded on a segment
+
+struct SpoutSharedMemoryOwner {
+	volatile int pid; // zero if free, -1 while being dropped
+	volatile int count; // objects open in the process
+};
+
+struct SpoutSharedMemoryControl {
+	pthread_mutex_t mutex;
+	volatile int ready; // set when the creator has initialized the mutex
+	volatile int refs; // objects open on the segment
+	SpoutSharedMemoryOwner owners[SPOUT_SHARED_MEMORY_OWNERS];
+};
+
+#define SPOUT_SHARED_MEMORY_CONTROL_SIZE 512 // the buffer starts after the control block
+#define SPOUT_SHARED_MEMORY_RETRIES 1000 // 1 msec waits for a segment being created or removed
+
+// A POSIX name starts with a slash and has no others
+static std::string SharedMemoryName(const char* name)
+{
+	std::string shmName = "/";
+	shmName += name;
+	for (size_t i = 1; i < shmName.size(); i++) {
+		if (shmName[i] == '/') shmName[i] = '_';
+	}
+	return shmName;
+}
+
+static void SharedMemoryWait()
+{
+	struct timespec ts = { 0, 1000000 };
+	nanosleep(&ts, NULL);
+}
+
+// Map all of an open segment and close the file descriptor.
+// The creator may not have set the size yet.
+static SpoutSharedMemoryControl* MapSharedMemory(int fd, size_t &mapSize)
+{
+	struct stat st;
+
+	for (int i = 0; i < SPOUT_SHARED_MEMORY_RETRIES; i++) {
+		if (fstat(fd, &st) != 0) break;
+		if (st.st_size > SPOUT_SHARED_MEMORY_CONTROL_SIZE) {
+			void *pMap = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (pMap == MAP_FAILED) return NULL;
+			mapSize = (size_t)st.st_size;
+			return (SpoutSharedMemoryControl *)pMap;
+		}
+		SharedMemoryWait();
+	}
+
+	close(fd);
+	return NULL;
+}
+
+// Count an object opened (1) or closed (-1) by this process.
+// The slot of a process is kept until it exits.
+static void AddSharedMemoryOwner(SpoutSharedMemoryControl* pControl, int count)
+{
+	int pid = (int)getpid();
+	int i = 0;
+
+	for (i = 0; i < SPOUT_SHARED_MEMORY_OWNERS; i++) {
+		if (pControl->owners[i].pid == pid) {
+			__sync_fetch_and_add(&pControl->owners[i].count, count);
+			return;
+		}
+	}
+
+	if (count < 0) return; // opened without a slot
+
+	for (i = 0; i < SPOUT_SHARED_MEMORY_OWNERS; i++) {
+		if (pControl->owners[i].pid == 0 && __sync_bool_compare_and_swap(&pControl->owners[i].pid, 0, pid)) {
+			__sync_fetch_and_add(&pControl->owners[i].count, count);
+			return;
+		}
+	}
+}
+
+// Take the objects of processes that have exited from the count.
+// The one that takes it to zero removes the name.
+static void DropSharedMemoryOwners(SpoutSharedMemoryControl* pControl, const char* shmName)
+{
+	int self = (int)getpid();
+
+	for (int i = 0; i < SPOUT_SHARED_MEMORY_OWNERS; i++) {
+		int pid = pControl->owners[i].pid;
+		if (pid <= 0 || pid == self)
+			continue;
+		if (kill((pid_t)pid, 0) == 0 || errno != ESRCH)
+			continue; // still running
+		// Only one process drops the slot
+		if (!__sync_bool_compare_and_swap(&pControl->owners[i].pid, pid, -1))
+			continue;
+		int count = __sync_lock_test_and_set(&pControl->owners[i].count, 0);
+		__sync_synchronize();
+		pControl->owners[i].pid = 0;
+		if (count > 0 && __sync_sub_and_fetch(&pControl->refs, count) == 0)
+			shm_unlink(shmName);
+	}
+}
+
+static bool InitSharedMemoryControl(SpoutSharedMemoryControl* pControl)
+{
+	pthread_mutexattr_t attr;
+
+	if (pthread_mutexattr_init(&attr) != 0) return false;
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	int err = pthread_mutex_init(&pControl->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	if (err != 0) return false;
+
+	pControl->refs = 1;
+	AddSharedMemoryOwner(pControl, 1);
+	__sync_synchronize();
+	pControl->ready = 1;
+
+	return true;
+}
+
+// Returns false if the segment is being removed,
+// or was only open by processes that have exited
+static bool AttachSharedMemoryControl(SpoutSharedMemoryControl* pControl, const char* shmName)
+{
+	for (int i = 0; i < SPOUT_SHARED_MEMORY_RETRIES && !pControl->ready; i++)
+		SharedMemoryWait();
+	__sync_synchronize();
+	if (!pControl->ready)
+		return false;
+
+	DropSharedMemoryOwners(pControl, shmName);
+
+	if (__sync_fetch_and_add(&pControl->refs, 1) <= 0) {
+		__sync_fetch_and_sub(&pControl->refs, 1);
+		return false;
+	}
+	AddSharedMemoryOwner(pControl, 1);
+
+	return true;
+}
+#else
+
+//
+// Lock in the segment
+//
+// A Windows named mutex costs a system call for every lock even when
+// nobody else has it, which is most of the time for the microseconds
+// it is held. The lock word is changed with interlocked functions and
+// only a process that has to wait uses the event. The state is 0 when
+// free, 1 when locked and 2 when locked and another may be waiting,
+// so that Unlock only sets the event if there could be a waiter.
+// The owner is the process id, to find a lock left by a process that
+// has exited as WaitForSingleObject does with WAIT_ABANDONED.
+//
+// Earlier versions lock the named mutex of the sender names, the
+// sender info and the memoryshare map, so only segments that are not
+// shared with them can use it. Two objects for the same segment in
+// the same thread do not recurse, only Lock of the same object.
+//
+struct SpoutSharedMemoryLock {
+	volatile LONG state; // 0 free, 1 locked, 2 locked with waiters
+	volatile LONG owner; // process id of the owner
+};
+
+#define SPOUT_SHARED_MEMORY_LOCK_SIZE 64 // the buffer starts after the lock
+
+// Returns true if the process has exited
+static bool SharedMemoryOwnerExited(DWORD dwProcessId)
+{
+	HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, dwProcessId);
+	if (!hProcess)
+		return true;
+	bool bExited = (WaitForSingleObject(hProcess, 0) == WAIT_OBJECT_0);
+	CloseHandle(hProcess);
+	return bExited;
+}
+#endif
+
+#define SPOUT_SHARED_MEMORY_SPIN 1000 // tries before yielding
+#define SPOUT_SHARED_MEMORY_TIMEOUT 67 // msec
+
+static inline void SharedMemorySpinPause()
+{
+#ifdef _WIN32
+	YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#else
+	__sync_synchronize();
+#endif
+}
+
 SpoutSharedMemory::SpoutSharedMemory()
 {
 	m_pBuffer = NULL;
+#ifdef _WIN32
 	m_hMutex = NULL;
 	m_hMap = NULL;
+	m_pLock = NULL;
+	m_hLockEvent = NULL;
+#else
+	m_pControl = NULL;
+	m_mapSize = 0;
+#endif
 	m_pName = NULL;
 	m_size = 0;
 	m_lockCount = 0;
+	m_pStats = NULL;
 }
 
 SpoutSharedMemory::~SpoutSharedMemory()
@@ -54,8 +298,10 @@ SpoutSharedMemory::~SpoutSharedMemory()
 	Close();
 }
 
+#ifdef _WIN32
+
 // Create a new memory segment, or attach to an existing one
-SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
+SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size, bool bFastLock)
 {
 	DWORD err;
 
@@ -65,7 +311,7 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 
 	if (m_hMap != NULL)	{
 		assert(strcmp(name, m_pName) == 0);
-		assert(m_pBuffer && m_hMutex);
+		assert(m_pBuffer && (m_hMutex || m_hLockEvent));
 		return SPOUT_ALREADY_CREATED;
 	}
 
@@ -80,7 +326,7 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 									NULL,
 									PAGE_READWRITE,
 									0,
-									size,
+									bFastLock ? SPOUT_SHARED_MEMORY_LOCK_SIZE + size : size,
 									(LPCSTR)name);
 
 	if (m_hMap == NULL)	{
@@ -108,13 +354,8 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 		return SPOUT_CREATE_FAILED;
 	}
 
-	std::string	mutexName;
-	mutexName = name;
-	mutexName += "_mutex";
-
-	m_hMutex = CreateMutexA(NULL, FALSE, mutexName.c_str());
-
-	if (!m_hMutex) {
+	// A new mapping is zeroed, so the lock starts free
+	if (!CreateLock(name, bFastLock)) {
 		Close();
 		return SPOUT_CREATE_FAILED;
 	}
@@ -128,14 +369,14 @@ SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size)
 }
 
 
-bool SpoutSharedMemory::Open(const char* name)
+bool SpoutSharedMemory::Open(const char* name, bool bFastLock)
 {
 	// Don't call open twice on the same object without a Close()
 	assert(name);
 
 	if (m_hMap)	{
 		assert(strcmp(name, m_pName) == 0);
-		assert(m_pBuffer && m_hMutex);
+		assert(m_pBuffer && (m_hMutex || m_hLockEvent));
 		return true;
 	}
 
@@ -150,12 +391,7 @@ bool SpoutSharedMemory::Open(const char* name)
 		return false;
 	}
 
-	std::string	mutexName;
-	mutexName = name;
-	mutexName += "_mutex";
-
-	m_hMutex = CreateMutexA(NULL, FALSE, mutexName.c_str());
-	if (!m_hMutex) {
+	if (!CreateLock(name, bFastLock)) {
 		Close();
 		return false;
 	}
@@ -167,8 +403,40 @@ bool SpoutSharedMemory::Open(const char* name)
 
 }
 
+// The named mutex, or the lock at the start of the view and its event
+bool SpoutSharedMemory::CreateLock(const char* name, bool bFastLock)
+{
+	if (bFastLock) {
+		std::string	eventName;
+		eventName = name;
+		eventName += "_lock";
+
+		m_hLockEvent = CreateEventA(NULL, FALSE, FALSE, eventName.c_str());
+		if (!m_hLockEvent)
+			return false;
+
+		m_pLock = (SpoutSharedMemoryLock *)m_pBuffer;
+		m_pBuffer += SPOUT_SHARED_MEMORY_LOCK_SIZE;
+		return true;
+	}
+
+	std::string	mutexName;
+	mutexName = name;
+	mutexName += "_mutex";
+
+	m_hMutex = CreateMutexA(NULL, FALSE, mutexName.c_str());
+
+	return (m_hMutex != NULL);
+}
+
 void SpoutSharedMemory::Close()
 {
+	if (m_pLock) {
+		UnmapViewOfFile((LPCVOID)m_pLock);
+		m_pLock = NULL;
+		m_pBuffer = NULL;
+	}
+
 	if (m_pBuffer) {
 		UnmapViewOfFile((LPCVOID)m_pBuffer);
 		m_pBuffer = NULL;
@@ -184,6 +452,11 @@ void SpoutSharedMemory::Close()
 		m_hMutex = NULL;
 	}
 
+	if (m_hLockEvent) {
+		CloseHandle(m_hLockEvent);
+		m_hLockEvent = NULL;
+	}
+
 	if (m_pName) {
 		free((void*)m_pName);
 		m_pName = NULL;
@@ -192,16 +465,78 @@ void SpoutSharedMemory::Close()
 }
 
 
+bool SpoutSharedMemory::TryLock()
+{
+	if (m_pLock) {
+		if (InterlockedCompareExchange(&m_pLock->state, 1, 0) != 0)
+			return false;
+		m_pLock->owner = (LONG)GetCurrentProcessId();
+		return true;
+	}
+
+	// An abandoned mutex is owned by the caller
+	DWORD waitResult = WaitForSingleObject(m_hMutex, 0);
+	return (waitResult == WAIT_OBJECT_0 || waitResult == WAIT_ABANDONED);
+}
+
+bool SpoutSharedMemory::WaitLock()
+{
+	if (!m_pLock) {
+		DWORD waitResult = WaitForSingleObject(m_hMutex, SPOUT_SHARED_MEMORY_TIMEOUT);
+		return (waitResult == WAIT_OBJECT_0 || waitResult == WAIT_ABANDONED);
+	}
+
+	// The holder is most likely to release it within the spin
+	for (int i = 0; i < SPOUT_SHARED_MEMORY_SPIN; i++) {
+		SharedMemorySpinPause();
+		if (m_pLock->state == 0 && TryLock())
+			return true;
+	}
+
+	// Then give another thread on this processor the chance to
+	SwitchToThread();
+	if (TryLock())
+		return true;
+
+	// Then block, setting the state to 2 so that Unlock sets the event.
+	// The wait is in slices to check for an owner that has exited.
+	LONG myId = (LONG)GetCurrentProcessId();
+	DWORD dwStart = GetTickCount();
+	for (;;) {
+		if (InterlockedExchange(&m_pLock->state, 2) == 0) {
+			m_pLock->owner = myId;
+			return true;
+		}
+
+		DWORD dwElapsed = GetTickCount() - dwStart;
+		if (dwElapsed >= SPOUT_SHARED_MEMORY_TIMEOUT)
+			return false;
+		DWORD dwSlice = SPOUT_SHARED_MEMORY_TIMEOUT - dwElapsed;
+		if (dwSlice > 10) dwSlice = 10;
+
+		if (WaitForSingleObject(m_hLockEvent, dwSlice) == WAIT_TIMEOUT) {
+			LONG owner = m_pLock->owner;
+			if (owner != 0 && owner != myId && SharedMemoryOwnerExited((DWORD)owner)) {
+				// Take over the lock, which stays with state 2 for any other waiter
+				if (InterlockedCompareExchange(&m_pLock->owner, myId, owner) == owner) {
+					InterlockedExchange(&m_pLock->state, 2);
+					return true;
+				}
+			}
+		}
+	}
+}
+
 char* SpoutSharedMemory::Lock()
 {
 	assert(m_lockCount >= 0);
-	assert(m_hMutex);
+	assert(m_hMutex || m_pLock);
 
 	if(m_lockCount < 0) {
 		return NULL;
 	}
 
-	if(!m_hMutex) {
+	if(!m_hMutex && !m_pLock) {
 		return NULL;
 	}
 
@@ -215,9 +550,16 @@ char* SpoutSharedMemory::Lock()
 		return m_pBuffer;
 	}
 
-	DWORD waitResult = WaitForSingleObject(m_hMutex, 67);
-	if (waitResult != WAIT_OBJECT_0) {
-		return NULL;
+	if (TryLock()) {
+		AddLockWait(m_pStats, true, false, 0);
+	}
+	else {
+		unsigned long long start = m_pStats ? GetLockTime() : 0;
+		bool bLocked = WaitLock();
+		if (m_pStats) AddLockWait(m_pStats, bLocked, true, GetLockTime() - start);
+		if (!bLocked) {
+			return NULL;
+		}
 	}
 
 	m_lockCount++;
@@ -229,14 +571,301 @@ char* SpoutSharedMemory::Lock()
 void SpoutSharedMemory::Unlock()
 {
 
-	assert(m_hMutex);
+	assert(m_hMutex || m_pLock);
 
 	m_lockCount--;
 	assert(m_lockCount >= 0);
 
 	if (m_lockCount == 0) {
-		ReleaseMutex(m_hMutex);
+		if (m_pLock) {
+			m_pLock->owner = 0;
+			if (InterlockedExchange(&m_pLock->state, 0) == 2)
+				SetEvent(m_hLockEvent);
+		}
+		else {
+			ReleaseMutex(m_hMutex);
+		}
+	}
+}
+
+
+#else
+
+// Create a new memory segment, or attach to an existing one
+SpoutCreateResult SpoutSharedMemory::Create(const char* name, int size, bool /* bFastLock */)
+{
+	// Don't call open twice on the same object without a Close()
+	assert(name);
+	assert(size);
+
+	if (m_pControl != NULL) {
+		assert(strcmp(name, m_pName) == 0);
+		assert(m_pBuffer);
+		return SPOUT_ALREADY_CREATED;
+	}
+
+	std::string shmName = SharedMemoryName(name);
+
+	for (int i = 0; i < SPOUT_SHARED_MEMORY_RETRIES; i++) {
+
+		bool alreadyExists = false;
+		int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+		if (fd < 0) {
+			if (errno != EEXIST) {
+				printf("SpoutSharedMemory::Create - Error = %d\n", errno);
+				return SPOUT_CREATE_FAILED;
+			}
+			// As for Windows, an existing segment keeps the size it was created with
+			fd = shm_open(shmName.c_str(), O_RDWR, 0);
+			if (fd < 0) {
+				if (errno == ENOENT) continue; // removed since
+				return SPOUT_CREATE_FAILED;
+			}
+			alreadyExists = true;
+		}
+		else if (ftruncate(fd, (off_t)(SPOUT_SHARED_MEMORY_CONTROL_SIZE + size)) != 0) {
+			close(fd);
+			shm_unlink(shmName.c_str());
+			return SPOUT_CREATE_FAILED;
+		}
+
+		m_pControl = MapSharedMemory(fd, m_mapSize);
+		if (!m_pControl) {
+			if (!alreadyExists) shm_unlink(shmName.c_str());
+			return SPOUT_CREATE_FAILED;
+		}
+
+		bool bAttached = alreadyExists ? AttachSharedMemoryControl(m_pControl, shmName.c_str()) : InitSharedMemoryControl(m_pControl);
+		if (!bAttached) {
+			munmap((void *)m_pControl, m_mapSize);
+			m_pControl = NULL;
+			if (!alreadyExists) {
+				shm_unlink(shmName.c_str());
+				return SPOUT_CREATE_FAILED;
+			}
+			SharedMemoryWait(); // being removed
+			continue;
+		}
+
+		m_pBuffer = (char *)m_pControl + SPOUT_SHARED_MEMORY_CONTROL_SIZE;
+
+		// Set the name and size
+		m_pName = strdup(name);
+		m_size = size;
+
+		return alreadyExists ? SPOUT_ALREADY_EXISTS : SPOUT_CREATE_SUCCESS;
+	}
+
+	return SPOUT_CREATE_FAILED;
+
+}
+
+
+bool SpoutSharedMemory::Open(const char* name, bool /* bFastLock */)
+{
+	// Don't call open twice on the same object without a Close()
+	assert(name);
+
+	if (m_pControl) {
+		assert(strcmp(name, m_pName) == 0);
+		assert(m_pBuffer);
+		return true;
+	}
+
+	std::string shmName = SharedMemoryName(name);
+	int fd = shm_open(shmName.c_str(), O_RDWR, 0);
+	if (fd < 0) {
+		return false;
+	}
+
+	m_pControl = MapSharedMemory(fd, m_mapSize);
+	if (!m_pControl) {
+		return false;
+	}
+
+	// A segment being removed no longer exists
+	if (!AttachSharedMemoryControl(m_pControl, shmName.c_str())) {
+		munmap((void *)m_pControl, m_mapSize);
+		m_pControl = NULL;
+		return false;
+	}
+
+	m_pBuffer = (char *)m_pControl + SPOUT_SHARED_MEMORY_CONTROL_SIZE;
+	m_pName = strdup(name);
+	m_size = 0;
+
+	return true;
+
+}
+
+void SpoutSharedMemory::Close()
+{
+	if (m_pControl) {
+		// The last one open removes the name
+		std::string shmName = SharedMemoryName(m_pName ? m_pName : "");
+		DropSharedMemoryOwners(m_pControl, shmName.c_str());
+		AddSharedMemoryOwner(m_pControl, -1);
+		if (__sync_sub_and_fetch(&m_pControl->refs, 1) == 0 && m_pName)
+			shm_unlink(shmName.c_str());
+		munmap((void *)m_pControl, m_mapSize);
+		m_pControl = NULL;
+		m_pBuffer = NULL;
+		m_mapSize = 0;
+	}
+
+	if (m_pName) {
+		free((void*)m_pName);
+		m_pName = NULL;
+	}
+
+}
+
+
+char* SpoutSharedMemory::Lock()
+{
+	assert(m_lockCount >= 0);
+	assert(m_pControl);
+
+	if(m_lockCount < 0) {
+		return NULL;
+	}
+
+	if(!m_pControl || !m_pBuffer) {
+		return NULL;
+	}
+
+	if (m_lockCount > 0) {
+		m_lockCount++;
+		return m_pBuffer;
+	}
+
+	if (TryLock()) {
+		AddLockWait(m_pStats, true, false, 0);
+	}
+	else {
+		unsigned long long start = m_pStats ? GetLockTime() : 0;
+		bool bLocked = WaitLock();
+		if (m_pStats) AddLockWait(m_pStats, bLocked, true, GetLockTime() - start);
+		if (!bLocked) {
+			return NULL;
+		}
+	}
+
+	m_lockCount++;
+
+	return m_pBuffer;
+}
+
+// A lock left by a process that has exited is owned by the caller
+static bool SharedMemoryLocked(pthread_mutex_t* pMutex, int err)
+{
+	if (err == EOWNERDEAD) {
+		pthread_mutex_consistent(pMutex);
+		return true;
+	}
+	return (err == 0);
+}
+
+bool SpoutSharedMemory::TryLock()
+{
+	return SharedMemoryLocked(&m_pControl->mutex, pthread_mutex_trylock(&m_pControl->mutex));
+}
+
+bool SpoutSharedMemory::WaitLock()
+{
+	// The holder is most likely to release it within the spin
+	for (int i = 0; i < SPOUT_SHARED_MEMORY_SPIN; i++) {
+		SharedMemorySpinPause();
+		if ((i & 63) == 63 && TryLock())
+			return true;
+	}
+
+	sched_yield();
+	if (TryLock())
+		return true;
+
+	// Then block on the futex, as long as for Windows
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += SPOUT_SHARED_MEMORY_TIMEOUT*1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	return SharedMemoryLocked(&m_pControl->mutex, pthread_mutex_timedlock(&m_pControl->mutex, &ts));
+}
+
+void SpoutSharedMemory::Unlock()
+{
+	assert(m_pControl);
+
+	m_lockCount--;
+	assert(m_lockCount >= 0);
+
+	if (m_lockCount == 0 && m_pControl) {
+		pthread_mutex_unlock(&m_pControl->mutex);
+	}
+}
+
+#endif
+
+
+char* SpoutSharedMemory::GetBuffer()
+{
+	return m_pBuffer;
+}
+
+
+void SpoutSharedMemory::SetLockStats(SpoutLockStats* pStats)
+{
+	m_pStats = pStats;
+}
+
+
+unsigned long long SpoutSharedMemory::GetLockTime()
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	unsigned long long ticks = (unsigned long long)count.QuadPart;
+	unsigned long long freq = (unsigned long long)frequency.QuadPart;
+	return (ticks/freq)*1000000 + (ticks%freq)*1000000/freq;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#endif
+}
+
+
+void SpoutSharedMemory::AddLockWait(SpoutLockStats* pStats, bool bLocked, bool bContended, unsigned long long usec)
+{
+	if (!pStats)
+		return;
+
+	if (!bLocked) {
+		pStats->timeouts++;
+	}
+	else {
+		pStats->locks++;
+		if (bContended) pStats->contended++;
+	}
+
+	if (!bContended)
+		return;
+
+	pStats->totalWait += usec;
+	if (usec > pStats->maxWait)
+		pStats->maxWait = usec;
+
+	int bin = 0;
+	while (usec > 0 && bin < SPOUT_LOCK_HISTOGRAM_SIZE-1) {
+		usec >>= 1;
+		bin++;
 	}
+	pStats->histogram[bin]++;
 }
 
 
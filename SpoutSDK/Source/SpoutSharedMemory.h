@@ -36,9 +36,13 @@
 #define __SpoutSharedMemory_
 
 #include "SpoutCommon.h"
+#ifdef _WIN32
 #include <windowsx.h>
 #include <d3d9.h>
 #include <wingdi.h>
+#else
+#include <stddef.h>
+#endif
 
 enum SpoutCreateResult
 {
@@ -48,36 +52,84 @@ enum SpoutCreateResult
 	SPOUT_ALREADY_CREATED,
 };
 
+//
+// Counters of the waits for a lock
+//
+// Kept by the owner of the lock when it is given to SetLockStats,
+// so that waits can be traced to a sender and to the lock.
+// Wait times are in microseconds, for acquisitions that had to wait
+// and timeouts. Histogram bin 0 counts waits of less than 1 usec and
+// bin i those from 2^(i-1) to 2^i usec.
+//
+#define SPOUT_LOCK_HISTOGRAM_SIZE 24
+
+struct SpoutLockStats {
+	unsigned long long locks;     // acquisitions
+	unsigned long long contended; // acquisitions that had to wait
+	unsigned long long timeouts;  // waits that failed
+	unsigned long long totalWait; // usec
+	unsigned long long maxWait;   // usec
+	unsigned long long histogram[SPOUT_LOCK_HISTOGRAM_SIZE];
+};
+
 class SPOUT_DLLEXP SpoutSharedMemory {
 public:
 	SpoutSharedMemory();
 	~SpoutSharedMemory();
 
 
-	// Create a new memory segment, or attach to an existing one
-	SpoutCreateResult Create(const char* name, int size);
+	// Create a new memory segment, or attach to an existing one.
+	// bFastLock keeps the lock in the segment instead of a named mutex,
+	// for segments that are not shared with earlier versions (Windows).
+	SpoutCreateResult Create(const char* name, int size, bool bFastLock = false);
 
-	// Opens an existing one
-	bool Open(const char* name);
+	// Opens an existing one, with the same lock as it was created with
+	bool Open(const char* name, bool bFastLock = false);
 	void Close();
 
 	// Returns the buffer
 	char* Lock();
 	void Unlock();
 
+	// Returns the buffer without waiting for the mutex,
+	// for values that are read and written atomically
+	char* GetBuffer();
+
 	void Debug();
 
+	// Count the waits of Lock, or NULL not to (default)
+	void SetLockStats(SpoutLockStats* pStats);
+
+	// For other locks to count waits the same way
+	static unsigned long long GetLockTime(); // usec
+	static void AddLockWait(SpoutLockStats* pStats, bool bLocked, bool bContended, unsigned long long usec);
+
 private:
 
+	bool TryLock();  // without waiting
+	bool WaitLock(); // spin, yield and then block
+
 	char*  m_pBuffer;
+#ifdef _WIN32
 	HANDLE m_hMap;
 	HANDLE m_hMutex;
+	// Lock at the start of the segment, with an event to block on
+	struct SpoutSharedMemoryLock* m_pLock;
+	HANDLE m_hLockEvent;
+	bool CreateLock(const char* name, bool bFastLock);
+#else
+	// POSIX shared memory object "/<name>" with the mutex at the start
+	struct SpoutSharedMemoryControl* m_pControl;
+	size_t m_mapSize;
+#endif
 
 	int m_lockCount;
 
 	const char*	m_pName;
 	int m_size;
 
+	SpoutLockStats* m_pStats;
+
 };
 
 #endif
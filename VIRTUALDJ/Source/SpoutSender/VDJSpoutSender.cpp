@@ -19,6 +19,7 @@
 //		12.01.17 - Add CS_OWNDC to OpenGL window creation
 //		16.01.16 - Remove destroy OpenGL on Stop
 //		23.01.16 - Rebuild for 2.006 VS2012 /MD - Version 1.06
+//		16.10.26 - Pass the surface pitch to SendImage
 //
 //
 // Example : http://www.virtualdj.com/wiki/Plugins_SDKv8_Example.html
@@ -231,8 +232,8 @@ HRESULT __stdcall SpoutSenderPlugin::OnDraw()
 						// Lock the source surface using some flags for optimization
 						hr = source_surface->LockRect(&d3dlr, NULL, D3DLOCK_NO_DIRTY_UPDATE | D3DLOCK_READONLY);
 						if(SUCCEEDED(hr)) {
-							// Pass the pixels to spout
-							spoutsender.SendImage((unsigned char *)d3dlr.pBits, desc.Width, desc.Height, GL_BGRA_EXT);
+							// Pass the pixels to spout with the surface pitch, the lines can be padded
+							spoutsender.SendImage((unsigned char *)d3dlr.pBits, desc.Width, desc.Height, GL_BGRA_EXT, false, 0, (unsigned int)d3dlr.Pitch);
 							source_surface->UnlockRect();
 						}
 